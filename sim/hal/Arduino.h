@@ -0,0 +1,73 @@
+/*
+  Arduino.h - host simulator stand-in for the Arduino-ESP32 core
+  Part of Grbl_ESP32 simulator
+
+  Only the small subset of the Arduino and ESP-IDF API used by the motion
+  core (gcode, motion_control, planner, stepper) is provided. GPIO writes and
+  the stepper timer are routed to the virtual machine in sim_hal.cpp.
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef sim_arduino_h
+#define sim_arduino_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+
+#include "esp32-hal-sim.h"
+
+#define IRAM_ATTR
+
+#define F_CPU 240000000L // ESP32 at 240MHz
+
+#define HIGH 0x1
+#define LOW  0x0
+
+#define INPUT          0x01
+#define OUTPUT         0x02
+#define PULLUP         0x04
+#define INPUT_PULLUP   0x05
+#define PULLDOWN       0x08
+#define INPUT_PULLDOWN 0x09
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+
+#define bit(b) (1UL << (b))
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+
+unsigned long micros();
+unsigned long millis();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+double ledcSetup(uint8_t channel, double freq, uint8_t resolution_bits);
+void ledcAttachPin(uint8_t pin, uint8_t channel);
+void ledcWrite(uint8_t channel, uint32_t duty);
+uint32_t ledcRead(uint8_t channel);
+
+#endif
@@ -0,0 +1,51 @@
+/*
+  EEPROM.h - host simulator stand-in for the ESP32 EEPROM emulation
+  Part of Grbl_ESP32 simulator
+
+  Settings live in RAM for the lifetime of the simulator process, so every run
+  starts from the compiled-in defaults.
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef sim_eeprom_h
+#define sim_eeprom_h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+class EEPROMClass {
+  public:
+    EEPROMClass() : _data(NULL), _size(0) {}
+    bool begin(size_t size)
+    {
+      if (_data == NULL) {
+        _data = (uint8_t *)malloc(size);
+        memset(_data, 0xff, size); // Erased flash reads back as 0xff.
+        _size = size;
+      }
+      return true;
+    }
+    uint8_t read(int address) { return ((size_t)address < _size) ? _data[address] : 0xff; }
+    void write(int address, uint8_t val) { if ((size_t)address < _size) { _data[address] = val; } }
+    bool commit() { return true; }
+  private:
+    uint8_t *_data;
+    size_t _size;
+};
+
+extern EEPROMClass EEPROM;
+
+#endif
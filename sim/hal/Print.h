@@ -0,0 +1,40 @@
+/*
+  Print.h - host simulator stand-in for the Arduino Print class
+  Part of Grbl_ESP32 simulator
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef sim_print_h
+#define sim_print_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+class Print {
+  public:
+    virtual ~Print() {}
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+      size_t n = 0;
+      while (size--) { n += write(*buffer++); }
+      return n;
+    }
+    size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    size_t println(const char *s) { return print(s) + print("\r\n"); }
+};
+
+#endif
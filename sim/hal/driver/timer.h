@@ -0,0 +1,65 @@
+/*
+  driver/timer.h - host simulator stand-in for the ESP-IDF general purpose timer driver
+  Part of Grbl_ESP32 simulator
+
+  Only timer group 0 is modelled. The counter runs on the virtual clock and the
+  registered ISR is called from sim_advance_ticks() whenever the alarm is reached.
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef sim_driver_timer_h
+#define sim_driver_timer_h
+
+#include "esp32-hal-sim.h"
+
+typedef enum { TIMER_GROUP_0 = 0, TIMER_GROUP_1 = 1, TIMER_GROUP_MAX } timer_group_t;
+typedef enum { TIMER_0 = 0, TIMER_1 = 1, TIMER_MAX } timer_idx_t;
+typedef enum { TIMER_COUNT_DOWN = 0, TIMER_COUNT_UP = 1 } timer_count_dir_t;
+typedef enum { TIMER_PAUSE = 0, TIMER_START = 1 } timer_start_t;
+typedef enum { TIMER_ALARM_DIS = 0, TIMER_ALARM_EN = 1 } timer_alarm_t;
+typedef enum { TIMER_INTR_LEVEL = 0 } timer_intr_mode_t;
+
+typedef struct {
+  timer_alarm_t alarm_en;
+  timer_start_t counter_en;
+  timer_intr_mode_t intr_type;
+  timer_count_dir_t counter_dir;
+  bool auto_reload;
+  uint32_t divider;
+} timer_config_t;
+
+typedef struct {
+  struct {
+    struct {
+      uint32_t alarm_en;
+    } config;
+  } hw_timer[TIMER_MAX];
+  struct {
+    uint32_t t0;
+    uint32_t t1;
+  } int_clr_timers;
+} timg_dev_t;
+
+extern timg_dev_t TIMERG0;
+
+esp_err_t timer_init(timer_group_t group_num, timer_idx_t timer_num, const timer_config_t *config);
+esp_err_t timer_set_counter_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t load_val);
+esp_err_t timer_set_alarm_value(timer_group_t group_num, timer_idx_t timer_num, uint64_t alarm_value);
+esp_err_t timer_start(timer_group_t group_num, timer_idx_t timer_num);
+esp_err_t timer_pause(timer_group_t group_num, timer_idx_t timer_num);
+esp_err_t timer_enable_intr(timer_group_t group_num, timer_idx_t timer_num);
+esp_err_t timer_isr_register(timer_group_t group_num, timer_idx_t timer_num, void (*fn)(void *), void *arg, int intr_alloc_flags, void *handle);
+
+#endif
@@ -0,0 +1,89 @@
+/*
+  esp32-hal-sim.h - ESP-IDF types and the virtual machine hooks of the host simulator
+  Part of Grbl_ESP32 simulator
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef esp32_hal_sim_h
+#define esp32_hal_sim_h
+
+#include <stdint.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+
+typedef enum {
+  GPIO_NUM_0 = 0,
+  GPIO_NUM_1 = 1,
+  GPIO_NUM_2 = 2,
+  GPIO_NUM_3 = 3,
+  GPIO_NUM_4 = 4,
+  GPIO_NUM_5 = 5,
+  GPIO_NUM_6 = 6,
+  GPIO_NUM_7 = 7,
+  GPIO_NUM_8 = 8,
+  GPIO_NUM_9 = 9,
+  GPIO_NUM_10 = 10,
+  GPIO_NUM_11 = 11,
+  GPIO_NUM_12 = 12,
+  GPIO_NUM_13 = 13,
+  GPIO_NUM_14 = 14,
+  GPIO_NUM_15 = 15,
+  GPIO_NUM_16 = 16,
+  GPIO_NUM_17 = 17,
+  GPIO_NUM_18 = 18,
+  GPIO_NUM_19 = 19,
+  GPIO_NUM_20 = 20,
+  GPIO_NUM_21 = 21,
+  GPIO_NUM_22 = 22,
+  GPIO_NUM_23 = 23,
+  GPIO_NUM_24 = 24,
+  GPIO_NUM_25 = 25,
+  GPIO_NUM_26 = 26,
+  GPIO_NUM_27 = 27,
+  GPIO_NUM_28 = 28,
+  GPIO_NUM_29 = 29,
+  GPIO_NUM_30 = 30,
+  GPIO_NUM_31 = 31,
+  GPIO_NUM_32 = 32,
+  GPIO_NUM_33 = 33,
+  GPIO_NUM_34 = 34,
+  GPIO_NUM_35 = 35,
+  GPIO_NUM_36 = 36,
+  GPIO_NUM_37 = 37,
+  GPIO_NUM_38 = 38,
+  GPIO_NUM_39 = 39,
+  GPIO_NUM_MAX = 40,
+} gpio_num_t;
+
+// Microseconds since boot on the virtual clock.
+int64_t esp_timer_get_time();
+
+// Virtual machine hooks (sim_hal.cpp). Time is counted in stepper timer ticks (F_STEPPER_TIMER).
+uint64_t sim_get_ticks();
+void sim_cpu_spin();                   // Busy-wait loops burn one tick per iteration.
+void sim_advance_ticks(uint64_t ticks); // Let the virtual clock run, firing the stepper timer as due.
+
+#define NOP() sim_cpu_spin()
+
+// The simulator is single threaded, so critical sections have nothing to exclude.
+typedef struct { uint32_t owner; } portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED {0}
+#define portENTER_CRITICAL(mux) ((void)(mux))
+#define portEXIT_CRITICAL(mux) ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux) ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux) ((void)(mux))
+
+#endif
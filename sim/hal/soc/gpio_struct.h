@@ -0,0 +1,48 @@
+/*
+  gpio_struct.h - ESP32 GPIO output set/clear registers for the host simulator
+  Part of Grbl_ESP32 simulator
+
+  Stores to the registers go to the simulator GPIO model, the same one digitalWrite() uses.
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef sim_soc_gpio_struct_h
+#define sim_soc_gpio_struct_h
+
+#include <stdint.h>
+
+// Sets (level 1) or clears (level 0) every pin whose bit is set in mask. Bank 1 is GPIO32-39.
+void sim_gpio_write_mask(uint8_t bank, uint32_t mask, uint8_t level);
+
+template <uint8_t bank, uint8_t level>
+struct sim_gpio_reg_t {
+  sim_gpio_reg_t &operator=(uint32_t mask) { sim_gpio_write_mask(bank, mask, level); return *this; }
+};
+
+template <uint8_t bank, uint8_t level>
+struct sim_gpio_reg1_t {
+  sim_gpio_reg_t<bank, level> val;
+};
+
+typedef struct {
+  sim_gpio_reg_t<0, 1> out_w1ts;
+  sim_gpio_reg_t<0, 0> out_w1tc;
+  sim_gpio_reg1_t<1, 1> out1_w1ts;
+  sim_gpio_reg1_t<1, 0> out1_w1tc;
+} gpio_dev_t;
+
+extern gpio_dev_t GPIO;
+
+#endif
@@ -0,0 +1,60 @@
+/*
+  ledc_struct.h - ESP32 LEDC channel registers for the host simulator
+  Part of Grbl_ESP32 simulator
+
+  Only the channel fields the spindle PWM writes are modelled. Starting a duty update, or
+  turning the output off, goes to the same output model ledcWrite() uses.
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef sim_soc_ledc_struct_h
+#define sim_soc_ledc_struct_h
+
+#include <stdint.h>
+
+struct sim_ledc_channel_t;
+
+// Setting duty_start outputs the duty register. Clearing sig_out_en outputs 0.
+struct sim_ledc_duty_start_t {
+  sim_ledc_duty_start_t &operator=(uint32_t value);
+};
+
+struct sim_ledc_sig_out_en_t {
+  sim_ledc_sig_out_en_t &operator=(uint32_t value);
+};
+
+struct sim_ledc_channel_t {
+  struct {
+    sim_ledc_sig_out_en_t sig_out_en;
+    uint32_t clk_en;
+    uint32_t val;
+  } conf0;
+  struct {
+    uint32_t duty; // 4 fractional bits
+  } duty;
+  struct {
+    sim_ledc_duty_start_t duty_start;
+  } conf1;
+};
+
+typedef struct {
+  struct {
+    sim_ledc_channel_t channel[8];
+  } channel_group[2]; // High speed channels 0-7, low speed channels 8-15
+} ledc_dev_t;
+
+extern ledc_dev_t LEDC;
+
+#endif
@@ -0,0 +1,30 @@
+/*
+  core-macros.h - Xtensa cycle counter on the virtual clock of the host simulator
+  Part of Grbl_ESP32 simulator
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef sim_xtensa_core_macros_h
+#define sim_xtensa_core_macros_h
+
+#include "Arduino.h"
+
+// CCOUNT runs at F_CPU. The virtual clock only has stepper timer resolution.
+static inline uint32_t xthal_get_ccount()
+{
+  return (uint32_t)(sim_get_ticks() * (F_CPU/F_STEPPER_TIMER));
+}
+
+#endif
@@ -0,0 +1,265 @@
+/*
+  main.cpp - host simulator entry point
+  Part of Grbl_ESP32 simulator
+
+  Runs a G-code program through the real parser, planner, segment generator and stepper
+  ISR on a virtual clock, and writes every step/direction edge and spindle PWM change to a
+  trace file. Two runs of the same program produce identical traces, so a trace diff shows
+  exactly what a change to the motion core did to the machine's output.
+
+    program [gcode file] [-t trace file] [-q] [-b passes] [-c binary job file]
+
+  The G-code is read from stdin when no file is given. A precompiled job (see
+  gcode_binary.h) is run the way the SD card streamer runs it. A summary with the virtual
+  run time, step counts and ISR statistics is printed to stderr.
+
+  -b runs the planner benchmark instead: the program is parsed and planned the given number
+  of times with the stepper held off, and the host time per planned block is reported.
+
+  -c compiles the G-code into a precompiled job instead of running it. Running the job
+  leaves the same trace as running the G-code.
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+#include "sim.h"
+#include <time.h>
+
+// Same whitespace, comment and upper-casing rules as protocol_main_loop(). False if the line
+// did not fit, with the part that did in out.
+static bool sim_normalize_line(const char *in, char *out)
+{
+  uint8_t char_counter = 0;
+  bool in_parentheses = false;
+  bool fits = true;
+  for (; *in && *in != ';'; in++) {
+    char c = *in;
+    if (in_parentheses) {
+      if (c == ')') { in_parentheses = false; }
+    } else if (c == '(') {
+      in_parentheses = true;
+    } else if ((c > ' ') && (c != '%')) {
+      if (char_counter < (LINE_BUFFER_SIZE-1)) {
+        out[char_counter++] = toupper(c);
+      } else {
+        fits = false;
+      }
+    }
+  }
+  out[char_counter] = 0;
+  return fits;
+}
+
+static void sim_reset()
+{
+  memset(&sys, 0, sizeof(system_t));
+  sys.f_override = DEFAULT_FEED_OVERRIDE;
+  sys.r_override = DEFAULT_RAPID_OVERRIDE;
+  sys.spindle_speed_ovr = DEFAULT_SPINDLE_SPEED_OVERRIDE;
+  memset(sys_position, 0, sizeof(sys_position));
+
+  gc_init();
+  spindle_init();
+  coolant_init();
+  limits_init();
+  probe_init();
+  plan_reset();
+  st_reset();
+  plan_sync_position();
+  gc_sync_position();
+  sys.state = STATE_IDLE;
+}
+
+static void sim_run(FILE *gcode_file)
+{
+  char raw[LINE_BUFFER_SIZE*2];
+  char line[LINE_BUFFER_SIZE];
+  uint32_t line_number = 0;
+  while (fgets(raw, sizeof(raw), gcode_file) != NULL) {
+    line_number++;
+    bool fits = sim_normalize_line(raw, line);
+    if (line[0] == 0) { continue; }
+    // Only jogging is meaningful among the '$' commands without the rest of the firmware.
+    if ((line[0] == '$') && (strncmp(line, "$J=", 3) != 0)) { continue; }
+
+    uint8_t status_code = fits ? gc_execute_line(line, CLIENT_SERIAL) : gc_line_overflow_status(line);
+    sim_stats.lines++;
+    if (status_code != STATUS_OK) {
+      sim_stats.errors++;
+      fprintf(stderr, "error:%d line %u: %s\n", status_code, line_number, line);
+    }
+    protocol_execute_realtime(); // One main loop pass per line.
+    if (sys.abort) { break; }
+  }
+  protocol_buffer_synchronize();
+}
+
+static void sim_compile(FILE *gcode_file, FILE *job_file)
+{
+  char raw[LINE_BUFFER_SIZE*2];
+  char line[LINE_BUFFER_SIZE];
+  uint8_t record[LINE_BUFFER_SIZE];
+  uint32_t line_number = 0;
+  uint32_t last_line_number = 0;
+  fwrite(GC_BINARY_MAGIC, 1, GC_BINARY_MAGIC_SIZE, job_file);
+  while (fgets(raw, sizeof(raw), gcode_file) != NULL) {
+    line_number++;
+    bool fits = sim_normalize_line(raw, line);
+    if (line[0] == 0) { continue; }
+    if ((line[0] == '$') && (strncmp(line, "$J=", 3) != 0)) { continue; } // As sim_run() does.
+    if (!fits) {
+      sim_stats.errors++;
+      fprintf(stderr, "error:%d line %u: %s\n", gc_line_overflow_status(line), line_number, line);
+      continue;
+    }
+    uint16_t size = gc_binary_compile_line(line, line_number, &last_line_number, record);
+    fwrite(record, 1, size, job_file);
+    sim_stats.lines++;
+  }
+}
+
+// Same as sim_run() for a precompiled job. The magic bytes have been read already.
+static void sim_run_binary(FILE *job_file)
+{
+  uint8_t record[LINE_BUFFER_SIZE];
+  uint32_t line_number = 0;
+  int size;
+  while ((size = fgetc(job_file)) != EOF) {
+    record[0] = size;
+    if (fread(record+1, 1, size, job_file) != (size_t)size) {
+      fprintf(stderr, "truncated record after line %u\n", line_number);
+      sim_stats.errors++;
+      break;
+    }
+    line_number = gc_binary_line_number(record, line_number);
+
+    uint8_t status_code = gc_binary_execute(record, CLIENT_SERIAL);
+    sim_stats.lines++;
+    if (status_code != STATUS_OK) {
+      sim_stats.errors++;
+      fprintf(stderr, "error:%d line %u\n", status_code, line_number);
+    }
+    protocol_execute_realtime(); // One main loop pass per line.
+    if (sys.abort) { break; }
+  }
+  protocol_buffer_synchronize();
+}
+
+static bool sim_is_binary(FILE *gcode_file)
+{
+  char magic[GC_BINARY_MAGIC_SIZE];
+  if ((fread(magic, 1, GC_BINARY_MAGIC_SIZE, gcode_file) == GC_BINARY_MAGIC_SIZE) &&
+      (memcmp(magic, GC_BINARY_MAGIC, GC_BINARY_MAGIC_SIZE) == 0)) {
+    return true;
+  }
+  rewind(gcode_file);
+  return false;
+}
+
+static double sim_host_seconds()
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec + now.tv_nsec*1e-9;
+}
+
+int main(int argc, char *argv[])
+{
+  FILE *gcode_file = stdin;
+  FILE *trace_file = stdout;
+  FILE *job_file = NULL;
+  bool quiet = false;
+  uint32_t bench_passes = 0;
+
+  for (int i = 1; i < argc; i++) {
+    if ((strcmp(argv[i], "-t") == 0) && (i+1 < argc)) {
+      trace_file = fopen(argv[++i], "w");
+      if (trace_file == NULL) { perror(argv[i]); return 1; }
+    } else if (strcmp(argv[i], "-q") == 0) {
+      quiet = true;
+    } else if ((strcmp(argv[i], "-c") == 0) && (i+1 < argc)) {
+      job_file = fopen(argv[++i], "wb");
+      if (job_file == NULL) { perror(argv[i]); return 1; }
+    } else if ((strcmp(argv[i], "-b") == 0) && (i+1 < argc)) {
+      bench_passes = atoi(argv[++i]);
+    } else {
+      gcode_file = fopen(argv[i], "r");
+      if (gcode_file == NULL) { perror(argv[i]); return 1; }
+    }
+  }
+  sim_trace_open((quiet || bench_passes || job_file) ? NULL : trace_file);
+
+  settings_init();
+  plan_init();
+  stepper_init();
+  sim_reset();
+
+  if (bench_passes) {
+    sim_bench = true;
+    double start = sim_host_seconds();
+    for (uint32_t pass = 0; pass < bench_passes; pass++) {
+      if (pass) {
+        rewind(gcode_file);
+        sim_reset(); // Every pass plans the same moves from the same start position.
+      }
+      sim_run(gcode_file);
+      if (sys.abort) { break; }
+    }
+    double elapsed = sim_host_seconds()-start;
+    fprintf(stderr, "bench: %u passes, %u blocks in %.3f s, %.0f blocks/s\n", bench_passes, sim_bench_blocks,
+            elapsed, sim_bench_blocks/elapsed);
+    return (sim_stats.errors || sys.abort) ? 1 : 0;
+  }
+
+  if (job_file) {
+    sim_compile(gcode_file, job_file);
+    fclose(job_file);
+    fprintf(stderr, "compiled %u lines\n", sim_stats.lines);
+    return 0;
+  }
+  if ((gcode_file != stdin) && sim_is_binary(gcode_file)) {
+    sim_run_binary(gcode_file);
+  } else {
+    sim_run(gcode_file);
+  }
+
+  float position[N_AXIS];
+  system_convert_array_steps_to_mpos(position, sys_position);
+  uint64_t ticks = sim_get_ticks();
+  fprintf(stderr, "lines %u, errors %u, virtual time %.6f s\n", sim_stats.lines, sim_stats.errors,
+          (double)ticks/F_STEPPER_TIMER);
+  fprintf(stderr, "isr calls %llu, overruns %llu, busy-wait %.6f s\n", (unsigned long long)sim_stats.isr_calls,
+          (unsigned long long)sim_stats.isr_overruns, (double)sim_stats.spin_ticks/F_STEPPER_TIMER);
+  for (uint8_t idx = 0; idx < N_AXIS; idx++) {
+    fprintf(stderr, "axis %u: steps %llu, MPos %.3f\n", idx, (unsigned long long)sim_stats.steps[idx], position[idx]);
+  }
+
+#ifdef STEPPER_ISR_PROFILE
+  // ISR time here is virtual (busy-waits only), but the jitter shows ISR overruns and timer
+  // reprogramming exactly as the target would see them.
+  static stepper_profile_t profile;
+  st_profile_snapshot(&profile);
+  for (uint8_t level = 0; level <= MAX_AMASS_LEVEL; level++) {
+    profile_hist_t *isr = &profile.duration[level];
+    profile_hist_t *jit = &profile.jitter[level];
+    if (isr->count == 0) { continue; }
+    fprintf(stderr, "amass %u: isr n=%u p99=%u max=%u, jitter p99=%u max=%u (cpu cycles)\n", level, isr->count,
+            st_profile_percentile(isr, 99), isr->max, st_profile_percentile(jit, 99), jit->max);
+  }
+#endif
+
+  if (trace_file != stdout) { fclose(trace_file); }
+  return (sim_stats.errors || sys.abort) ? 1 : 0;
+}
@@ -0,0 +1,51 @@
+/*
+  sim.h - host simulator for the Grbl_ESP32 motion core
+  Part of Grbl_ESP32 simulator
+
+  Build and run with PlatformIO:
+    pio run -e native
+    .pio/build/native/program src/data/stress_test.gcode -t stress_test.trace
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef sim_h
+#define sim_h
+
+#include <stdio.h>
+
+// Virtual time the simulated main loop takes per protocol_execute_realtime() pass.
+#ifndef SIM_MAIN_LOOP_TICKS
+  #define SIM_MAIN_LOOP_TICKS (50*TICKS_PER_MICROSECOND)
+#endif
+
+typedef struct {
+  uint64_t steps[N_AXIS]; // Step pulses seen on each axis step pin
+  uint64_t isr_calls;     // Stepper timer interrupts taken
+  uint64_t isr_overruns;  // Alarms that fired while the previous ISR was still running
+  uint64_t spin_ticks;    // Ticks burnt in busy-wait loops
+  uint32_t lines;         // G-code lines executed
+  uint32_t errors;        // G-code lines rejected by the parser
+} sim_stats_t;
+extern sim_stats_t sim_stats;
+
+// Planner benchmark mode. Blocks are dropped from the tail of the planner buffer instead of
+// being executed, so the parser and planner run back to back without the stepper.
+extern bool sim_bench;
+extern uint32_t sim_bench_blocks; // Blocks planned while benchmarking
+
+// Starts writing the step/dir and PWM trace to file. NULL disables tracing.
+void sim_trace_open(FILE *file);
+
+#endif
@@ -0,0 +1,208 @@
+/*
+  sim_grbl.cpp - stand-ins for the firmware services around the motion core
+  Part of Grbl_ESP32 simulator
+
+  protocol.cpp, system.cpp, report.cpp, grbl_limits.cpp and serial.cpp are tied to
+  FreeRTOS tasks, the radios and the display, so the simulator replaces them with the
+  minimum the parser, planner and stepper need: the cycle start/stop state machine,
+  the realtime flag setters and a text sink for messages.
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+#include "sim.h"
+
+system_t sys;
+int32_t sys_position[N_AXIS];
+int32_t sys_probe_position[N_AXIS];
+volatile uint8_t sys_probe_state;
+volatile uint8_t sys_rt_exec_state;
+volatile uint8_t sys_rt_exec_alarm;
+volatile uint8_t sys_rt_exec_motion_override;
+volatile uint8_t sys_rt_exec_accessory_override;
+
+bool sim_bench;
+uint32_t sim_bench_blocks;
+
+// protocol.cpp ----------------------------------------------------------------------------
+
+static void sim_bench_drain()
+{
+  while (plan_get_current_block() != NULL) {
+    plan_discard_current_block();
+    sim_bench_blocks++;
+  }
+}
+
+void protocol_auto_cycle_start()
+{
+  if (sim_bench) {
+    // The buffer is full, so the oldest block is as planned as it will ever be.
+    if (plan_get_current_block() != NULL) {
+      plan_discard_current_block();
+      sim_bench_blocks++;
+    }
+    return;
+  }
+  if (plan_get_current_block() != NULL) {
+    system_set_exec_state_flag(EXEC_CYCLE_START);
+  }
+}
+
+void protocol_exec_rt_system()
+{
+  uint8_t rt_exec = sys_rt_exec_alarm;
+  if (rt_exec) {
+    sys.state = STATE_ALARM;
+    report_alarm_message(rt_exec);
+    sys.abort = true; // Nobody is there to clear the alarm.
+    system_clear_exec_alarm();
+  }
+
+  rt_exec = sys_rt_exec_state;
+  if (rt_exec & EXEC_RESET) {
+    sys.abort = true;
+    return;
+  }
+  if (rt_exec & EXEC_CYCLE_START) {
+    if (sys.state == STATE_IDLE) {
+      sys.step_control = STEP_CONTROL_NORMAL_OP;
+      if (plan_get_current_block()) {
+        sys.suspend = SUSPEND_DISABLE;
+        sys.state = STATE_CYCLE;
+        st_prep_buffer(); // Initialize step segment buffer before beginning cycle.
+        st_wake_up();
+      }
+    }
+    system_clear_exec_state_flag(EXEC_CYCLE_START);
+  }
+  if (rt_exec & EXEC_CYCLE_STOP) {
+    if (sys.state & (STATE_CYCLE | STATE_JOG | STATE_HOMING)) {
+      sys.suspend = SUSPEND_DISABLE;
+      sys.state = STATE_IDLE;
+      if (plan_get_current_block() == NULL) {
+        spindle_sync_flush();
+        coolant_sync_flush();
+      }
+    }
+    system_clear_exec_state_flag(EXEC_CYCLE_STOP);
+  }
+
+  if (sys.state & (STATE_CYCLE | STATE_HOLD | STATE_HOMING | STATE_JOG)) {
+    st_prep_buffer();
+  }
+}
+
+// One pass of the main loop. The stepper ISR keeps running while the main loop works, so
+// this is where the virtual clock moves forward.
+void protocol_execute_realtime()
+{
+  protocol_exec_rt_system();
+  sim_advance_ticks(SIM_MAIN_LOOP_TICKS);
+}
+
+void protocol_buffer_synchronize()
+{
+  if (sim_bench) {
+    sim_bench_drain();
+    return;
+  }
+  protocol_auto_cycle_start();
+  do {
+    protocol_execute_realtime();
+    if (sys.abort) { return; }
+  } while (protocol_motion_pending());
+}
+
+bool protocol_motion_pending()
+{
+  return((plan_get_current_block() != NULL) || (sys.state == STATE_CYCLE));
+}
+
+// system.cpp ------------------------------------------------------------------------------
+
+void system_set_exec_state_flag(uint8_t mask) { sys_rt_exec_state |= (mask); }
+void system_clear_exec_state_flag(uint8_t mask) { sys_rt_exec_state &= ~(mask); }
+void system_set_exec_alarm(uint8_t code) { sys_rt_exec_alarm = code; }
+void system_clear_exec_alarm() { sys_rt_exec_alarm = 0; }
+void system_set_exec_motion_override_flag(uint8_t mask) { sys_rt_exec_motion_override |= (mask); }
+void system_set_exec_accessory_override_flag(uint8_t mask) { sys_rt_exec_accessory_override |= (mask); }
+void system_clear_exec_motion_overrides() { sys_rt_exec_motion_override = 0; }
+void system_clear_exec_accessory_overrides() { sys_rt_exec_accessory_override = 0; }
+
+void system_flag_wco_change() { sys.report_wco_counter = 0; }
+
+float system_convert_axis_steps_to_mpos(int32_t *steps, uint8_t idx)
+{
+  return steps[idx]/settings.steps_per_mm[idx];
+}
+
+void system_convert_array_steps_to_mpos(float *position, int32_t *steps)
+{
+  for (uint8_t idx = 0; idx < N_AXIS; idx++) {
+    position[idx] = system_convert_axis_steps_to_mpos(steps, idx);
+  }
+}
+
+uint8_t system_check_travel_limits(float *) { return(false); }
+
+void sys_io_control(uint8_t, bool) {}
+
+// grbl_limits.cpp -------------------------------------------------------------------------
+
+void limits_init() {}
+void limits_disable() {}
+uint8_t limits_get_state() { return(0); }
+
+// There are no switches to find, so homing just declares the current position as home.
+void limits_go_home(uint8_t cycle_mask)
+{
+  for (uint8_t idx = 0; idx < N_AXIS; idx++) {
+    if (cycle_mask & bit(idx)) { sys_position[idx] = 0; }
+  }
+}
+
+void limits_soft_check(float *) {}
+
+bool axis_is_squared(uint8_t) { return(false); }
+
+// serial.cpp ------------------------------------------------------------------------------
+
+void serial_reset_read_buffer(uint8_t) {}
+
+// report.cpp ------------------------------------------------------------------------------
+
+void grbl_send(uint8_t, const char *text) { fputs(text, stderr); }
+
+void grbl_sendf(uint8_t, const char *format, ...)
+{
+  va_list arg;
+  va_start(arg, format);
+  vfprintf(stderr, format, arg);
+  va_end(arg);
+}
+
+void report_status_message(uint8_t status_code, uint8_t)
+{
+  if (status_code != STATUS_OK) {
+    fprintf(stderr, "error:%d\n", status_code);
+  }
+}
+
+void report_alarm_message(uint8_t alarm_code) { fprintf(stderr, "ALARM:%d\n", alarm_code); }
+void report_feedback_message(uint8_t message_code) { fprintf(stderr, "[MSG:%d]\n", message_code); }
+void report_grbl_settings(uint8_t) {}
+void report_probe_parameters(uint8_t) {}
+void report_gcode_comment(char *) {}
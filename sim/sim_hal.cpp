@@ -0,0 +1,329 @@
+/*
+  sim_hal.cpp - virtual machine behind the host simulator HAL shims
+  Part of Grbl_ESP32 simulator
+
+  The virtual clock counts stepper timer ticks (F_STEPPER_TIMER). Time only moves when
+  the simulated main loop lets it run (sim_advance_ticks) or when code spins in a
+  busy-wait (NOP), so every run of the same program produces the same step trace.
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+#include "sim.h"
+
+EEPROMClass EEPROM;
+timg_dev_t TIMERG0;
+gpio_dev_t GPIO;
+ledc_dev_t LEDC;
+
+sim_stats_t sim_stats;
+
+static uint64_t sim_ticks; // Virtual clock
+
+// Timer group 0 model: timer 0 is the stepper timer, timer 1 the step pulse timer. Both run at
+// the stepper timer rate.
+typedef struct {
+  bool running;
+  bool auto_reload;
+  uint64_t alarm;
+  uint64_t zero_tick; // Virtual time at which the counter was last zero.
+  void (*isr)(void *);
+  void *isr_arg;
+} sim_timer_t;
+static sim_timer_t timer[TIMER_MAX];
+
+// GPIO model
+static uint8_t pin_level[GPIO_NUM_MAX];
+static const int8_t step_pin[] = {
+#ifdef X_STEP_PIN
+  X_STEP_PIN,
+#else
+  -1,
+#endif
+#ifdef Y_STEP_PIN
+  Y_STEP_PIN,
+#else
+  -1,
+#endif
+#ifdef Z_STEP_PIN
+  Z_STEP_PIN,
+#else
+  -1,
+#endif
+#if (N_AXIS > A_AXIS)
+  #ifdef A_STEP_PIN
+    A_STEP_PIN,
+  #else
+    -1,
+  #endif
+#endif
+#if (N_AXIS > B_AXIS)
+  #ifdef B_STEP_PIN
+    B_STEP_PIN,
+  #else
+    -1,
+  #endif
+#endif
+#if (N_AXIS > C_AXIS)
+  #ifdef C_STEP_PIN
+    C_STEP_PIN,
+  #else
+    -1,
+  #endif
+#endif
+};
+static const int8_t direction_pin[] = {
+#ifdef X_DIRECTION_PIN
+  X_DIRECTION_PIN,
+#else
+  -1,
+#endif
+#ifdef Y_DIRECTION_PIN
+  Y_DIRECTION_PIN,
+#else
+  -1,
+#endif
+#ifdef Z_DIRECTION_PIN
+  Z_DIRECTION_PIN,
+#else
+  -1,
+#endif
+#if (N_AXIS > A_AXIS)
+  #ifdef A_DIRECTION_PIN
+    A_DIRECTION_PIN,
+  #else
+    -1,
+  #endif
+#endif
+#if (N_AXIS > B_AXIS)
+  #ifdef B_DIRECTION_PIN
+    B_DIRECTION_PIN,
+  #else
+    -1,
+  #endif
+#endif
+#if (N_AXIS > C_AXIS)
+  #ifdef C_DIRECTION_PIN
+    C_DIRECTION_PIN,
+  #else
+    -1,
+  #endif
+#endif
+};
+static uint8_t step_active_mask;  // Axes whose step pin is currently in its active (pulse) state
+static uint8_t step_pending_mask; // Axes that started a pulse since the last trace flush
+
+// LEDC model
+#define SIM_LEDC_CHANNELS 16
+static uint32_t ledc_duty[SIM_LEDC_CHANNELS];
+
+static FILE *trace_file;
+
+void sim_trace_open(FILE *file)
+{
+  trace_file = file;
+  if (trace_file) {
+    fprintf(trace_file, "# Grbl_ESP32 step trace, %lu ticks/sec\n", (unsigned long)F_STEPPER_TIMER);
+    fprintf(trace_file, "# <tick> S <step axis mask> <direction axis mask>\n");
+    fprintf(trace_file, "# <tick> P <ledc channel> <duty>\n");
+  }
+}
+
+static uint8_t sim_direction_mask()
+{
+  uint8_t mask = 0;
+  for (uint8_t idx = 0; idx < N_AXIS; idx++) {
+    if ((direction_pin[idx] >= 0) && pin_level[direction_pin[idx]]) { mask |= bit(idx); }
+  }
+  return mask;
+}
+
+// Pins written back-to-back by the ISR belong to the same instant, so a step event is only
+// emitted once the virtual clock moves on.
+static void sim_trace_flush()
+{
+  if (step_pending_mask) {
+    if (trace_file) {
+      fprintf(trace_file, "%llu S %02x %02x\n", (unsigned long long)sim_ticks, step_pending_mask, sim_direction_mask());
+    }
+    for (uint8_t idx = 0; idx < N_AXIS; idx++) {
+      if (step_pending_mask & bit(idx)) { sim_stats.steps[idx]++; }
+    }
+    step_pending_mask = 0;
+  }
+}
+
+uint64_t sim_get_ticks() { return sim_ticks; }
+
+void sim_cpu_spin()
+{
+  sim_trace_flush();
+  sim_ticks++;
+  sim_stats.spin_ticks++;
+}
+
+// Returns the timer whose alarm is due first, or TIMER_MAX when none is armed.
+static uint8_t sim_next_alarm(uint64_t *fire_tick)
+{
+  uint8_t next = TIMER_MAX;
+  for (uint8_t idx = 0; idx < TIMER_MAX; idx++) {
+    if (!timer[idx].running || !TIMERG0.hw_timer[idx].config.alarm_en || !timer[idx].isr) { continue; }
+    uint64_t tick = timer[idx].zero_tick + timer[idx].alarm;
+    if ((next == TIMER_MAX) || (tick < *fire_tick)) {
+      next = idx;
+      *fire_tick = tick;
+    }
+  }
+  return next;
+}
+
+void sim_advance_ticks(uint64_t ticks)
+{
+  uint64_t target = sim_ticks + ticks;
+  uint64_t fire_tick = 0;
+  uint8_t idx;
+  while ((idx = sim_next_alarm(&fire_tick)) != TIMER_MAX) {
+    if (fire_tick > target) { break; }
+    if (fire_tick < sim_ticks) {
+      if (idx == TIMER_0) { sim_stats.isr_overruns++; } // Previous ISR ran past this alarm.
+      fire_tick = sim_ticks;
+    }
+    sim_trace_flush();
+    sim_ticks = fire_tick;
+    if (timer[idx].auto_reload) { timer[idx].zero_tick = fire_tick; }
+    TIMERG0.hw_timer[idx].config.alarm_en = TIMER_ALARM_DIS; // Hardware disarms; the ISR re-arms.
+    if (idx == TIMER_0) { sim_stats.isr_calls++; }
+    timer[idx].isr(timer[idx].isr_arg);
+  }
+  sim_trace_flush();
+  if (sim_ticks < target) { sim_ticks = target; }
+}
+
+// ESP-IDF ---------------------------------------------------------------------------------
+
+int64_t esp_timer_get_time() { return sim_ticks / TICKS_PER_MICROSECOND; }
+
+// Only timer group 0 is modelled.
+esp_err_t timer_init(timer_group_t, timer_idx_t timer_num, const timer_config_t *config)
+{
+  timer[timer_num].running = (config->counter_en == TIMER_START);
+  timer[timer_num].auto_reload = config->auto_reload;
+  timer[timer_num].zero_tick = sim_ticks;
+  TIMERG0.hw_timer[timer_num].config.alarm_en = config->alarm_en;
+  return ESP_OK;
+}
+
+esp_err_t timer_set_counter_value(timer_group_t, timer_idx_t timer_num, uint64_t load_val)
+{
+  timer[timer_num].zero_tick = sim_ticks - load_val;
+  return ESP_OK;
+}
+
+esp_err_t timer_set_alarm_value(timer_group_t, timer_idx_t timer_num, uint64_t alarm_value)
+{
+  timer[timer_num].alarm = (alarm_value == 0) ? 1 : alarm_value;
+  return ESP_OK;
+}
+
+esp_err_t timer_start(timer_group_t, timer_idx_t timer_num)
+{
+  timer[timer_num].running = true;
+  return ESP_OK;
+}
+
+esp_err_t timer_pause(timer_group_t, timer_idx_t timer_num)
+{
+  timer[timer_num].running = false;
+  return ESP_OK;
+}
+
+esp_err_t timer_enable_intr(timer_group_t, timer_idx_t) { return ESP_OK; }
+
+esp_err_t timer_isr_register(timer_group_t, timer_idx_t timer_num, void (*fn)(void *), void *arg, int, void *)
+{
+  timer[timer_num].isr = fn;
+  timer[timer_num].isr_arg = arg;
+  return ESP_OK;
+}
+
+// GPIO ------------------------------------------------------------------------------------
+
+static void sim_gpio_write(uint8_t pin, uint8_t val)
+{
+  pin_level[pin] = (val != 0);
+  for (uint8_t idx = 0; idx < N_AXIS; idx++) {
+    if (step_pin[idx] != pin) { continue; }
+    bool active = pin_level[pin] ^ bit_istrue(settings.step_invert_mask, bit(idx));
+    if (active && !(step_active_mask & bit(idx))) { step_pending_mask |= bit(idx); }
+    if (active) { step_active_mask |= bit(idx); } else { step_active_mask &= ~bit(idx); }
+  }
+}
+
+void sim_gpio_write_mask(uint8_t bank, uint32_t mask, uint8_t level)
+{
+  for (uint8_t idx = 0; idx < 32; idx++) {
+    uint8_t pin = idx + (bank ? 32 : 0);
+    if ((mask & (1UL << idx)) && (pin < GPIO_NUM_MAX)) { sim_gpio_write(pin, level); }
+  }
+}
+
+// Arduino ---------------------------------------------------------------------------------
+
+void pinMode(uint8_t, uint8_t) {}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+  if (pin >= GPIO_NUM_MAX) { return; }
+  sim_gpio_write(pin, val);
+}
+
+int digitalRead(uint8_t pin) { return (pin < GPIO_NUM_MAX) ? pin_level[pin] : LOW; }
+
+unsigned long micros() { return sim_ticks / TICKS_PER_MICROSECOND; }
+unsigned long millis() { return sim_ticks / (TICKS_PER_MICROSECOND * 1000); }
+void delay(uint32_t ms) { sim_advance_ticks((uint64_t)ms * 1000 * TICKS_PER_MICROSECOND); }
+void delayMicroseconds(uint32_t us) { sim_advance_ticks((uint64_t)us * TICKS_PER_MICROSECOND); }
+
+double ledcSetup(uint8_t, double freq, uint8_t) { return freq; }
+void ledcAttachPin(uint8_t, uint8_t) {}
+
+void ledcWrite(uint8_t channel, uint32_t duty)
+{
+  if (channel >= SIM_LEDC_CHANNELS) { return; }
+  ledc_duty[channel] = duty;
+  if (trace_file) { fprintf(trace_file, "%llu P %u %u\n", (unsigned long long)sim_ticks, channel, duty); }
+}
+
+uint32_t ledcRead(uint8_t channel) { return (channel < SIM_LEDC_CHANNELS) ? ledc_duty[channel] : 0; }
+
+// LEDC registers, for the spindle PWM. The channel number follows from where the register is.
+static uint8_t sim_ledc_channel(const void *reg, size_t offset)
+{
+  const sim_ledc_channel_t *channel = (const sim_ledc_channel_t *)((const uint8_t *)reg - offset);
+  return channel - &LEDC.channel_group[0].channel[0];
+}
+
+sim_ledc_duty_start_t &sim_ledc_duty_start_t::operator=(uint32_t value)
+{
+  uint8_t channel = sim_ledc_channel(this, offsetof(sim_ledc_channel_t, conf1));
+  if (value) { ledcWrite(channel, LEDC.channel_group[channel / 8].channel[channel % 8].duty.duty >> 4); }
+  return *this;
+}
+
+sim_ledc_sig_out_en_t &sim_ledc_sig_out_en_t::operator=(uint32_t value)
+{
+  if (!value) { ledcWrite(sim_ledc_channel(this, offsetof(sim_ledc_channel_t, conf0)), 0); }
+  return *this;
+}
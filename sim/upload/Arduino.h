@@ -0,0 +1,42 @@
+/*
+  Arduino.h - host stand-in for the upload pipeline benchmark
+  Part of Grbl_ESP32 simulator
+
+  Just what upload_pipeline.cpp uses: millis() and FreeRTOS tasks, which run as host threads
+  (see bench.cpp).
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef sim_upload_arduino_h
+#define sim_upload_arduino_h
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef void *TaskHandle_t;
+
+#define portMAX_DELAY 0xffffffffUL
+#define portTICK_RATE_MS 1 // 1000Hz tick, as on the target
+
+uint32_t millis();
+void vTaskDelay(TickType_t ticks);
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char *name, uint32_t stack_depth, void *parameters,
+                                   int priority, TaskHandle_t *handle, int core);
+
+#endif
@@ -0,0 +1,39 @@
+/*
+  FS.h - host stand-in for the upload pipeline benchmark
+  Part of Grbl_ESP32 simulator
+
+  A File that stands for a file being written on the SD card. Every write takes as long as the
+  card would take for it, see bench.cpp.
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef sim_upload_fs_h
+#define sim_upload_fs_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+class File {
+public:
+  size_t write(const uint8_t *buf, size_t size);
+  operator bool() const { return true; }
+
+  uint32_t size = 0;
+  uint32_t writes = 0;
+  uint32_t hash = 2166136261u; // FNV-1a of everything written
+  uint32_t fail_at = 0;        // Writes past this size fail, 0 for never
+};
+
+#endif
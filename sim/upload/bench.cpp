@@ -0,0 +1,228 @@
+/*
+  bench.cpp - upload pipeline benchmark
+  Part of Grbl_ESP32 simulator
+
+  A fake HTTP client sends a file in the chunks the web server hands to the upload handlers,
+  no faster than the WiFi link allows, and waits for each chunk to be taken as TCP would. The
+  file is written to a fake SD card whose every write takes a fixed time plus a time per byte,
+  plus a sector read when the write does not end on a sector boundary. It is uploaded twice:
+  the way the handlers used to write it, one chunk at a time after a one tick delay, and
+  through upload_pipeline.cpp. FreeRTOS tasks and queues are host threads here, and the times
+  are real host time.
+
+    program [-s size KB] [-l link KB/s] [-w write us] [-b byte ns] [-r sector read us] [-f fail at KB]
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "upload_pipeline.h"
+#include <freertos/queue.h>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#define HTTP_UPLOAD_BUFLEN 1436 // Chunk size of the Arduino-ESP32 WebServer
+#define SECTOR_SIZE 512
+
+typedef std::chrono::steady_clock sim_clock;
+
+static sim_clock::time_point sim_start = sim_clock::now();
+
+// Fake card, set from the command line.
+static uint32_t card_write_us = 1000;     // Per write: FAT and directory updates, card busy time
+static uint32_t card_byte_ns = 400;       // SPI at 20MHz
+static uint32_t card_sector_read_us = 300; // Read back of a partly written sector
+
+static void sim_sleep_us(uint32_t us)
+{
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+static double sim_seconds()
+{
+  return std::chrono::duration<double>(sim_clock::now() - sim_start).count();
+}
+
+uint32_t millis()
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>(sim_clock::now() - sim_start).count();
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+  std::this_thread::sleep_for(std::chrono::milliseconds(ticks));
+}
+
+BaseType_t xTaskCreatePinnedToCore(void (*task)(void *), const char *name, uint32_t stack_depth, void *parameters,
+                                   int priority, TaskHandle_t *handle, int core)
+{
+  std::thread(task, parameters).detach();
+  if (handle) { *handle = (TaskHandle_t)1; }
+  return pdTRUE;
+}
+
+struct sim_queue {
+  std::mutex mutex;
+  std::condition_variable changed;
+  std::deque<std::string> items;
+  uint32_t length;
+  uint32_t item_size;
+};
+
+QueueHandle_t xQueueCreate(uint32_t length, uint32_t item_size)
+{
+  QueueHandle_t queue = new sim_queue;
+  queue->length = length;
+  queue->item_size = item_size;
+  return queue;
+}
+
+// Only waits forever or not at all, which is all the pipeline does.
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (queue->items.size() >= queue->length) {
+    if (ticks == 0) { return pdFALSE; }
+    queue->changed.wait(lock, [queue] { return queue->items.size() < queue->length; });
+  }
+  queue->items.push_back(std::string((const char *)item, queue->item_size));
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+  std::unique_lock<std::mutex> lock(queue->mutex);
+  if (queue->items.empty()) {
+    if (ticks == 0) { return pdFALSE; }
+    queue->changed.wait(lock, [queue] { return !queue->items.empty(); });
+  }
+  memcpy(item, queue->items.front().data(), queue->item_size);
+  queue->items.pop_front();
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+  std::lock_guard<std::mutex> lock(queue->mutex);
+  queue->items.clear();
+  queue->changed.notify_all();
+  return pdTRUE;
+}
+
+size_t File::write(const uint8_t *buf, size_t len)
+{
+  uint32_t us = card_write_us + (uint64_t)len * card_byte_ns / 1000;
+  if ((size + len) % SECTOR_SIZE) { us += card_sector_read_us; }
+  sim_sleep_us(us);
+  if (fail_at && (size + len > fail_at)) { return 0; }
+  for (size_t i = 0; i < len; i++) {
+    hash = (hash ^ buf[i]) * 16777619u;
+  }
+  size += len;
+  writes++;
+  return len;
+}
+
+typedef bool (*upload_handler_t)(File &file, const uint8_t *chunk, size_t len);
+
+// What SPIFFSFileupload() and SDFile_direct_upload() did with each chunk before the pipeline.
+static bool upload_per_chunk(File &file, const uint8_t *chunk, size_t len)
+{
+  vTaskDelay(1 / portTICK_RATE_MS);
+  return file.write(chunk, len) == len;
+}
+
+static bool upload_pipelined(File &file, const uint8_t *chunk, size_t len)
+{
+  return upload_write(chunk, len);
+}
+
+// The fake client. A chunk arrives a link time after the previous one, or as soon as the
+// handler is done with the previous one when the handler is slower than the link.
+static double bench_upload(File &file, const uint8_t *data, uint32_t size, uint32_t link_kbps,
+                           upload_handler_t handler, bool *ok)
+{
+  double start = sim_seconds();
+  double arrival = start;
+  *ok = true;
+  for (uint32_t pos = 0; (pos < size) && *ok; pos += HTTP_UPLOAD_BUFLEN) {
+    size_t len = (size - pos < HTTP_UPLOAD_BUFLEN) ? size - pos : HTTP_UPLOAD_BUFLEN;
+    arrival += (double)len / (link_kbps * 1024.0);
+    double now = sim_seconds();
+    if (arrival > now) {
+      sim_sleep_us((arrival - now) * 1e6);
+    } else {
+      arrival = now;
+    }
+    *ok = handler(file, data + pos, len);
+  }
+  return sim_seconds() - start;
+}
+
+int main(int argc, char *argv[])
+{
+  uint32_t size_kb = 1024;
+  uint32_t link_kbps = 1500;
+  uint32_t fail_kb = 0;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    uint32_t value = atoi(argv[i + 1]);
+    if (strcmp(argv[i], "-s") == 0) { size_kb = value; }
+    else if (strcmp(argv[i], "-l") == 0) { link_kbps = value; }
+    else if (strcmp(argv[i], "-w") == 0) { card_write_us = value; }
+    else if (strcmp(argv[i], "-b") == 0) { card_byte_ns = value; }
+    else if (strcmp(argv[i], "-r") == 0) { card_sector_read_us = value; }
+    else if (strcmp(argv[i], "-f") == 0) { fail_kb = value; }
+    else { fprintf(stderr, "unknown option %s\n", argv[i]); return 1; }
+  }
+  uint32_t size = size_kb * 1024 + 123; // Not a whole number of chunks or buffers
+  uint8_t *data = (uint8_t *)malloc(size);
+  uint32_t hash = 2166136261u;
+  for (uint32_t i = 0; i < size; i++) {
+    data[i] = (i * 2654435761u) >> 24;
+    hash = (hash ^ data[i]) * 16777619u;
+  }
+  fprintf(stderr, "upload %u bytes in %u byte chunks over a %u KB/s link\n", size, HTTP_UPLOAD_BUFLEN, link_kbps);
+  fprintf(stderr, "card write %u us + %u ns/byte, %u us more for a partial sector\n", card_write_us, card_byte_ns,
+          card_sector_read_us);
+
+  bool ok;
+  File direct;
+  direct.fail_at = fail_kb * 1024;
+  double elapsed = bench_upload(direct, data, size, link_kbps, upload_per_chunk, &ok);
+  fprintf(stderr, "per chunk: %s in %.3f s, %.0f KB/s, %u writes\n", ok ? "done" : "failed", elapsed,
+          direct.size / 1024.0 / elapsed, direct.writes);
+  bool failed = (ok != (direct.hash == hash));
+
+  File piped;
+  piped.fail_at = fail_kb * 1024;
+  double start = sim_seconds();
+  if (!upload_begin(piped)) { return 1; }
+  bench_upload(piped, data, size, link_kbps, upload_pipelined, &ok);
+  if (ok) {
+    ok = upload_end();
+  } else {
+    upload_abort();
+  }
+  elapsed = sim_seconds() - start; // Up to the last write, which the handler waits for too
+  fprintf(stderr, "pipeline:  %s in %.3f s, %.0f KB/s, %u writes, upload_rate() %u KB/s\n", ok ? "done" : "failed",
+          elapsed, piped.size / 1024.0 / elapsed, piped.writes, upload_rate() / 1024);
+  failed |= (ok != (piped.hash == hash));
+  if (failed) { fprintf(stderr, "written data does not match the result\n"); }
+  return failed ? 1 : 0;
+}
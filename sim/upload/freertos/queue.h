@@ -0,0 +1,34 @@
+/*
+  queue.h - host stand-in for FreeRTOS queues, for the upload pipeline benchmark
+  Part of Grbl_ESP32 simulator
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef sim_upload_queue_h
+#define sim_upload_queue_h
+
+#include "Arduino.h"
+
+#define pdTRUE 1
+#define pdFALSE 0
+
+typedef struct sim_queue *QueueHandle_t;
+
+QueueHandle_t xQueueCreate(uint32_t length, uint32_t item_size);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+BaseType_t xQueueReset(QueueHandle_t queue);
+
+#endif
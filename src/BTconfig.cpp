@@ -28,6 +28,7 @@
 #include "BTconfig.h"
 #include "commands.h"
 #include "report.h"
+#include "serial.h"
 
 BTConfig bt_config;
 BluetoothSerial SerialBT;
@@ -68,6 +69,9 @@ static void my_spp_cb(esp_spp_cb_event_t event, esp_spp_cb_param_t *param)
         grbl_send(CLIENT_ALL,"[MSG:BT Disconnected]\r\n");
         BTConfig::_btclient="";
         break;
+    case ESP_SPP_DATA_IND_EVT://Data received, already queued by SerialBT
+        serial_wake();
+        break;
     default:
         break;
     }
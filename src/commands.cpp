@@ -43,6 +43,7 @@
 #include <WiFi.h>
 #include <FS.h>
 #include <SPIFFS.h>
+#include "gzip_stream.h"
 #include <esp_wifi.h>
 #include <esp_ota_ops.h>
 
@@ -68,6 +69,20 @@ void COMMANDS::wait(uint32_t milliseconds){
     }
 }
 
+//read next line of a local file, without the '\n', inflating it if it is compressed
+static bool read_local_line(File & file, gz_stream_t * gz, String & line)
+{
+    if (!gz) {
+        if (!file.available()) return false;
+        line = file.readStringUntil('\n');
+        return true;
+    }
+    line = "";
+    int c;
+    while (((c = gz_getc(gz)) >= 0) && (c != '\n')) line += (char)c;
+    return (c >= 0) || (line.length() > 0);
+}
+
 bool COMMANDS::execute_internal_command (int cmd, String cmd_params, level_authenticate_type auth_level,  ESPResponseStream  *espresponse)
 {
     bool response = true;
@@ -963,20 +978,87 @@ bool COMMANDS::execute_internal_command (int cmd, String cmd_params, level_authe
                 espresponse->println ("");
                 return false;
                 }
-            char fileLine[255];
             SD_client = (espresponse)?espresponse->client(): CLIENT_ALL;
-            if (!readFileLine(fileLine)) {
-					//No need notification here it is just a macro
-                    closeFile();
-                    espresponse->println ("");
-                    return false;
-            } else {
-                report_status_message(gc_execute_line(fileLine, (espresponse)?espresponse->client(): CLIENT_ALL), (espresponse)?espresponse->client(): CLIENT_ALL);  // execute the first line
-                }
+            SD_ready_next = true; // the main loop takes the first line, text or precompiled, from the streamer
             report_realtime_status( (espresponse)?espresponse->client(): CLIENT_ALL);
             espresponse->println ("");
             }
             break;
+        //Precompile SD file into <name>.gcb, which [ESP220] runs without parsing the text
+        //[ESP221]<filename>
+        case 221:
+            {
+            if (!espresponse) return false;
+#ifdef ENABLE_AUTHENTICATION
+            if (auth_type == LEVEL_GUEST) {
+                espresponse->println ("Error: Wrong authentication!");
+                return false;
+                }
+#endif   
+            parameter = get_param (cmd_params, "", true);
+            if (parameter.length() == 0){
+                espresponse->println ("Error: Missing file name!");
+                return false;
+                }
+            int8_t state = get_sd_state(true);
+            if (state  !=  SDCARD_IDLE) {
+                espresponse->println ((state == SDCARD_NOT_PRESENT) ? "No SD card" : "Busy");
+                return false;
+                }
+            // Compiles in the background. The line count or the error follows when it is done.
+            uint8_t status_code = sd_compile_file(SD, parameter.c_str(), espresponse->client());
+            if (status_code != STATUS_OK) {
+                report_status_message(status_code, espresponse->client());
+                return false;
+                }
+            espresponse->println ("ok");
+            }
+            break;
+        //Run SD file from a line on, with the modes the lines before it set
+        //[ESP222]<line> <filename>
+        case 222:
+            {
+#ifdef ENABLE_AUTHENTICATION
+            if (auth_type == LEVEL_GUEST) {
+                if(espresponse)espresponse->println ("Error: Wrong authentication!");
+                return false;
+                }
+#endif   
+            parameter = get_param (cmd_params, "", true);
+            int pos = parameter.indexOf(' ');
+            uint32_t line_number = (pos > 0) ? parameter.substring(0, pos).toInt() : 0;
+            if (line_number == 0){
+                if(espresponse)espresponse->println ("Error: Missing line number!");
+                return false;
+                }
+            parameter = parameter.substring(pos + 1);
+            parameter.trim();
+            if (parameter.length() == 0){
+                if(espresponse)espresponse->println ("Error: Missing file name!");
+                return false;
+                }
+            int8_t state = get_sd_state(true);
+            if (state  !=  SDCARD_IDLE) {
+                if(espresponse)espresponse->println ((state == SDCARD_NOT_PRESENT) ? "No SD card" : "Busy");
+                return false;
+                }
+            if (sys.state != STATE_IDLE) { 
+                if(espresponse)espresponse->println ("Busy");
+                return false;
+                }
+            uint8_t client = (espresponse)?espresponse->client(): CLIENT_ALL;
+            uint8_t status_code = sd_resume_file(SD, parameter.c_str(), line_number, client);
+            if (status_code != STATUS_OK){
+                report_status_message(status_code, client);
+                if(espresponse)espresponse->println ("");
+                return false;
+                }
+            SD_client = client;
+            SD_ready_next = true;
+            report_realtime_status(client);
+            if(espresponse)espresponse->println ("");
+            }
+            break;
 #endif
         //Get full ESP32  settings content
         //[ESP400]
@@ -1906,11 +1988,16 @@ bool COMMANDS::execute_internal_command (int cmd, String cmd_params, level_authe
             response = false;
         } else {
             File currentfile = SPIFFS.open (parameter, FILE_READ);
+            //a gzip compressed file is inflated as it is read
+            gz_stream_t *gz = NULL;
+            if (currentfile && gz_is_compressed(currentfile)) {
+                gz = gz_begin(currentfile, NULL, 0);
+                if (!gz) currentfile.close();
+                }
             if (currentfile) {//if file open success
+                String currentline;
                 //until no line in file
-                while (currentfile.available()) {
-                    String currentline = currentfile.readStringUntil('\n');
-                    currentline.replace("\n","");
+                while (read_local_line(currentfile, gz, currentline)) {
                     currentline.replace("\r","");
                     if (currentline.length() > 0) {
                         int ESPpos = currentline.indexOf ("[ESP");
@@ -1967,6 +2054,7 @@ bool COMMANDS::execute_internal_command (int cmd, String cmd_params, level_authe
                     wait (1);
                     }
                 }
+                if (gz) gz_end(gz);
                 currentfile.close();
                  if (espresponse)espresponse->println ("ok");
             } else {
@@ -2062,6 +2150,23 @@ bool COMMANDS::execute_internal_command (int cmd, String cmd_params, level_authe
             if (espresponse)espresponse->println (resp.c_str());
         }   
             break;
+#ifdef STEPPER_ISR_PROFILE
+        //Stepper ISR profile, same as $P / $PR
+        //[ESP900]<RESET>
+        case 900:
+            if (!espresponse)return false;
+            parameter = get_param (cmd_params, "", true);
+            if (parameter == "RESET") {
+                st_profile_reset();
+                espresponse->println ("ok");
+            } else if (parameter.length() == 0) {
+                report_stepper_profile(espresponse->client());
+            } else {
+                espresponse->println ("Error: Incorrect Command");
+                response = false;
+            }
+            break;
+#endif
         default:
              if (espresponse)espresponse->println ("Error: Incorrect Command");
             response = false;
@@ -2213,6 +2318,7 @@ void COMMANDS::handle() {
     COMMANDS::wait(0);
     //in case of restart requested
     if (restart_ESP_module) {
+        serial_tx_flush(500); //let the last messages out
         ESP.restart();
         while (1) {};
     }
@@ -73,6 +73,19 @@ Some features should not be changed. See notes below.
 #define ENABLE_CAPTIVE_PORTAL
 //#define ENABLE_AUTHENTICATION
 
+// The host simulator build (PlatformIO env:native) has no radio, file system or display, so
+// every network and storage service is compiled out and only the motion core remains.
+#ifdef GRBL_SIMULATOR
+    #undef ENABLE_BLUETOOTH
+    #undef ENABLE_SD_CARD
+    #undef ENABLE_WIFI
+    #undef ENABLE_HTTP
+    #undef ENABLE_NOTIFICATIONS
+    #undef ENABLE_SERIAL2SOCKET_IN
+    #undef ENABLE_SERIAL2SOCKET_OUT
+    #undef ENABLE_CAPTIVE_PORTAL
+#endif
+
 #define NAMESPACE "GRBL ESP32 Plus"
 #define ESP_RADIO_MODE "RADIO_MODE"
 
@@ -395,6 +408,12 @@ Some features should not be changed. See notes below.
 // step smoothing. See stepper.c for more details on the AMASS system works.
 #define ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING  // Default enabled. Comment to disable.
 
+// Measures the stepper driver interrupt with the CPU cycle counter: time spent in the ISR and the
+// jitter of the step interval, both per AMASS level, plus a log of the most recent step segments.
+// Report with $P (allowed while running) or [ESP900], clear with $PR or [ESP900]RESET. Adds a few
+// hundred nanoseconds to every ISR, so leave it off for production builds.
+// #define STEPPER_ISR_PROFILE // Default disabled. Uncomment to enable.
+
 // Sets the maximum step rate allowed to be written as a Grbl setting. This option enables an error
 // check in the settings module to prevent settings values that will exceed this limitation. The maximum
 // step rate is strictly limited by the CPU speed and will change if something other than an AVR running
@@ -505,6 +524,15 @@ Some features should not be changed. See notes below.
 // While this is experimental, it is intended to be the future default method after testing
 //#define USE_RMT_STEPS
 
+// Ends each step pulse with a one shot alarm on a second hardware timer (timer group 0, timer 1)
+// instead of spinning in the stepper ISR for the pulse time ($0). The stepper ISR returns as soon as
+// the next step is computed, which leaves more of each step period for other axes and AMASS levels.
+// Ignored when USE_RMT_STEPS is defined. Comment to go back to the busy-wait pulse.
+#define USE_STEP_PULSE_TIMER // Default enabled. Comment to disable.
+#ifdef USE_RMT_STEPS
+	#undef USE_STEP_PULSE_TIMER // The RMT ends the pulse itself
+#endif
+
 // Creates a delay between the direction pin setting and corresponding step pulse by creating
 // another interrupt (Timer2 compare) to manage it. The main Grbl interrupt (Timer1 compare)
 // sets the direction pins, and does not immediately set the stepper pins, as it would in
@@ -517,11 +545,10 @@ Some features should not be changed. See notes below.
 // must use #define USE_RMT_STEPS for this to work
 //#define STEP_PULSE_DELAY 10 // Step pulse delay in microseconds. Default disabled.
 
-// The number of linear motions in the planner buffer to be planned at any give time. The vast
-// majority of RAM that Grbl uses is based on this buffer size. Only increase if there is extra
-// available RAM, like when re-compiling for a Mega2560. Or decrease if the Arduino begins to
-// crash due to the lack of available RAM or if the CPU is having trouble keeping up with planning
-// new incoming motions as they are executed.
+// The default number of linear motions in the planner buffer to be planned at any give time. The
+// buffer is allocated at boot with the size in setting $37 (16 to 256 blocks), in PSRAM when internal
+// RAM is short on boards that have it. Deep buffers let long chains of short segments (CAM curves)
+// reach their programmed feed. This value is only the default for $37.
 #define BLOCK_BUFFER_SIZE 64 // Uncomment to override default in planner.h.
 
 // Governs the size of the intermediary step segment buffer between the step execution algorithm
@@ -552,8 +579,30 @@ Some features should not be changed. See notes below.
 // 115200 baud will take 5 msec to transmit a typical 55 character report. Worst case reports are
 // around 90-100 characters. As long as the serial TX buffer doesn't get continually maxed, Grbl
 // will continue operating efficiently. Size the TX buffer around the size of a worst-case report.
- #define RX_BUFFER_SIZE 254 // (1-254) Uncomment to override defaults in serial.h
- #define TX_BUFFER_SIZE 254 // (1-254)
+// NOTE: Each client has its own receive buffer of RX_BUFFER_SIZE. Senders that read the Bf: field
+// of the status report can keep more lines in flight with a deeper buffer.
+// NOTE: Each output (serial, Bluetooth, WebUI and telnet) has its own send buffer of TX_BUFFER_SIZE
+// and a task that empties it at the output's own pace. TX_OVERFLOW_POLICY says what happens when a
+// peer falls behind and its buffer fills: TX_OVERFLOW_BLOCK waits for it, as a direct write would.
+// TX_OVERFLOW_DROP_OLDEST waits TX_STALL_MS at most and then drops the oldest text for that peer
+// only. TX_OVERFLOW_COALESCE also sends status reports ahead of the queue, and a new one replaces
+// one that is still waiting, so a slow peer gets the latest state instead of a backlog.
+ #define RX_BUFFER_SIZE 1024 // (1-65534) Uncomment to override defaults in serial.h
+ #define TX_BUFFER_SIZE 1024 // (256-65534)
+ #define TX_OVERFLOW_POLICY TX_OVERFLOW_COALESCE
+ #define TX_STALL_MS 50
+
+// Job ownership. The client whose G-code is running owns the machine until it has been idle for
+// JOB_OWNER_RELEASE_MS. Meanwhile the other clients can still send real-time commands, '$' and
+// '[ESP' commands, but their G-code is rejected with error:40 (STATUS_NOT_JOB_OWNER, "another
+// client's job is running"), so a second browser or a pendant can watch a job without adding moves
+// to it. A running SD job owns the machine the same way. The main loop takes lines from the clients
+// in turn, one at a time, and JOB_OWNER_LINES at a time from the owner, so monitoring clients do not
+// slow its stream down. Senders that share the machine with another client, such as a GUI next to
+// the web UI, need to handle error:40 before this is enabled. Default disabled.
+// #define ENABLE_JOB_OWNERSHIP // Default disabled. Uncomment to enable.
+#define JOB_OWNER_RELEASE_MS 2000 // Idle time before another client can take over
+#define JOB_OWNER_LINES 4
 
 // A simple software debouncing feature for hard limit switches. When enabled, the limit 
 // switch interrupt unblock a waiting task which will recheck the limit switch pins after 
@@ -682,6 +731,23 @@ Some features should not be changed. See notes below.
 // to ensure the laser doesn't inadvertently remain powered while at a stop and cause a fire.
 #define DISABLE_LASER_DURING_HOLD // Default enabled. Comment to disable.
 
+// Raster engraving in laser mode. A G1 move may end with a D word holding a run of pixels, two
+// hex digits each, e.g. G1X20D00407FC0FF. The pixels are spread evenly over the move, pixel p
+// runs at the power of S*p/255 and the stepper ISR changes the PWM at each pixel boundary, so a
+// scan line is one block instead of one G1 S line per pixel. The D word takes the rest of the
+// line, so a row holds a little under LINE_BUFFER_SIZE/2 pixels and a longer one is error 42.
+// Lines with D are an error outside laser mode or on anything but a G1 move with axis words.
+// Pixels wait in a ring of RASTER_BUFFER_SIZE bytes next to the planner buffer.
+#define LASER_RASTER // Default enabled. Comment to disable.
+#ifndef VARIABLE_SPINDLE
+  #undef LASER_RASTER // The pixels set the spindle PWM
+#endif
+
+// Keeps the time and duty of the most recent spindle PWM writes, for checking laser power against
+// motion. Report with $W (allowed while running), clear with $WR. SPINDLE_PWM_TRACE_SIZE sets how
+// many writes are kept. Costs a few hundred nanoseconds per write, in the stepper ISR.
+// #define SPINDLE_PWM_TRACE // Default disabled. Uncomment to enable.
+
 // Enables a piecewise linear model of the spindle PWM/speed output. Requires a solution by the
 // 'fit_nonlinear_spindle.py' script in the /doc/script folder of the repo. See file comments 
 // on how to gather spindle data and run the script to generate a solution.
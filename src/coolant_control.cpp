@@ -23,9 +23,12 @@
 
 #include "grbl.h"
 
+static bool coolant_sync_pending = false; // coolant_sync() left a change to the queued motion
+
 
 void coolant_init()
 {
+  coolant_sync_pending = false;
 	#ifdef COOLANT_FLOOD_PIN
 		pinMode(COOLANT_FLOOD_PIN, OUTPUT);
 	#endif
@@ -73,19 +76,29 @@ uint8_t coolant_get_state()
 // an interrupt-level. No report flag set, but only called by routines that don't need it.
 void coolant_stop()
 {
+  coolant_write_state(COOLANT_DISABLE);
+}
+
+
+// Drives the flood and the mist pin on or off as the mode says, so a mode with one of them
+// turns the other off. No abort check and no report flag, so the stepper ISR can set the
+// coolant of a block as it starts.
+void IRAM_ATTR coolant_write_state(uint8_t mode)
+{
+  (void)mode; // Unused without coolant pins
 	#ifdef COOLANT_FLOOD_PIN
 		#ifdef INVERT_COOLANT_FLOOD_PIN
-			digitalWrite(COOLANT_FLOOD_PIN, 1);    
+			grbl_digitalWrite(COOLANT_FLOOD_PIN, !(mode & COOLANT_FLOOD_ENABLE));
 		#else
-			digitalWrite(COOLANT_FLOOD_PIN, 0);
+			grbl_digitalWrite(COOLANT_FLOOD_PIN, (mode & COOLANT_FLOOD_ENABLE) != 0);
 		#endif
 	#endif
 	
   #ifdef COOLANT_MIST_PIN
     #ifdef INVERT_COOLANT_MIST_PIN
-      digitalWrite(COOLANT_MIST_PIN, 1);
+      grbl_digitalWrite(COOLANT_MIST_PIN, !(mode & COOLANT_MIST_ENABLE));
     #else
-      digitalWrite(COOLANT_MIST_PIN, 0);
+      grbl_digitalWrite(COOLANT_MIST_PIN, (mode & COOLANT_MIST_ENABLE) != 0);
     #endif
   #endif
 }
@@ -99,42 +112,39 @@ void coolant_set_state(uint8_t mode)
 {
   if (sys.abort) { return; } // Block during abort.  
   
-  if (mode == COOLANT_DISABLE) {
-  
-    coolant_stop(); 
-  
-  } else {
-		
-		#ifdef COOLANT_FLOOD_PIN 
-    if (mode & COOLANT_FLOOD_ENABLE) {
-      #ifdef INVERT_COOLANT_FLOOD_PIN
-        digitalWrite(COOLANT_FLOOD_PIN, 0);
-      #else
-        digitalWrite(COOLANT_FLOOD_PIN, 1);
-      #endif
-    }
-		#endif
-  
-    #ifdef COOLANT_MIST_PIN
-      if (mode & COOLANT_MIST_ENABLE) {
-        #ifdef INVERT_COOLANT_MIST_PIN
-          digitalWrite(COOLANT_MIST_PIN, 0);
-        #else
-          digitalWrite(COOLANT_MIST_PIN, 1);
-        #endif
-      }
-    #endif
-  
-  }
+  coolant_write_state(mode);
   sys.report_ovr_counter = 0; // Set to report change immediately
 }
 
 
-// G-code parser entry-point for setting coolant state. Forces a planner buffer sync and bails 
-// if an abort or check-mode is active.
+// G-code parser entry-point for setting coolant state. Bails if check-mode is active. While
+// motion is queued, the state goes with the next planner block and the stepper sets it as that
+// block starts, or coolant_sync_flush() does once the motion is done.
 void coolant_sync(uint8_t mode)
 {
   if (sys.state == STATE_CHECK_MODE) { return; }
-  protocol_buffer_synchronize(); // Ensure coolant turns on when specified in program.
+  if (protocol_motion_pending()) {
+    coolant_sync_pending = true;
+    return;
+  }
+  coolant_sync_pending = false;
   coolant_set_state(mode);
 }
+
+
+// Called by the planner as a block takes the coolant state. The stepper sets it from there.
+void coolant_sync_planned()
+{
+  coolant_sync_pending = false;
+}
+
+
+// Called when a cycle ends with the planner empty and no block carried the change. The parser state is set rather than the mode
+// coolant_sync() got, so a coolant override toggled since then is kept.
+void coolant_sync_flush()
+{
+  if (coolant_sync_pending) {
+    coolant_sync_pending = false;
+    coolant_set_state(gc_state.modal.coolant);
+  }
+}
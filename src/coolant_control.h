@@ -44,7 +44,16 @@ void coolant_stop();
 // Sets the coolant pins according to state specified.
 void coolant_set_state(uint8_t mode);
 
+// Sets both coolant pins on or off from the mode. Safe to call from the stepper ISR.
+void coolant_write_state(uint8_t mode);
+
 // G-code parser entry-point for setting coolant states. Checks for and executes additional conditions.
 void coolant_sync(uint8_t mode);
 
+// Drops a pending coolant change once a planner block carries it.
+void coolant_sync_planned();
+
+// Sets a coolant state coolant_sync() left to the motion queued ahead of it.
+void coolant_sync_flush();
+
 #endif
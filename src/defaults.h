@@ -132,6 +132,10 @@
 	#define DEFAULT_SPINDLE_MAX_VALUE 100.0 // $36 Percent (extended set)
 #endif
 
+#ifndef DEFAULT_PLANNER_BLOCKS
+	#define DEFAULT_PLANNER_BLOCKS BLOCK_BUFFER_SIZE // $37 blocks
+#endif
+
 #ifndef  DEFAULT_SPINDLE_RPM_MAX
 	#define DEFAULT_SPINDLE_RPM_MAX 1000.0 // rpm
 #endif
@@ -30,11 +30,6 @@
 #define MAX_LINE_NUMBER 10000000
 #define MAX_TOOL_NUMBER 255 // Limited by max unsigned 8-bit value
 
-#define AXIS_COMMAND_NONE 0
-#define AXIS_COMMAND_NON_MODAL 1
-#define AXIS_COMMAND_MOTION_MODE 2
-#define AXIS_COMMAND_TOOL_LENGTH_OFFSET 3 // *Undefined but required
-
 // Declare gc extern struct
 parser_state_t gc_state;
 parser_block_t gc_block;
@@ -59,30 +54,36 @@ void gc_sync_position()
 	system_convert_array_steps_to_mpos(gc_state.position,sys_position);
 }
 
-// Executes one line of 0-terminated G-Code. The line is assumed to contain only uppercase
-// characters and signed floating point values (no whitespace). Comments and block delete
-// characters have been removed. In this function, all units and positions are converted and
-// exported to grbl's internal functions in terms of (mm, mm/min) and absolute machine
-// coordinates, respectively.
-uint8_t gc_execute_line(char *line, uint8_t client)
+#ifdef LASER_RASTER
+// Value of a hex digit, 0xff for anything else.
+static uint8_t gc_hex_digit(char c)
+{
+	if ((c >= '0') && (c <= '9')) {
+		return(c-'0');
+	}
+	if ((c >= 'A') && (c <= 'F')) {
+		return(c-'A'+10);
+	}
+	return(0xff);
+}
+#endif
+
+// Imports the words of one line of 0-terminated G-Code into a parsed block (STEPs 1 and 2). The
+// line is assumed to contain only uppercase characters and signed floating point values (no
+// whitespace). Comments and block delete characters have been removed. This step only looks at
+// the line, not at the parser state, so a block may be parsed well before it is executed.
+uint8_t gc_parse_line(char *line, gc_parsed_block_t *parsed)
 {
 	/* -------------------------------------------------------------------------------------
-	   STEP 1: Initialize parser block struct and copy current g-code state modes. The parser
-	   updates these modes and commands as the block line is parser and will only be used and
-	   executed after successful error-checking. The parser block struct also contains a block
-	   values struct, word tracking variables, and a non-modal commands tracker for the new
-	   block. This struct contains all of the necessary information to execute the block. */
+	   STEP 1: Initialize parser block struct. The block only records the commands and values of
+	   this line. Which modal groups and value words were given is kept in the command and value
+	   word tracking variables, and the current g-code state modes are merged in when the block is
+	   executed. */
 
-	memset(&gc_block, 0, sizeof(parser_block_t)); // Initialize the parser block struct.
-	memcpy(&gc_block.modal,&gc_state.modal,sizeof(gc_modal_t)); // Copy current modes
+	memset(parsed, 0, sizeof(gc_parsed_block_t)); // Initialize the parser block struct.
+	parser_block_t *block = &parsed->block;
 
 	uint8_t axis_command = AXIS_COMMAND_NONE;
-	uint8_t axis_0, axis_1, axis_linear;
-	uint8_t coord_select = 0; // Tracks G10 P coordinate selection for execution
-
-	// Initialize bitflag tracking variables for axis indices compatible operations.
-	uint8_t axis_words = 0; // XYZ tracking
-	uint8_t ijk_words = 0; // IJK tracking
 
 	// Initialize command and value words and parser flags variables.
 	uint16_t command_words = 0; // Tracks G and M command words. Also used for modal group violations.
@@ -91,12 +92,10 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 
 	// Determine if the line is a jogging motion or a normal g-code block.
 	if (line[0] == '$') { // NOTE: `$J=` already parsed when passed to this function.
-		// Set G1 and G94 enforced modes to ensure accurate error checks.
+		// G1 and G94 are enforced when the block is executed.
 		gc_parser_flags |= GC_PARSER_JOG_MOTION;
-		gc_block.modal.motion = MOTION_MODE_LINEAR;
-		gc_block.modal.feed_rate = FEED_RATE_MODE_UNITS_PER_MIN;
 #ifdef USE_LINE_NUMBERS
-		gc_block.values.n = JOG_LINE_NUMBER; // Initialize default line number reported during jog.
+		block->values.n = JOG_LINE_NUMBER; // Initialize default line number reported during jog.
 #endif
 	}
 
@@ -126,6 +125,28 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 			FAIL(STATUS_EXPECTED_COMMAND_LETTER);    // [Expected word letter]
 		}
 		char_counter++;
+#ifdef LASER_RASTER
+		if (letter == 'D') {
+			// Raster pixels, two hex digits each up to the end of the line. Their hex letters
+			// would read as words, so nothing can follow them.
+			while (line[char_counter] != 0) {
+				uint8_t high = gc_hex_digit(line[char_counter]);
+				uint8_t low = gc_hex_digit(line[char_counter+1]);
+				if ((high > 0xf) || (low > 0xf)) {
+					FAIL(STATUS_BAD_NUMBER_FORMAT);    // [Odd digit count or not hex]
+				}
+				if (parsed->raster_count == GC_RASTER_MAX_PIXELS) {
+					FAIL(STATUS_RASTER_TOO_LONG);    // [Raster row too long]
+				}
+				parsed->raster[parsed->raster_count++] = (high << 4) | low;
+				char_counter += 2;
+			}
+			if (parsed->raster_count == 0) {
+				FAIL(STATUS_BAD_NUMBER_FORMAT);    // [Expected word value]
+			}
+			continue;
+		}
+#endif
 		if (!read_float(line, &char_counter, &value)) {
 			FAIL(STATUS_BAD_NUMBER_FORMAT);    // [Expected word value]
 		}
@@ -163,16 +184,16 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 					}
 					axis_command = AXIS_COMMAND_NON_MODAL;
 				}
-			// No break. Continues to next line.
+			// Falls through - no break, continues to next line.
 			case 4:
 			case 53:
 				word_bit = MODAL_GROUP_G0;
-				gc_block.non_modal_command = int_value;
+				block->non_modal_command = int_value;
 				if ((int_value == 28) || (int_value == 30) || (int_value == 92)) {
 					if (!((mantissa == 0) || (mantissa == 10))) {
 						FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND);
 					}
-					gc_block.non_modal_command += mantissa;
+					block->non_modal_command += mantissa;
 					mantissa = 0; // Set to zero to indicate valid non-integer G command.
 				}
 				break;
@@ -181,28 +202,22 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 			case 2:
 			case 3:
 
-			case 38:
-				#ifndef PROBE_PIN //only allow G38 "Probe" commands if a probe pin is defined.
-					if (int_value == 38) {
-						grbl_send(CLIENT_SERIAL, "[MSG:No probe pin defined!]\r\n");
-						FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND); // [Unsupported G command]
-					}
-				#endif
+			case 38: // Refused by gc_execute_block() without a probe pin.
 				// Check for G0/1/2/3/38 being called with G10/28/30/92 on same block.
 				// * G43.1 is also an axis command but is not explicitly defined this way.
 				if (axis_command) {
 					FAIL(STATUS_GCODE_AXIS_COMMAND_CONFLICT);    // [Axis word/command conflict]
 				}
 				axis_command = AXIS_COMMAND_MOTION_MODE;
-			// No break. Continues to next line.
+			// Falls through - no break, continues to next line.
 			case 80:
 				word_bit = MODAL_GROUP_G1;
-				gc_block.modal.motion = int_value;
+				block->modal.motion = int_value;
 				if (int_value == 38) {
 					if (!((mantissa == 20) || (mantissa == 30) || (mantissa == 40) || (mantissa == 50))) {
 						FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND); // [Unsupported G38.x command]
 					}
-					gc_block.modal.motion += (mantissa/10)+100;
+					block->modal.motion += (mantissa/10)+100;
 					mantissa = 0; // Set to zero to indicate valid non-integer G command.
 				}
 				break;
@@ -210,13 +225,13 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 			case 18:
 			case 19:
 				word_bit = MODAL_GROUP_G2;
-				gc_block.modal.plane_select = int_value - 17;
+				block->modal.plane_select = int_value - 17;
 				break;
 			case 90:
 			case 91:
 				if (mantissa == 0) {
 					word_bit = MODAL_GROUP_G3;
-					gc_block.modal.distance = int_value - 90;
+					block->modal.distance = int_value - 90;
 				} else {
 					word_bit = MODAL_GROUP_G4;
 					if ((mantissa != 10) || (int_value == 90)) {
@@ -229,18 +244,18 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 			case 93:
 			case 94:
 				word_bit = MODAL_GROUP_G5;
-				gc_block.modal.feed_rate = 94 - int_value;
+				block->modal.feed_rate = 94 - int_value;
 				break;
 			case 20:
 			case 21:
 				word_bit = MODAL_GROUP_G6;
-				gc_block.modal.units = 21 - int_value;
+				block->modal.units = 21 - int_value;
 				break;
 			case 40:
 				word_bit = MODAL_GROUP_G7;
 				// NOTE: Not required since cutter radius compensation is always disabled. Only here
 				// to support G40 commands that often appear in g-code program headers to setup defaults.
-				// gc_block.modal.cutter_comp = CUTTER_COMP_DISABLE; // G40
+				// block->modal.cutter_comp = CUTTER_COMP_DISABLE; // G40
 				break;
 			case 43:
 			case 49:
@@ -253,9 +268,9 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 				} // [Axis word/command conflict] }
 				axis_command = AXIS_COMMAND_TOOL_LENGTH_OFFSET;
 				if (int_value == 49) { // G49
-					gc_block.modal.tool_length = TOOL_LENGTH_OFFSET_CANCEL;
+					block->modal.tool_length = TOOL_LENGTH_OFFSET_CANCEL;
 				} else if (mantissa == 10) { // G43.1
-					gc_block.modal.tool_length = TOOL_LENGTH_OFFSET_ENABLE_DYNAMIC;
+					block->modal.tool_length = TOOL_LENGTH_OFFSET_ENABLE_DYNAMIC;
 				} else {
 					FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND);    // [Unsupported G43.x command]
 				}
@@ -269,14 +284,14 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 			case 59:
 				// NOTE: G59.x are not supported. (But their int_values would be 60, 61, and 62.)
 				word_bit = MODAL_GROUP_G12;
-				gc_block.modal.coord_select = int_value - 54; // Shift to array indexing.
+				block->modal.coord_select = int_value - 54; // Shift to array indexing.
 				break;
 			case 61:
 				word_bit = MODAL_GROUP_G13;
 				if (mantissa != 0) {
 					FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND);    // [G61.1 not supported]
 				}
-				// gc_block.modal.control = CONTROL_MODE_EXACT_PATH; // G61
+				// block->modal.control = CONTROL_MODE_EXACT_PATH; // G61
 				break;
 			default:
 				FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND); // [Unsupported G command]
@@ -306,25 +321,22 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 				word_bit = MODAL_GROUP_M4;
 				switch(int_value) {
 				case 0:
-					gc_block.modal.program_flow = PROGRAM_FLOW_PAUSED;
+					block->modal.program_flow = PROGRAM_FLOW_PAUSED;
 					break; // Program pause
 				case 1:
 					break; // Optional stop not supported. Ignore.
 				default:
-					gc_block.modal.program_flow = int_value; // Program end and reset
+					block->modal.program_flow = int_value; // Program end and reset
 				}
 				break;
 
 			case 3:
 			case 4:
-			case 5:
-				#ifndef SPINDLE_PWM_PIN
-					grbl_send(CLIENT_SERIAL, "[MSG:No spindle pin defined]\r\n");
-				#endif
+			case 5: // Reported by gc_execute_block() without a spindle pin.
 				word_bit = MODAL_GROUP_M7;
 				switch(int_value) {
 				case 3:
-					gc_block.modal.spindle = SPINDLE_ENABLE_CW;
+					block->modal.spindle = SPINDLE_ENABLE_CW;
 					break;
 				case 4: // Supported if SPINDLE_DIR_PIN is defined or laser mode is on.
 #ifndef SPINDLE_DIR_PIN
@@ -334,16 +346,16 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 						break;
 					}
 #endif
-					gc_block.modal.spindle = SPINDLE_ENABLE_CCW;
+					block->modal.spindle = SPINDLE_ENABLE_CCW;
 					break;
 				case 5:
-					gc_block.modal.spindle = SPINDLE_DISABLE;
+					block->modal.spindle = SPINDLE_DISABLE;
 					break;
 				}
 				break;
 			case 6: // too change
 				word_bit = MODAL_GROUP_M6;
-				gc_block.modal.tool_change = TOOL_CHANGE;
+				block->modal.tool_change = TOOL_CHANGE;
 				#ifdef USE_TOOL_CHANGE
 					//tool_change(gc_state.tool);
 				#endif
@@ -355,16 +367,16 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 				switch(int_value) {
 #ifdef COOLANT_MIST_PIN
 				case 7:
-					gc_block.modal.coolant = COOLANT_MIST_ENABLE;
+					block->modal.coolant = COOLANT_MIST_ENABLE;
 					break;
 #endif
 #ifdef COOLANT_FLOOD_PIN
 				case 8:
-					gc_block.modal.coolant = COOLANT_FLOOD_ENABLE;
+					block->modal.coolant = COOLANT_FLOOD_ENABLE;
 					break;
 #endif
 				case 9:
-					gc_block.modal.coolant = COOLANT_DISABLE;
+					block->modal.coolant = COOLANT_DISABLE;
 					break;
 				default:
 					FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND); // [Unsupported M command]
@@ -376,10 +388,10 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 				word_bit = MODAL_GROUP_M10;				
 				switch (int_value) {
 					case 62:
-						gc_block.modal.io_control = NON_MODAL_IO_ENABLE;
+						block->modal.io_control = NON_MODAL_IO_ENABLE;
 					break;
 					case 63:
-						gc_block.modal.io_control = NON_MODAL_IO_DISABLE;
+						block->modal.io_control = NON_MODAL_IO_DISABLE;
 					break;
 					default:
 					break;
@@ -408,89 +420,79 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 #if (N_AXIS > A_AXIS)
 			case 'A':
 				word_bit = WORD_A;
-				gc_block.values.xyz[A_AXIS] = value;
-				axis_words |= (1<<A_AXIS);
+				block->values.xyz[A_AXIS] = value;
 				break;
 #endif
 #if (N_AXIS > B_AXIS)
 			case 'B':
 				word_bit = WORD_B;
-				gc_block.values.xyz[B_AXIS] = value;
-				axis_words |= (1<<B_AXIS);
+				block->values.xyz[B_AXIS] = value;
 				break;
 #endif
 #if (N_AXIS > C_AXIS)
 			case 'C':
 				word_bit = WORD_C;
-				gc_block.values.xyz[C_AXIS] = value;
-				axis_words |= (1<<C_AXIS);
+				block->values.xyz[C_AXIS] = value;
 				break;
 #endif
-			// case 'D': // Not supported
+			// case 'D': // Raster pixels with LASER_RASTER, imported above
 			case 'F':
 				word_bit = WORD_F;
-				gc_block.values.f = value;
+				block->values.f = value;
 				break;
 			// case 'H': // Not supported
 			case 'I':
 				word_bit = WORD_I;
-				gc_block.values.ijk[X_AXIS] = value;
-				ijk_words |= (1<<X_AXIS);
+				block->values.ijk[X_AXIS] = value;
 				break;
 			case 'J':
 				word_bit = WORD_J;
-				gc_block.values.ijk[Y_AXIS] = value;
-				ijk_words |= (1<<Y_AXIS);
+				block->values.ijk[Y_AXIS] = value;
 				break;
 			case 'K':
 				word_bit = WORD_K;
-				gc_block.values.ijk[Z_AXIS] = value;
-				ijk_words |= (1<<Z_AXIS);
+				block->values.ijk[Z_AXIS] = value;
 				break;
 			case 'L':
 				word_bit = WORD_L;
-				gc_block.values.l = int_value;
+				block->values.l = int_value;
 				break;
 			case 'N':
 				word_bit = WORD_N;
-				gc_block.values.n = trunc(value);
+				block->values.n = trunc(value);
 				break;
 			case 'P':
 				word_bit = WORD_P;
-				gc_block.values.p = value;
+				block->values.p = value;
 				break;
 			// NOTE: For certain commands, P value must be an integer, but none of these commands are supported.
 			// case 'Q': // Not supported
 			case 'R':
 				word_bit = WORD_R;
-				gc_block.values.r = value;
+				block->values.r = value;
 				break;
 			case 'S':
 				word_bit = WORD_S;
-				gc_block.values.s = value;
+				block->values.s = value;
 				break;
 			case 'T':
 				word_bit = WORD_T;
 				if(value > MAX_TOOL_NUMBER)  {
 					FAIL(STATUS_GCODE_MAX_VALUE_EXCEEDED);
 				}
-				grbl_sendf(CLIENT_ALL, "[MSG:Tool No: %d]\r\n", int_value);
-				gc_state.tool = int_value;
+				block->values.t = int_value;
 				break;
 			case 'X':
 				word_bit = WORD_X;
-				gc_block.values.xyz[X_AXIS] = value;
-				axis_words |= (1<<X_AXIS);
+				block->values.xyz[X_AXIS] = value;
 				break;
 			case 'Y':
 				word_bit = WORD_Y;
-				gc_block.values.xyz[Y_AXIS] = value;
-				axis_words |= (1<<Y_AXIS);
+				block->values.xyz[Y_AXIS] = value;
 				break;
 			case 'Z':
 				word_bit = WORD_Z;
-				gc_block.values.xyz[Z_AXIS] = value;
-				axis_words |= (1<<Z_AXIS);
+				block->values.xyz[Z_AXIS] = value;
 				break;
 			default:
 				FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND);				
@@ -512,6 +514,89 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 		}
 	}
 	// Parsing complete!
+	parsed->command_words = command_words;
+	parsed->value_words = value_words;
+	parsed->axis_command = axis_command;
+	parsed->parser_flags = gc_parser_flags;
+	return(STATUS_OK);
+}
+
+
+// Copies the modal groups commanded in a parsed block over the current modes.
+static void gc_apply_modal_words(gc_modal_t *modal, gc_modal_t *words, uint16_t command_words)
+{
+	if (bit_istrue(command_words,bit(MODAL_GROUP_G1))) { modal->motion = words->motion; }
+	if (bit_istrue(command_words,bit(MODAL_GROUP_G2))) { modal->plane_select = words->plane_select; }
+	if (bit_istrue(command_words,bit(MODAL_GROUP_G3))) { modal->distance = words->distance; }
+	if (bit_istrue(command_words,bit(MODAL_GROUP_G5))) { modal->feed_rate = words->feed_rate; }
+	if (bit_istrue(command_words,bit(MODAL_GROUP_G6))) { modal->units = words->units; }
+	if (bit_istrue(command_words,bit(MODAL_GROUP_G8))) { modal->tool_length = words->tool_length; }
+	if (bit_istrue(command_words,bit(MODAL_GROUP_G12))) { modal->coord_select = words->coord_select; }
+	// M1 is ignored and leaves the program flow as it was.
+	if (bit_istrue(command_words,bit(MODAL_GROUP_M4)) && words->program_flow) { modal->program_flow = words->program_flow; }
+	if (bit_istrue(command_words,bit(MODAL_GROUP_M7))) { modal->spindle = words->spindle; }
+	if (bit_istrue(command_words,bit(MODAL_GROUP_M8))) { modal->coolant = words->coolant; }
+	// M6 and M62/M63 share a group bit. Neither one is kept in the parser state, so both are copied.
+	if (bit_istrue(command_words,bit(MODAL_GROUP_M10))) {
+		modal->tool_change = words->tool_change;
+		modal->io_control = words->io_control;
+	}
+}
+
+
+// Executes one parsed block (STEPs 3 and 4). In this function, all units and positions are
+// converted and exported to grbl's internal functions in terms of (mm, mm/min) and absolute
+// machine coordinates, respectively.
+uint8_t gc_execute_block(gc_parsed_block_t *parsed, uint8_t client)
+{
+	uint16_t command_words = parsed->command_words;
+	uint16_t value_words = parsed->value_words;
+	uint8_t axis_command = parsed->axis_command;
+	uint8_t gc_parser_flags = parsed->parser_flags;
+	uint8_t axis_0, axis_1, axis_linear;
+	uint8_t coord_select = 0; // Tracks G10 P coordinate selection for execution
+	(void)client; // Only used for the missing pin messages, which most machines do not build
+
+	// Start from the current g-code state modes and apply the commands of the block.
+	gc_block.non_modal_command = parsed->block.non_modal_command;
+	memcpy(&gc_block.modal,&gc_state.modal,sizeof(gc_modal_t)); // Copy current modes
+	memcpy(&gc_block.values,&parsed->block.values,sizeof(gc_values_t));
+	if (gc_parser_flags & GC_PARSER_JOG_MOTION) {
+		// Set G1 and G94 enforced modes to ensure accurate error checks.
+		gc_block.modal.motion = MOTION_MODE_LINEAR;
+		gc_block.modal.feed_rate = FEED_RATE_MODE_UNITS_PER_MIN;
+	}
+	gc_apply_modal_words(&gc_block.modal, &parsed->block.modal, command_words);
+
+	// Initialize bitflag tracking variables for axis indices compatible operations.
+	uint8_t axis_words = 0; // XYZ tracking
+	uint8_t ijk_words = 0; // IJK tracking
+	for (uint8_t word = 0; word < N_AXIS; word++) {
+		if (bit_istrue(value_words,bit(WORD_X+word))) { axis_words |= bit(word); }
+	}
+	for (uint8_t word = 0; word < 3; word++) {
+		if (bit_istrue(value_words,bit(WORD_I+word))) { ijk_words |= bit(word); }
+	}
+
+	// [5. Select tool ]: NOT SUPPORTED. Only tracks the value, reported as soon as the block has it.
+	if (bit_istrue(value_words,bit(WORD_T))) {
+		grbl_sendf(CLIENT_ALL, "[MSG:Tool No: %d]\r\n", gc_block.values.t);
+		gc_state.tool = gc_block.values.t;
+	}
+
+	// Missing pins are reported here rather than while parsing, as the SD streamer parses the lines
+	// of a job ahead of running them.
+	#ifndef PROBE_PIN // Only allow G38 "Probe" commands if a probe pin is defined.
+		if (bit_istrue(command_words,bit(MODAL_GROUP_G1)) && (parsed->block.modal.motion >= MOTION_MODE_PROBE_TOWARD)) {
+			grbl_send(client, "[MSG:No probe pin defined!]\r\n");
+			FAIL(STATUS_GCODE_UNSUPPORTED_COMMAND); // [Unsupported G command]
+		}
+	#endif
+	#ifndef SPINDLE_PWM_PIN
+		if (bit_istrue(command_words,bit(MODAL_GROUP_M7))) {
+			grbl_send(client, "[MSG:No spindle pin defined]\r\n");
+		}
+	#endif
 
 
 	/* -------------------------------------------------------------------------------------
@@ -907,7 +992,8 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 				}
 				break;
 			case MOTION_MODE_CW_ARC:
-				gc_parser_flags |= GC_PARSER_ARC_IS_CLOCKWISE; // No break intentional.
+				gc_parser_flags |= GC_PARSER_ARC_IS_CLOCKWISE;
+				// Falls through - no break intentional.
 			case MOTION_MODE_CCW_ARC:
 				// [G2/3 Errors All-Modes]: Feed rate undefined.
 				// [G2/3 Radius-Mode Errors]: No axis words in selected plane. Target point is same as current.
@@ -1065,7 +1151,8 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 				break;
 			case MOTION_MODE_PROBE_TOWARD_NO_ERROR:
 			case MOTION_MODE_PROBE_AWAY_NO_ERROR:
-				gc_parser_flags |= GC_PARSER_PROBE_IS_NO_ERROR; // No break intentional.
+				gc_parser_flags |= GC_PARSER_PROBE_IS_NO_ERROR;
+				// Falls through - no break intentional.
 			case MOTION_MODE_PROBE_TOWARD:
 			case MOTION_MODE_PROBE_AWAY:
 				if ((gc_block.modal.motion == MOTION_MODE_PROBE_AWAY) ||
@@ -1104,6 +1191,19 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 	if (value_words) {
 		FAIL(STATUS_GCODE_UNUSED_WORDS);    // [Unused words]
 	}
+#ifdef LASER_RASTER
+	// Raster pixels only go with a G1 move with axis words in laser mode. A kinematics machine would
+	// split the move, so there they are not supported.
+	if (parsed->raster_count) {
+		#ifdef USE_KINEMATICS
+			FAIL(STATUS_RASTER_INVALID);
+		#endif
+		if ((gc_parser_flags & GC_PARSER_JOG_MOTION) || bit_isfalse(settings.flags,BITFLAG_LASER_MODE) ||
+		    (gc_block.modal.motion != MOTION_MODE_LINEAR) || (axis_command != AXIS_COMMAND_MOTION_MODE)) {
+			FAIL(STATUS_RASTER_INVALID);    // [Raster without a G1 move in laser mode]
+		}
+	}
+#endif
 
 	/* -------------------------------------------------------------------------------------
 	   STEP 4: EXECUTE!!
@@ -1226,7 +1326,7 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 	// [7. Spindle control ]:
 	if (gc_state.modal.spindle != gc_block.modal.spindle) {
 		// Update spindle control and apply spindle speed when enabling it in this block.
-		// NOTE: All spindle state changes are synced, even in laser mode. Also, pl_data,
+		// NOTE: All spindle state changes go through spindle_sync(), even in laser mode. Also, pl_data,
 		// rather than gc_state, is used to manage laser state for non-laser motions.
 		spindle_sync(gc_block.modal.spindle, pl_data->spindle_speed);
 		gc_state.modal.spindle = gc_block.modal.spindle;
@@ -1237,12 +1337,12 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 	if (gc_state.modal.coolant != gc_block.modal.coolant) {
 		// NOTE: Coolant M-codes are modal. Only one command per line is allowed. But, multiple states
 		// can exist at the same time, while coolant disable clears all states.
-		coolant_sync(gc_block.modal.coolant);
 		if (gc_block.modal.coolant == COOLANT_DISABLE) {
 			gc_state.modal.coolant = COOLANT_DISABLE;
 		} else {
 			gc_state.modal.coolant |= gc_block.modal.coolant;
 		}
+		coolant_sync(gc_state.modal.coolant); // Both states, as the pins are set on and off from it
 	}
 	pl_data->condition |= gc_state.modal.coolant; // Set condition flag for planner use.
 
@@ -1348,6 +1448,10 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 		if (axis_command == AXIS_COMMAND_MOTION_MODE) {
 			uint8_t gc_update_pos = GC_UPDATE_POS_TARGET;
 			if (gc_state.modal.motion == MOTION_MODE_LINEAR) {
+#ifdef LASER_RASTER
+				pl_data->raster = parsed->raster;
+				pl_data->raster_count = parsed->raster_count;
+#endif
 				//mc_line(gc_block.values.xyz, pl_data);
 				mc_line_kins(gc_block.values.xyz, pl_data, gc_state.position);
 			} else if (gc_state.modal.motion == MOTION_MODE_SEEK) {
@@ -1432,6 +1536,137 @@ uint8_t gc_execute_line(char *line, uint8_t client)
 }
 
 
+
+// Executes one line of 0-terminated G-Code.
+uint8_t gc_execute_line(char *line, uint8_t client)
+{
+	gc_parsed_block_t parsed;
+	uint8_t status_code = gc_parse_line(line, &parsed);
+	if (status_code != STATUS_OK) {
+		return(status_code);
+	}
+	return(gc_execute_block(&parsed, client));
+}
+
+// Status of a line that was cut off at LINE_BUFFER_SIZE. The line holds the part that fit.
+uint8_t gc_line_overflow_status(char *line)
+{
+#ifdef LASER_RASTER
+	if ((line[0] != '$') && strchr(line, 'D')) {
+		return(STATUS_RASTER_TOO_LONG); // A D word takes the rest of the line
+	}
+#else
+	(void)line;
+#endif
+	return(STATUS_OVERFLOW);
+}
+
+
+void gc_checkpoint_init(gc_checkpoint_t *checkpoint)
+{
+	memset(checkpoint, 0, sizeof(gc_checkpoint_t)); // Same modes as gc_init()
+}
+
+// Follows the steps of gc_execute_block() that leave state behind. A block that fails there
+// stops the job, so it never matters how it would have changed the checkpoint.
+void gc_checkpoint_update(gc_checkpoint_t *checkpoint, gc_parsed_block_t *parsed)
+{
+	if (parsed->parser_flags & GC_PARSER_JOG_MOTION) { return; } // Jogging leaves the modes alone.
+	uint16_t command_words = parsed->command_words;
+	uint16_t value_words = parsed->value_words;
+	gc_values_t *values = &parsed->block.values;
+	gc_modal_t *modal = &checkpoint->modal;
+	uint8_t last_feed_rate_mode = modal->feed_rate;
+	uint8_t last_coolant = modal->coolant;
+
+	gc_apply_modal_words(modal, &parsed->block.modal, command_words);
+
+	// [3. Set feed rate mode ]: Only G94 keeps the feed rate, and only after G94.
+	if (modal->feed_rate == FEED_RATE_MODE_INVERSE_TIME) {
+		checkpoint->feed_rate = bit_istrue(value_words,bit(WORD_F)) ? values->f : 0.0;
+	} else if (last_feed_rate_mode == FEED_RATE_MODE_UNITS_PER_MIN) {
+		if (bit_istrue(value_words,bit(WORD_F))) {
+			checkpoint->feed_rate = (modal->units == UNITS_MODE_INCHES) ? values->f*MM_PER_INCH : values->f;
+		}
+	} else {
+		checkpoint->feed_rate = bit_istrue(value_words,bit(WORD_F)) ? values->f : 0.0;
+	}
+	if (bit_istrue(value_words,bit(WORD_S))) { checkpoint->spindle_speed = values->s; }
+	if (bit_istrue(value_words,bit(WORD_T))) { checkpoint->tool = values->t; }
+
+	// [8. Coolant control ]: M7 and M8 add up, M9 clears both.
+	if (modal->coolant != COOLANT_DISABLE) { modal->coolant |= last_coolant; }
+
+	// [14. Cutter length compensation ]:
+	if (bit_istrue(command_words,bit(MODAL_GROUP_G8))) {
+		checkpoint->tool_length_offset = 0.0;
+		if (modal->tool_length == TOOL_LENGTH_OFFSET_ENABLE_DYNAMIC) {
+			checkpoint->tool_length_offset = values->xyz[TOOL_LENGTH_OFFSET_AXIS];
+			if (modal->units == UNITS_MODE_INCHES) { checkpoint->tool_length_offset *= MM_PER_INCH; }
+		}
+	}
+
+	// [19. Coordinate offsets ]: G92.1 clears the offset, M2 and M30 do not.
+	if (bit_istrue(command_words,bit(MODAL_GROUP_G0))) {
+		if (parsed->block.non_modal_command == NON_MODAL_SET_COORDINATE_OFFSET) {
+			checkpoint->flags |= GC_CHECKPOINT_OFFSET;
+		} else if (parsed->block.non_modal_command == NON_MODAL_RESET_COORDINATE_OFFSET) {
+			checkpoint->flags &= ~GC_CHECKPOINT_OFFSET;
+		}
+	}
+
+	// [21. Program flow ]:
+	if ((modal->program_flow == PROGRAM_FLOW_COMPLETED_M2) || (modal->program_flow == PROGRAM_FLOW_COMPLETED_M30)) {
+		modal->motion = MOTION_MODE_LINEAR;
+		modal->plane_select = PLANE_SELECT_XY;
+		modal->distance = DISTANCE_MODE_ABSOLUTE;
+		modal->feed_rate = FEED_RATE_MODE_UNITS_PER_MIN;
+		modal->coord_select = 0; // G54
+		modal->spindle = SPINDLE_DISABLE;
+		modal->coolant = COOLANT_DISABLE;
+	}
+	// Not kept in the parser state either.
+	modal->program_flow = PROGRAM_FLOW_RUNNING;
+	modal->tool_change = 0;
+	modal->io_control = 0;
+}
+
+// Runs the checkpoint as g-code, so the usual checks and the spindle and coolant sync apply.
+// The values go in a G21 block and the units follow in a second one, so nothing is converted
+// twice. G2, G3 and probing need axis words, so they are restored as G80 and the line resumed
+// at must name its motion mode.
+uint8_t gc_checkpoint_restore(gc_checkpoint_t *checkpoint, uint8_t client)
+{
+	char line[LINE_BUFFER_SIZE];
+	char feed[24] = "";
+	char tool_length[24] = "G49";
+	gc_modal_t *modal = &checkpoint->modal;
+
+	if ((modal->feed_rate == FEED_RATE_MODE_UNITS_PER_MIN) && (checkpoint->feed_rate > 0.0)) {
+		snprintf(feed, sizeof(feed), "F%.3f", checkpoint->feed_rate);
+	} // G93 blocks carry their own F.
+	if (modal->tool_length == TOOL_LENGTH_OFFSET_ENABLE_DYNAMIC) {
+		snprintf(tool_length, sizeof(tool_length), "G43.1%c%.5f", "XYZABC"[TOOL_LENGTH_OFFSET_AXIS], checkpoint->tool_length_offset);
+	}
+	snprintf(line, sizeof(line), "G21G%d%s%sS%.3fT%dM%dM%d", 94-modal->feed_rate, feed, tool_length,
+	         checkpoint->spindle_speed, checkpoint->tool,
+	         (modal->spindle == SPINDLE_ENABLE_CW) ? 3 : (modal->spindle == SPINDLE_ENABLE_CCW) ? 4 : 5,
+	         (modal->coolant & COOLANT_FLOOD_ENABLE) ? 8 : (modal->coolant & COOLANT_MIST_ENABLE) ? 7 : 9);
+	uint8_t status_code = gc_execute_line(line, client);
+	if (status_code != STATUS_OK) { return(status_code); }
+
+	// A G1 without a feed rate is an error, so it is restored as G80 as well. M7 and M8 share
+	// a modal group, so with both on the mist comes on here.
+	uint8_t motion = modal->motion;
+	if ((motion > MOTION_MODE_LINEAR) || ((motion == MOTION_MODE_LINEAR) && !feed[0])) {
+		motion = MOTION_MODE_NONE;
+	}
+	snprintf(line, sizeof(line), "G%dG%dG%dG%dG%d%s", motion,
+	         17+modal->plane_select, 90+modal->distance, 21-modal->units, 54+modal->coord_select,
+	         (modal->coolant == (COOLANT_FLOOD_ENABLE|COOLANT_MIST_ENABLE)) ? "M7" : "");
+	return(gc_execute_line(line, client));
+}
+
 /*
   Not supported:
 
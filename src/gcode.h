@@ -174,6 +174,12 @@
   #define GC_PROBE_CHECK_MODE   GC_UPDATE_POS_TARGET
 #endif
 
+// Define the axis command implied by a block. A block holds at most one.
+#define AXIS_COMMAND_NONE 0
+#define AXIS_COMMAND_NON_MODAL 1
+#define AXIS_COMMAND_MOTION_MODE 2
+#define AXIS_COMMAND_TOOL_LENGTH_OFFSET 3 // *Undefined but required
+
 // Define gcode parser flags for handling special cases.
 #define GC_PARSER_NONE                  0 // Must be zero.
 #define GC_PARSER_JOG_MOTION            bit(0)
@@ -244,6 +250,37 @@ typedef struct {
   gc_values_t values;
 } parser_block_t;
 
+// A block after its words were imported, before it is checked against the parser state. Only
+// the modal groups in command_words and the value words in value_words are set in block.
+#define GC_RASTER_MAX_PIXELS (LINE_BUFFER_SIZE/2) // Most pixels a D word of one line can hold
+
+typedef struct {
+  uint16_t command_words; // Bit per modal group, MODAL_GROUP_xx
+  uint16_t value_words;   // Bit per value word, WORD_xx
+  uint8_t axis_command;
+  uint8_t parser_flags;   // GC_PARSER_JOG_MOTION only
+  parser_block_t block;
+#ifdef LASER_RASTER
+  uint8_t raster_count;   // Pixels of the D word, 0 without one. See LASER_RASTER in config.h.
+  uint8_t raster[GC_RASTER_MAX_PIXELS];
+#endif
+} gc_parsed_block_t;
+
+// Parser state at the start of a line of a job, followed from the blocks before it alone, so
+// a job can resume at that line without running the ones before. Coordinate systems are in
+// the settings and stay as they are. A G92 offset depends on where the machine was when it
+// was set, so it is only flagged.
+#define GC_CHECKPOINT_OFFSET bit(0) // A G92 offset is active
+
+typedef struct {
+  gc_modal_t modal;
+  uint8_t tool;
+  uint8_t flags;
+  float feed_rate;          // mm/min in G94, 0 when none has been set
+  float spindle_speed;
+  float tool_length_offset; // mm
+} gc_checkpoint_t;
+
 
 // Initialize the parser
 void gc_init();
@@ -251,6 +288,19 @@ void gc_init();
 // Execute one block of rs275/ngc/g-code
 uint8_t gc_execute_line(char *line, uint8_t client);
 
+// The two halves of gc_execute_line(). A parsed block does not depend on the parser state.
+uint8_t gc_parse_line(char *line, gc_parsed_block_t *parsed);
+uint8_t gc_execute_block(gc_parsed_block_t *parsed, uint8_t client);
+
+// Error for a line too long for the line buffer, given the part of it that fit.
+uint8_t gc_line_overflow_status(char *line);
+
+// Checkpoints. update() applies a parsed block the way gc_execute_block() would, and
+// restore() sets the parser, spindle and coolant to the checkpoint.
+void gc_checkpoint_init(gc_checkpoint_t *checkpoint);
+void gc_checkpoint_update(gc_checkpoint_t *checkpoint, gc_parsed_block_t *parsed);
+uint8_t gc_checkpoint_restore(gc_checkpoint_t *checkpoint, uint8_t client);
+
 // Set g-code parser position. Input in steps.
 void gc_sync_position();
 
@@ -0,0 +1,254 @@
+/*
+  gcode_binary.cpp - precompiled g-code jobs
+  Part of Grbl_ESP32
+
+  A job is compiled by running every line through the word import half of the parser,
+  gc_parse_line(), and storing the result: the commanded modal groups, the value words as
+  floats, and the source line number for error reports. Running the job feeds these blocks
+  straight to gc_execute_block(), so the text tokenizer and read_float() are out of the
+  hot path. Everything that depends on the parser state is still checked when the block
+  executes. The M4 and probe pin checks in the word import use the configuration of the
+  machine doing the compiling, so a job is compiled for the machine that runs it.
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+// Returns the value word of a block as stored in a record.
+static float gc_binary_get_value(gc_values_t *values, uint8_t word)
+{
+	switch (word) {
+		case WORD_F: return(values->f);
+		case WORD_I: case WORD_J: case WORD_K: return(values->ijk[word-WORD_I]);
+		case WORD_L: return(values->l);
+		case WORD_N: return(values->n);
+		case WORD_P: return(values->p);
+		case WORD_R: return(values->r);
+		case WORD_S: return(values->s);
+		case WORD_T: return(values->t);
+		default: return(values->xyz[word-WORD_X]);
+	}
+}
+
+static void gc_binary_set_value(gc_values_t *values, uint8_t word, float value)
+{
+	switch (word) {
+		case WORD_F: values->f = value; break;
+		case WORD_I: case WORD_J: case WORD_K: values->ijk[word-WORD_I] = value; break;
+		case WORD_L: values->l = value; break;
+		case WORD_N: values->n = value; break; // Exact, line numbers are below 2^24.
+		case WORD_P: values->p = value; break;
+		case WORD_R: values->r = value; break;
+		case WORD_S: values->s = value; break;
+		case WORD_T: values->t = value; break;
+		default: values->xyz[word-WORD_X] = value;
+	}
+}
+
+// Returns the record byte of a commanded modal group. G91.1, G40 and G61 store nothing.
+static bool gc_binary_get_group(parser_block_t *block, uint8_t group, uint8_t *byte)
+{
+	gc_modal_t *modal = &block->modal;
+	switch (group) {
+		case MODAL_GROUP_G0: *byte = block->non_modal_command; return(true);
+		case MODAL_GROUP_G1: *byte = modal->motion; return(true);
+		case MODAL_GROUP_G2: *byte = modal->plane_select; return(true);
+		case MODAL_GROUP_G3: *byte = modal->distance; return(true);
+		case MODAL_GROUP_G5: *byte = modal->feed_rate; return(true);
+		case MODAL_GROUP_G6: *byte = modal->units; return(true);
+		case MODAL_GROUP_G8: *byte = modal->tool_length; return(true);
+		case MODAL_GROUP_G12: *byte = modal->coord_select; return(true);
+		case MODAL_GROUP_M4: *byte = modal->program_flow; return(true);
+		case MODAL_GROUP_M7: *byte = modal->spindle; return(true);
+		case MODAL_GROUP_M8: *byte = modal->coolant; return(true);
+		case MODAL_GROUP_M10: *byte = modal->tool_change | (modal->io_control << 1); return(true); // Shared with M6
+		default: return(false);
+	}
+}
+
+static bool gc_binary_set_group(parser_block_t *block, uint8_t group, uint8_t byte)
+{
+	gc_modal_t *modal = &block->modal;
+	switch (group) {
+		case MODAL_GROUP_G0: block->non_modal_command = byte; return(true);
+		case MODAL_GROUP_G1: modal->motion = byte; return(true);
+		case MODAL_GROUP_G2: modal->plane_select = byte; return(true);
+		case MODAL_GROUP_G3: modal->distance = byte; return(true);
+		case MODAL_GROUP_G5: modal->feed_rate = byte; return(true);
+		case MODAL_GROUP_G6: modal->units = byte; return(true);
+		case MODAL_GROUP_G8: modal->tool_length = byte; return(true);
+		case MODAL_GROUP_G12: modal->coord_select = byte; return(true);
+		case MODAL_GROUP_M4: modal->program_flow = byte; return(true);
+		case MODAL_GROUP_M7: modal->spindle = byte; return(true);
+		case MODAL_GROUP_M8: modal->coolant = byte; return(true);
+		case MODAL_GROUP_M10:
+			modal->tool_change = byte & 1;
+			modal->io_control = byte >> 1;
+			return(true);
+		default: return(false);
+	}
+}
+
+// The axis command follows from the commands, since a block with two of them is rejected.
+static uint8_t gc_binary_axis_command(gc_parsed_block_t *parsed)
+{
+	if (bit_istrue(parsed->command_words,bit(MODAL_GROUP_G0))) {
+		switch (parsed->block.non_modal_command) {
+			case NON_MODAL_SET_COORDINATE_DATA:
+			case NON_MODAL_GO_HOME_0:
+			case NON_MODAL_GO_HOME_1:
+			case NON_MODAL_SET_COORDINATE_OFFSET:
+				return(AXIS_COMMAND_NON_MODAL);
+		}
+	}
+	if (bit_istrue(parsed->command_words,bit(MODAL_GROUP_G1)) && (parsed->block.modal.motion != MOTION_MODE_NONE)) {
+		return(AXIS_COMMAND_MOTION_MODE);
+	}
+	if (bit_istrue(parsed->command_words,bit(MODAL_GROUP_G8))) {
+		return(AXIS_COMMAND_TOOL_LENGTH_OFFSET);
+	}
+	return(AXIS_COMMAND_NONE);
+}
+
+uint16_t gc_binary_compile_line(char *line, uint32_t line_number, uint32_t *last_line_number, uint8_t *record)
+{
+	uint8_t *p = record+2;
+	uint8_t flags;
+	if ((line_number-*last_line_number) < GC_RECORD_LINE_ABSOLUTE) {
+		flags = line_number-*last_line_number;
+	} else {
+		flags = GC_RECORD_LINE_ABSOLUTE;
+		memcpy(p, &line_number, 4);
+		p += 4;
+	}
+	*last_line_number = line_number;
+
+	gc_parsed_block_t parsed;
+	if ((line[0] == '$') || (gc_parse_line(line, &parsed) != STATUS_OK)) {
+		uint16_t len = strlen(line);
+		if (len > GC_RECORD_TEXT_MAX) { len = GC_RECORD_TEXT_MAX; } // Fails to parse either way.
+		memcpy(p, line, len);
+		p += len;
+		flags |= GC_RECORD_TEXT;
+	} else {
+		if (parsed.command_words) {
+			memcpy(p, &parsed.command_words, 2);
+			p += 2;
+		} else {
+			flags |= GC_RECORD_NO_COMMANDS;
+		}
+		memcpy(p, &parsed.value_words, 2);
+		p += 2;
+		for (uint8_t group = 0; group < 16; group++) {
+			if (bit_istrue(parsed.command_words,bit(group)) && gc_binary_get_group(&parsed.block, group, p)) {
+				p++;
+			}
+		}
+		for (uint8_t word = 0; word < 16; word++) {
+			if (bit_istrue(parsed.value_words,bit(word))) {
+				float value = gc_binary_get_value(&parsed.block.values, word);
+				memcpy(p, &value, 4);
+				p += 4;
+			}
+		}
+#ifdef LASER_RASTER
+		memcpy(p, parsed.raster, parsed.raster_count);
+		p += parsed.raster_count;
+#endif
+	}
+	record[0] = (p-record)-1;
+	record[1] = flags;
+	return(p-record);
+}
+
+uint32_t gc_binary_line_number(uint8_t *record, uint32_t last_line_number)
+{
+	if ((record[1] & GC_RECORD_LINE_MASK) == GC_RECORD_LINE_ABSOLUTE) {
+		uint32_t line_number;
+		memcpy(&line_number, record+2, 4);
+		return(line_number);
+	}
+	return(last_line_number + (record[1] & GC_RECORD_LINE_MASK));
+}
+
+// Returns where the record continues after its line number.
+static uint8_t *gc_binary_payload(uint8_t *record)
+{
+	if ((record[1] & GC_RECORD_LINE_MASK) == GC_RECORD_LINE_ABSOLUTE) {
+		return(record+6);
+	}
+	return(record+2);
+}
+
+bool gc_binary_decode(uint8_t *record, gc_parsed_block_t *parsed)
+{
+	uint8_t *end = record+1+record[0];
+	uint8_t flags = record[1];
+	uint8_t *p = gc_binary_payload(record);
+	if (flags & GC_RECORD_TEXT) {
+		return(false);
+	}
+
+	memset(parsed, 0, sizeof(gc_parsed_block_t));
+	if (!(flags & GC_RECORD_NO_COMMANDS)) {
+		memcpy(&parsed->command_words, p, 2);
+		p += 2;
+	}
+	memcpy(&parsed->value_words, p, 2);
+	p += 2;
+	for (uint8_t group = 0; group < 16; group++) {
+		if (bit_istrue(parsed->command_words,bit(group)) && gc_binary_set_group(&parsed->block, group, *p)) {
+			p++;
+		}
+	}
+	for (uint8_t word = 0; word < 16; word++) {
+		if (bit_istrue(parsed->value_words,bit(word))) {
+			float value;
+			memcpy(&value, p, 4);
+			p += 4;
+			gc_binary_set_value(&parsed->block.values, word, value);
+		}
+	}
+#ifdef LASER_RASTER
+	if ((p < end) && ((end-p) <= GC_RASTER_MAX_PIXELS)) {
+		parsed->raster_count = end-p;
+		memcpy(parsed->raster, p, parsed->raster_count);
+		p = end;
+	}
+#endif
+	if (p != end) {
+		return(false); // Not a record this version wrote.
+	}
+	parsed->axis_command = gc_binary_axis_command(parsed);
+	return(true);
+}
+
+uint8_t gc_binary_execute(uint8_t *record, uint8_t client)
+{
+	if (record[1] & GC_RECORD_TEXT) {
+		uint8_t *p = gc_binary_payload(record);
+		uint8_t *end = record+1+record[0];
+		char line[LINE_BUFFER_SIZE];
+		memcpy(line, p, end-p);
+		line[end-p] = 0;
+		return(gc_execute_line(line, client));
+	}
+
+	gc_parsed_block_t parsed;
+	if (!gc_binary_decode(record, &parsed)) {
+		return(STATUS_BAD_NUMBER_FORMAT);
+	}
+	return(gc_execute_block(&parsed, client));
+}
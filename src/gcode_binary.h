@@ -0,0 +1,59 @@
+/*
+  gcode_binary.h - precompiled g-code jobs
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef gcode_binary_h
+#define gcode_binary_h
+
+// A precompiled job starts with these bytes, followed by one record per source line that
+// has anything left after filtering.
+#define GC_BINARY_MAGIC "GCB1"
+#define GC_BINARY_MAGIC_SIZE 4
+#define GC_BINARY_EXTENSION ".gcb"
+
+// Record layout. All values are little endian.
+//   [size]   Number of bytes after this one. A whole record fits in LINE_BUFFER_SIZE.
+//   [flags]  GC_RECORD_xx bits and the number of source lines since the last record.
+//   [line]   Absolute source line number (4 bytes), only with GC_RECORD_LINE_ABSOLUTE.
+// A block record continues with:
+//   [command_words] (2 bytes, left out with GC_RECORD_NO_COMMANDS), [value_words] (2 bytes),
+//   one byte per commanded modal group and one float per value word, both in bit order,
+//   then the raster pixels of a D word, one byte each, up to the end of the record.
+// A text record continues with the filtered line, for '$' lines and lines the parser
+// rejects, so they run or fail exactly as they would from a text job.
+#define GC_RECORD_TEXT bit(7)
+#define GC_RECORD_NO_COMMANDS bit(6)
+#define GC_RECORD_LINE_MASK 0x3f
+#define GC_RECORD_LINE_ABSOLUTE 0x3f
+
+#define GC_RECORD_TEXT_MAX (LINE_BUFFER_SIZE-7) // Longest text a record holds
+
+// Compiles one filtered line. last_line_number holds the line of the previous record and is
+// updated. Returns the size of the record written to record, at most LINE_BUFFER_SIZE bytes.
+uint16_t gc_binary_compile_line(char *line, uint32_t line_number, uint32_t *last_line_number, uint8_t *record);
+
+// Returns the source line number of a record, given the one of the previous record.
+uint32_t gc_binary_line_number(uint8_t *record, uint32_t last_line_number);
+
+// Unpacks a block record into what gc_parse_line() made of its source line. Returns false
+// for text records and for records this version did not write.
+bool gc_binary_decode(uint8_t *record, gc_parsed_block_t *parsed);
+
+// Executes a record the way gc_execute_line() executes its source line.
+uint8_t gc_binary_execute(uint8_t *record, uint8_t client);
+
+#endif
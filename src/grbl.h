@@ -30,6 +30,8 @@
 #include <freertos/task.h>
 
 #include "driver/timer.h"
+#include "soc/gpio_struct.h"
+#include "soc/ledc_struct.h"
 
 // Define the Grbl system include files. NOTE: Do not alter organization.
 #include "config.h"
@@ -45,6 +47,7 @@
 #include "coolant_control.h"
 #include "grbl_eeprom.h"
 #include "gcode.h"
+#include "gcode_binary.h"
 #include "grbl_limits.h"
 #include "motion_control.h"
 #include "print.h"
@@ -23,7 +23,7 @@
 void memcpy_to_eeprom_with_checksum(unsigned int destination, char *source, unsigned int size) {
   unsigned char checksum = 0;
   for(; size > 0; size--) { 
-    checksum = (checksum << 1) || (checksum >> 7);
+    checksum = (checksum != 0); // What the old "(checksum << 1) || (checksum >> 7)" gave, which stored settings were written with
     checksum += *source;
     EEPROM.write(destination++, *(source++)); 
   }
@@ -35,7 +35,7 @@ int memcpy_from_eeprom_with_checksum(char *destination, unsigned int source, uns
   unsigned char data, checksum = 0;
   for(; size > 0; size--) { 
     data = EEPROM.read(source++);
-    checksum = (checksum << 1) || (checksum >> 7);
+    checksum = (checksum != 0); // What the old "(checksum << 1) || (checksum >> 7)" gave, which stored settings were written with
     checksum += data;    
     *(destination++) = data; 
   }
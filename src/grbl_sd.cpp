@@ -19,17 +19,96 @@
 */
 
 #include "grbl_sd.h"
+#include <freertos/ringbuf.h>
 
 // Define line flags. Includes comment type tracking and line overflow detection.
 #define LINE_FLAG_OVERFLOW bit(0)
 #define LINE_FLAG_COMMENT_PARENTHESES bit(1)
 #define LINE_FLAG_COMMENT_SEMICOLON bit(2)
 
-File myFile;
+#define LINE_FLAG_RECORD bit(3) // Ring item holds a precompiled job record
+#define LINE_FLAG_FAILED bit(4) // Ring item ends a job whose compressed data is corrupt
+
+// Header of each line in the ring. It is followed by the zero-terminated line and then by the
+// zero-terminated '()' comments found on that line, if any, or by a precompiled job record.
+typedef struct {
+  uint32_t line_number; // File line the text came from
+  uint32_t file_pos;    // File offset just past that line
+  uint8_t line_flags;   // Only LINE_FLAG_OVERFLOW, LINE_FLAG_RECORD and LINE_FLAG_FAILED are passed on
+} sd_line_header_t;
+
+// Line index file, see SD_INDEX_INTERVAL. The header is followed by the entries. Entry n is
+// for the first queued line at or after line n*SD_INDEX_INTERVAL+1, so the entry for a line is
+// found without searching.
+#define SD_INDEX_MAGIC "GIX1"
+
+typedef struct {
+  char magic[4];        // SD_INDEX_MAGIC once the index has been written to its end
+  uint32_t file_size;   // Size of the job file the index was built from
+  uint16_t interval;    // SD_INDEX_INTERVAL
+  uint16_t entry_size;  // sizeof(sd_index_entry_t), changes with the checkpoint
+  uint32_t entries;
+  uint32_t lines;       // Lines queued for the whole job, valid when complete
+  uint8_t complete;     // The streamer read to the end of the file
+} sd_index_header_t;
+
+typedef struct {
+  uint32_t line_number;
+  uint32_t file_pos;     // File offset of the start of that line
+  uint32_t lines_before; // Lines queued before it
+  gc_checkpoint_t checkpoint;
+} sd_index_entry_t;
+
+// Line splitting state. Lines are split one character at a time, across read block boundaries.
+typedef struct {
+  uint16_t index;                // Characters in the line
+  uint16_t comment_char_counter; // Characters in the comment buffer
+  uint8_t line_flags;
+} sd_line_filter_t;
+
+File myFile; // Owned by the streamer task while a job is running
 bool SD_ready_next = false; // Grbl has processed a line and is waiting for another
 uint8_t SD_client = CLIENT_SERIAL;
 uint32_t sd_current_line_number; // stores the most recent line number read from the SD
-static char comment[LINE_BUFFER_SIZE]; // Line to be executed. Zero-terminated.
+
+static TaskHandle_t sdStreamTaskHandle = 0;
+static RingbufHandle_t sd_lines = NULL;
+static volatile bool sd_stream_running = false; // The streamer has the file open
+static volatile bool sd_stream_stop = false;    // Set by closeFile() to end the job early
+static volatile bool sd_stream_eof = false;     // The last line of the file is in the ring
+static uint32_t sd_file_size;
+static uint32_t sd_file_pos; // File offset past the last line taken by the protocol loop
+static char sd_filename[LINE_BUFFER_SIZE];
+
+// What the streamer does with the file, set up by sd_start_job().
+static uint32_t sd_stream_start;      // File offset of the first line to read
+static uint32_t sd_stream_first_line; // Its line number, 0 when reading from the start
+static uint32_t sd_stream_skip_to;    // Lines before this one are followed but not queued
+static bool sd_stream_binary;         // The file is a precompiled job
+static gz_stream_t *sd_stream_gz;     // The file is gzip compressed
+static bool sd_stream_index_only;     // Only write the index
+static volatile bool sd_stream_skipped; // The streamer reached sd_stream_skip_to
+static uint32_t sd_stream_count;      // Lines queued, or skipped, since the start of the job
+static gc_checkpoint_t sd_checkpoint; // Parser state at the start of the line being split
+static gc_checkpoint_t sd_resume_checkpoint; // sd_checkpoint at sd_stream_skip_to
+static uint32_t sd_resume_count;
+static File sd_index;                 // Index being written by the streamer, if any
+static sd_index_header_t sd_index_header;
+
+// A compile the streamer runs instead of a job, set up by sd_compile_file().
+static bool sd_stream_compile;
+static File sd_compile_job;           // Precompiled job being written
+static fs::FS *sd_compile_fs;
+static char sd_compile_path[LINE_BUFFER_SIZE];
+static uint8_t sd_compile_client;     // Gets the result
+
+static uint32_t sd_job_lines;   // Lines in the job from its index, 0 when there is no complete one
+static uint32_t sd_lines_taken; // Lines taken by the protocol loop since the start of the job
+
+// Streamer task buffers. They are only touched by the streamer, so they stay off its stack.
+static uint8_t sd_block[SD_READ_BLOCK_SIZE];
+static char sd_item[sizeof(sd_line_header_t) + 2*LINE_BUFFER_SIZE];
+static char comment[LINE_BUFFER_SIZE]; // '()' comments of the line, each zero-terminated
 
 // attempt to mount the SD card
 /*bool sd_mount()
@@ -68,8 +147,384 @@ void listDir(fs::FS &fs, const char * dirname, uint8_t levels, uint8_t client)
   }
 }
 
-boolean openFile(fs::FS &fs, const char * path)
+// Waits until there is room in the ring for the item. Returns false if the job was stopped meanwhile.
+static bool sd_queue_item(size_t payload_size)
+{
+  size_t size = sizeof(sd_line_header_t) + payload_size;
+  while (xRingbufferSend(sd_lines, sd_item, size, pdMS_TO_TICKS(10)) != pdTRUE) {
+    if (sd_stream_stop) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/*
+ Adds one character of the file to the line:
+ strip whitespace
+ strip comments per http://linuxcnc.org/docs/ja/html/gcode/overview.html#gcode:comments
+ make uppercase
+ Returns true when c ends the line. The line is then zero-terminated, and its '()' comments are
+ in the comment buffer, each zero-terminated.
+*/
+static bool sd_filter_char(sd_line_filter_t *filter, char *line, char c)
+{
+  if (c == '\n') {
+    if (filter->line_flags & LINE_FLAG_COMMENT_PARENTHESES) {
+      comment[filter->comment_char_counter++] = '\0'; // '()' comment left open at the end of the line
+    }
+    line[filter->index] = '\0';
+    return true;
+  } else if (filter->line_flags & LINE_FLAG_COMMENT_SEMICOLON) {
+    // Discard everything up to the end of the line.
+  } else if (filter->line_flags & LINE_FLAG_COMMENT_PARENTHESES) {
+    // capture all characters into a comment buffer
+    if (c == ')') {
+      // End of '()' comment. Resume line allowed.
+      filter->line_flags &= ~(LINE_FLAG_COMMENT_PARENTHESES);
+      comment[filter->comment_char_counter++] = '\0';
+    } else if (filter->comment_char_counter < (LINE_BUFFER_SIZE-2)) {
+      comment[filter->comment_char_counter++] = c;
+    }
+  } else if (c == '\r' || c == ' ' || c == '%') {
+    // ignore these whitespace items and discard '%'
+  } else if (c == '(') {
+    filter->line_flags |= LINE_FLAG_COMMENT_PARENTHESES;
+  } else if (c == ';') {
+    // NOTE: ';' comment to EOL is a LinuxCNC definition. Not NIST.
+    filter->line_flags |= LINE_FLAG_COMMENT_SEMICOLON;
+  } else if (filter->index < (LINE_BUFFER_SIZE-1)) {
+    line[filter->index++] = toupper(c); // add characters to the line, upper case
+  } else {
+    filter->line_flags |= LINE_FLAG_OVERFLOW; // Rest of the line is dropped and the job stops on it.
+  }
+  return false;
+}
+
+// Index file of a job: the job path with SD_INDEX_EXTENSION added.
+static bool sd_index_path(const char *path, char *index_path)
+{
+  if ((strlen(path) + sizeof(SD_INDEX_EXTENSION)) > LINE_BUFFER_SIZE) {
+    return false;
+  }
+  strcpy(index_path, path);
+  strcat(index_path, SD_INDEX_EXTENSION);
+  return true;
+}
+
+// Opens the index of a job and reads its header. Returns a closed file if there is no index
+// built by this version from this file.
+static File sd_index_open(fs::FS &fs, const char *path, uint32_t file_size, sd_index_header_t *header)
+{
+  char index_path[LINE_BUFFER_SIZE];
+  if (!sd_index_path(path, index_path) || !fs.exists(index_path)) {
+    return File();
+  }
+  File index = fs.open(index_path);
+  if (index && (index.read((uint8_t *)header, sizeof(sd_index_header_t)) == sizeof(sd_index_header_t)) &&
+      (memcmp(header->magic, SD_INDEX_MAGIC, sizeof(header->magic)) == 0) && (header->file_size == file_size) &&
+      (header->interval == SD_INDEX_INTERVAL) && (header->entry_size == sizeof(sd_index_entry_t))) {
+    return index;
+  }
+  index.close();
+  return File();
+}
+
+void sd_remove_index(fs::FS &fs, const char *path)
+{
+  char index_path[LINE_BUFFER_SIZE];
+  if (sd_index_path(path, index_path) && fs.exists(index_path)) {
+    fs.remove(index_path);
+  }
+}
+
+// Creates the index for the streamer to fill. The header is written again at the end. Until
+// then it is all zeros, so an index cut short by a reset is never read.
+static void sd_index_begin(fs::FS &fs, const char *path)
+{
+  char index_path[LINE_BUFFER_SIZE];
+  memset(&sd_index_header, 0, sizeof(sd_index_header_t));
+  if (!sd_index_path(path, index_path)) {
+    return;
+  }
+  sd_index = fs.open(index_path, FILE_WRITE);
+  if (sd_index && (sd_index.write((uint8_t *)&sd_index_header, sizeof(sd_index_header_t)) != sizeof(sd_index_header_t))) {
+    sd_index.close();
+  }
+}
+
+// Adds the entries that a line starting at file_pos is the first one for.
+static void sd_index_add(uint32_t line_number, uint32_t file_pos)
+{
+  while (sd_index && ((sd_index_header.entries * SD_INDEX_INTERVAL) < line_number)) {
+    sd_index_entry_t entry;
+    entry.line_number = line_number;
+    entry.file_pos = file_pos;
+    entry.lines_before = sd_stream_count;
+    memcpy(&entry.checkpoint, &sd_checkpoint, sizeof(gc_checkpoint_t));
+    if (sd_index.write((uint8_t *)&entry, sizeof(sd_index_entry_t)) != sizeof(sd_index_entry_t)) {
+      sd_index.close(); // Card full. The header stays zero.
+      return;
+    }
+    sd_index_header.entries++;
+  }
+}
+
+// A job that was stopped leaves an incomplete index. It still resumes any line it has an entry for.
+static void sd_index_end(bool complete)
+{
+  if (!sd_index) {
+    return;
+  }
+  memcpy(sd_index_header.magic, SD_INDEX_MAGIC, sizeof(sd_index_header.magic));
+  sd_index_header.file_size = sd_file_size;
+  sd_index_header.interval = SD_INDEX_INTERVAL;
+  sd_index_header.entry_size = sizeof(sd_index_entry_t);
+  sd_index_header.lines = sd_stream_count;
+  sd_index_header.complete = complete;
+  sd_index.seek(0);
+  sd_index.write((uint8_t *)&sd_index_header, sizeof(sd_index_header_t));
+  sd_index.close();
+}
+
+/*
+ Handles a line the streamer split off, which starts at file_pos. The checkpoint follows it while
+ the index is written or the line comes before the one a job resumes at. Only lines from that
+ one on are queued.
+*/
+static void sd_stream_line(size_t payload_size, uint32_t file_pos)
+{
+  sd_line_header_t *header = (sd_line_header_t *)sd_item;
+  char *line = sd_item + sizeof(sd_line_header_t);
+  bool skip = (header->line_number < sd_stream_skip_to);
+
+  if (!skip && !sd_stream_skipped) {
+    memcpy(&sd_resume_checkpoint, &sd_checkpoint, sizeof(gc_checkpoint_t));
+    sd_resume_count = sd_stream_count;
+    sd_stream_skipped = true;
+  }
+  if (sd_index || skip) {
+    sd_index_add(header->line_number, file_pos);
+    gc_parsed_block_t parsed;
+    if (header->line_flags & LINE_FLAG_RECORD) {
+      if (gc_binary_decode((uint8_t *)line, &parsed)) {
+        gc_checkpoint_update(&sd_checkpoint, &parsed);
+      }
+    } else if (!(header->line_flags & LINE_FLAG_OVERFLOW) && (line[0] != '$') && (gc_parse_line(line, &parsed) == STATUS_OK)) {
+      gc_checkpoint_update(&sd_checkpoint, &parsed);
+    }
+  }
+  sd_stream_count++;
+  if (!skip && !sd_stream_index_only) {
+    sd_queue_item(payload_size);
+  }
+}
+
+/*
+ Compiles the file sd_compile_file() opened into sd_compile_job, on the streamer task. The lines
+ are split and filtered the way a job is streamed.
+*/
+static void sd_compile_run()
+{
+  char *line = sd_item;
+  uint8_t *record = (uint8_t *)sd_item + LINE_BUFFER_SIZE;
+  sd_line_filter_t filter;
+  memset(&filter, 0, sizeof(sd_line_filter_t));
+  uint32_t line_number = 0;
+  uint32_t last_line_number = 0;
+  uint32_t line_count = 0;
+  uint8_t status_code = STATUS_OK;
+  bool more = true;
+
+  if (sd_compile_job.write((const uint8_t *)GC_BINARY_MAGIC, GC_BINARY_MAGIC_SIZE) != GC_BINARY_MAGIC_SIZE) {
+    status_code = STATUS_SD_FAILED_WRITE;
+  }
+  while (more && (status_code == STATUS_OK) && !sd_stream_stop) {
+    uint8_t *data = sd_block;
+    int len = sd_stream_gz ? gz_read(sd_stream_gz, &data) : myFile.read(sd_block, SD_READ_BLOCK_SIZE);
+    if (len < 0) {
+      status_code = STATUS_SD_FAILED_READ;
+      break;
+    }
+    if (len == 0) {
+      data = sd_block;
+      sd_block[0] = '\n'; // Ends a last line without a newline
+      len = 1;
+      more = false;
+    }
+    for (int i = 0; (i < len) && (status_code == STATUS_OK); i++) {
+      if (!sd_filter_char(&filter, line, data[i])) {
+        continue;
+      }
+      line_number++;
+      if (filter.line_flags & LINE_FLAG_OVERFLOW) {
+        status_code = gc_line_overflow_status(line);
+      } else if (filter.index) {
+        uint16_t size = gc_binary_compile_line(line, line_number, &last_line_number, record);
+        if (sd_compile_job.write(record, size) != size) {
+          status_code = STATUS_SD_FAILED_WRITE;
+        }
+        line_count++;
+      }
+      memset(&filter, 0, sizeof(sd_line_filter_t));
+    }
+  }
+
+  if (sd_stream_gz) {
+    gz_end(sd_stream_gz);
+    sd_stream_gz = NULL;
+  }
+  myFile.close();
+  sd_compile_job.close();
+  if ((status_code != STATUS_OK) || more) {
+    sd_compile_fs->remove(sd_compile_path);
+  }
+  if (status_code != STATUS_OK) {
+    grbl_sendf(sd_compile_client, "error:%d in SD file at line %d\r\n", status_code, line_number);
+  } else if (!more) {
+    grbl_sendf(sd_compile_client, "[MSG:Compiled %d lines]\r\n", line_count);
+  }
+  set_sd_state(SDCARD_IDLE);
+}
+
+/*
+ Streams the open job file into the line ring.
+ The file is read SD_READ_BLOCK_SIZE bytes at a time. A text file is split into filtered lines.
+ Empty lines are not queued, but they still count in the line numbers. A precompiled job
+ (gcode_binary.h) is split into its records.
+*/
+static void sdStreamTask(void *pvParameters)
 {
+  sd_line_header_t *header = (sd_line_header_t *)sd_item;
+  char *line = sd_item + sizeof(sd_line_header_t);
+  sd_line_filter_t filter;
+
+  while (true) {
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // Started by sd_start_job() or sd_compile_file()
+    if (sd_stream_compile) {
+      sd_compile_run();
+      sd_stream_compile = false;
+      sd_stream_running = false;
+      continue;
+    }
+
+    // Reads stay sector aligned. The bytes before the first line are skipped. A compressed
+    // job is always read from its start, and is inflated into blocks of its own.
+    uint32_t pos = sd_stream_start;
+    uint32_t line_pos = pos;
+    int i = pos % 512;
+    if (!sd_stream_gz) {
+      myFile.seek(pos - i);
+    }
+    uint32_t first_line = sd_stream_first_line;
+    memset(&filter, 0, sizeof(sd_line_filter_t));
+    header->line_number = first_line ? first_line - 1 : 0;
+    bool failed = false;
+
+    while (!sd_stream_stop) {
+      uint8_t *data = sd_block;
+      int len;
+      if (sd_stream_gz) {
+        len = gz_read(sd_stream_gz, &data);
+        failed = (len < 0);
+        if ((pos == 0) && (len >= GC_BINARY_MAGIC_SIZE) && (memcmp(data, GC_BINARY_MAGIC, GC_BINARY_MAGIC_SIZE) == 0)) {
+          sd_stream_binary = true;
+          i = pos = line_pos = GC_BINARY_MAGIC_SIZE;
+        }
+      } else {
+        len = myFile.read(sd_block, SD_READ_BLOCK_SIZE);
+      }
+      if (len <= 0) {
+        break;
+      }
+      for (; (i < len) && !sd_stream_stop; i++) {
+        char c = data[i];
+        pos++;
+
+        if (sd_stream_binary) {
+          line[filter.index++] = c;
+          if (filter.index == (uint16_t)((uint8_t)line[0] + 1)) {
+            // The first record of a resumed job is the one its entry names.
+            header->line_number = first_line ? first_line : gc_binary_line_number((uint8_t *)line, header->line_number);
+            first_line = 0;
+            header->file_pos = pos;
+            header->line_flags = LINE_FLAG_RECORD;
+            sd_stream_line(filter.index, line_pos);
+            line_pos = pos;
+            filter.index = 0;
+          }
+        } else if (sd_filter_char(&filter, line, c)) {
+          header->line_number++;
+          if (filter.index || (filter.line_flags & LINE_FLAG_OVERFLOW)) {
+            header->file_pos = pos;
+            header->line_flags = filter.line_flags & LINE_FLAG_OVERFLOW;
+            memcpy(line + filter.index + 1, comment, filter.comment_char_counter);
+            sd_stream_line(filter.index + 1 + filter.comment_char_counter, line_pos);
+          }
+          line_pos = pos;
+          memset(&filter, 0, sizeof(sd_line_filter_t));
+        }
+      }
+      i = 0;
+    }
+    if (failed) {
+      // The protocol loop stops the job on this, where the good data ends.
+      header->line_number++;
+      header->file_pos = pos;
+      header->line_flags = LINE_FLAG_FAILED;
+      line[0] = '\0';
+      sd_queue_item(1);
+    // some files end without a newline
+    } else if (!sd_stream_stop && !sd_stream_binary && sd_filter_char(&filter, line, '\n') &&
+        (filter.index || (filter.line_flags & LINE_FLAG_OVERFLOW))) {
+      header->line_number++;
+      header->file_pos = pos;
+      header->line_flags = filter.line_flags & LINE_FLAG_OVERFLOW;
+      memcpy(line + filter.index + 1, comment, filter.comment_char_counter);
+      sd_stream_line(filter.index + 1 + filter.comment_char_counter, line_pos);
+    }
+
+    sd_index_end(!sd_stream_stop && !failed);
+    if (!sd_stream_skipped) { // Resumed past the last line
+      memcpy(&sd_resume_checkpoint, &sd_checkpoint, sizeof(gc_checkpoint_t));
+      sd_resume_count = sd_stream_count;
+      sd_stream_skipped = true;
+    }
+    sd_stream_eof = true;
+    if (sd_stream_gz) {
+      gz_end(sd_stream_gz);
+      sd_stream_gz = NULL;
+    }
+    myFile.close();
+    sd_stream_running = false;
+  }
+}
+
+void sd_init()
+{
+  sd_lines = xRingbufferCreate(SD_LINE_QUEUE_SIZE, RINGBUF_TYPE_NOSPLIT);
+  xTaskCreatePinnedToCore(	sdStreamTask,    // task
+													"sdStreamTask", // name for task
+													4096,   // size of task stack
+													NULL,   // parameters
+													1, // priority
+													&sdStreamTaskHandle,
+													0 // core
+													);
+}
+
+/*
+ Opens a job and starts the streamer on it, from the line of an index entry or, with entry NULL,
+ from the start. Lines before skip_to are not queued. A run from the start writes the index
+ when there is no complete one for the file.
+*/
+static bool sd_start_job(fs::FS &fs, const char *path, sd_index_entry_t *entry, uint32_t skip_to, bool index_only)
+{
+  // A job that was stopped is closed by the streamer. Let it finish with the file first.
+  while (sd_stream_running) {
+    vTaskDelay(1);
+  }
+
   myFile = fs.open(path);
 
   if(!myFile) {
@@ -77,105 +532,310 @@ boolean openFile(fs::FS &fs, const char * path)
     return false;
   }
 
+  // Drop whatever the last job left in the ring.
+  size_t size;
+  void *item;
+  while ((item = xRingbufferReceive(sd_lines, &size, 0)) != NULL) {
+    vRingbufferReturnItem(sd_lines, item);
+  }
+
+  strncpy(sd_filename, myFile.name(), LINE_BUFFER_SIZE-1);
+  sd_filename[LINE_BUFFER_SIZE-1] = '\0';
+  sd_file_size = myFile.size();
+  uint8_t magic[GC_BINARY_MAGIC_SIZE];
+  sd_stream_binary = false;
+  if (gz_is_compressed(myFile)) {
+    // Sizes and offsets are those of the inflated job. Its precompiled magic is found by the streamer.
+    sd_stream_gz = gz_begin(myFile, sd_block, SD_READ_BLOCK_SIZE);
+    if (!sd_stream_gz) {
+      myFile.close();
+      return false;
+    }
+    sd_file_size = gz_size(sd_stream_gz);
+  } else {
+    sd_stream_binary = (myFile.read(magic, GC_BINARY_MAGIC_SIZE) == GC_BINARY_MAGIC_SIZE) &&
+                       (memcmp(magic, GC_BINARY_MAGIC, GC_BINARY_MAGIC_SIZE) == 0);
+  }
+
+  sd_job_lines = 0;
+  sd_index_header_t header;
+  File index = sd_index_open(fs, path, sd_file_size, &header);
+  if (index) {
+    if (header.complete) {
+      sd_job_lines = header.lines;
+    }
+    index.close();
+  }
+  if (entry) {
+    sd_stream_start = entry->file_pos;
+    sd_stream_first_line = entry->line_number;
+    sd_stream_count = entry->lines_before;
+    memcpy(&sd_checkpoint, &entry->checkpoint, sizeof(gc_checkpoint_t));
+  } else {
+    sd_stream_start = sd_stream_binary ? GC_BINARY_MAGIC_SIZE : 0;
+    sd_stream_first_line = 0;
+    sd_stream_count = 0;
+    gc_checkpoint_init(&sd_checkpoint);
+    if (!sd_job_lines) {
+      sd_index_begin(fs, path);
+    }
+  }
+  sd_stream_skip_to = skip_to;
+  sd_stream_skipped = false;
+  sd_stream_index_only = index_only;
+
+  sd_file_pos = sd_stream_start;
+  sd_lines_taken = sd_stream_count;
+  sd_stream_stop = false;
+  sd_stream_eof = false;
+  sd_stream_running = true;
+  sd_current_line_number = 0;
+  xTaskNotifyGive(sdStreamTaskHandle);
+  return true;
+}
+
+boolean openFile(fs::FS &fs, const char * path)
+{
+  if (!sd_start_job(fs, path, NULL, 0, false)) {
+    return false;
+  }
   set_sd_state(SDCARD_BUSY_PRINTING);
   SD_ready_next = false; // this will get set to true when Grbl issues "ok" message
-  sd_current_line_number = 0;
   return true;
 }
 
+/*
+ Opens a job to run from line_number on, with the parser, spindle and coolant as the lines
+ before would have left them. The index entry for the line gives the file offset and the
+ checkpoint, and the streamer follows the fewer than SD_INDEX_INTERVAL lines from there to
+ line_number without queueing them. A file whose index does not reach that far is indexed
+ first, which reads it once. A compressed job cannot seek, so it is inflated from the start
+ instead. A G92 offset cannot be restored, so a job that has one active at line_number does
+ not resume.
+*/
+static uint8_t sd_resume_restore(uint8_t client);
+
+// Waits while the streamer reads ahead without queueing lines, to index a job or to reach the line
+// it resumes at, which can take the whole file. Realtime commands run meanwhile, so resets, status
+// queries and alarms are not held up. Returns false, with the job stopped, after a reset.
+static bool sd_resume_wait(bool for_index)
+{
+  while (for_index ? sd_stream_running : !sd_stream_skipped) {
+    protocol_execute_realtime();
+    if (sys.abort) {
+      break;
+    }
+    vTaskDelay(1);
+  }
+  protocol_execute_realtime(); // A reset that came as the streamer finished
+  if (sys.abort || (!for_index && (get_sd_state(false) != SDCARD_BUSY_PRINTING))) {
+    closeFile();
+    return false;
+  }
+  return true;
+}
+
+uint8_t sd_resume_file(fs::FS &fs, const char *path, uint32_t line_number, uint8_t client)
+{
+  if (line_number == 0) {
+    line_number = 1;
+  }
+  File job = fs.open(path);
+  if (!job) {
+    return STATUS_SD_FAILED_READ;
+  }
+  uint32_t file_size = job.size();
+  bool compressed = gz_is_compressed(job);
+  job.close();
+  if (compressed) {
+    // Inflating has to start at the beginning, so the streamer follows every line before.
+    if (!sd_start_job(fs, path, NULL, line_number, false)) {
+      return STATUS_SD_FAILED_READ;
+    }
+    return sd_resume_restore(client);
+  }
+
+  uint32_t entry_index = (line_number - 1) / SD_INDEX_INTERVAL;
+  sd_index_header_t header;
+  File index = sd_index_open(fs, path, file_size, &header);
+  if (!index || (!header.complete && (header.entries <= entry_index))) {
+    index.close();
+    set_sd_state(SDCARD_BUSY_PARSING);
+    bool started = sd_start_job(fs, path, NULL, 0, true);
+    if (started && !sd_resume_wait(true)) {
+      return STATUS_SD_FAILED_READ; // [Reset while indexing]
+    }
+    set_sd_state(SDCARD_IDLE);
+    if (!started) {
+      return STATUS_SD_FAILED_READ;
+    }
+    index = sd_index_open(fs, path, file_size, &header);
+    if (!index) {
+      return STATUS_SD_FAILED_WRITE;
+    }
+  }
+  sd_index_entry_t entry;
+  bool found = (entry_index < header.entries) &&
+               index.seek(sizeof(sd_index_header_t) + entry_index * sizeof(sd_index_entry_t)) &&
+               (index.read((uint8_t *)&entry, sizeof(sd_index_entry_t)) == sizeof(sd_index_entry_t));
+  index.close();
+  if (!found) {
+    return STATUS_SD_FAILED_READ; // Past the last line of the job
+  }
+
+  if (!sd_start_job(fs, path, &entry, line_number, false)) {
+    return STATUS_SD_FAILED_READ;
+  }
+  return sd_resume_restore(client);
+}
+
+// Waits for the streamer to reach the line a job resumes at and restores the checkpoint there.
+static uint8_t sd_resume_restore(uint8_t client)
+{
+  set_sd_state(SDCARD_BUSY_PRINTING);
+  SD_ready_next = false;
+  if (!sd_resume_wait(false)) {
+    return STATUS_SD_FAILED_READ; // [Reset while skipping to the line]
+  }
+  sd_lines_taken = sd_resume_count;
+
+  uint8_t status_code = STATUS_SD_RESUME_OFFSET;
+  if (!(sd_resume_checkpoint.flags & GC_CHECKPOINT_OFFSET)) {
+    status_code = gc_checkpoint_restore(&sd_resume_checkpoint, client);
+  }
+  if (status_code != STATUS_OK) {
+    closeFile();
+  }
+  return status_code;
+}
+
+// The streamer task closes the file once it sees the stop flag.
 boolean closeFile()
 {
-  if(!myFile) {
+  if (!sd_stream_running && (get_sd_state(false) != SDCARD_BUSY_PRINTING)) {
     return false;
   }
 
   set_sd_state(SDCARD_IDLE);
   SD_ready_next = false;
   sd_current_line_number = 0;
-  myFile.close();
+  sd_stream_stop = true;
   return true;
 }
 
 /*
- read a line from the SD card
- strip whitespace
- strip comments per http://linuxcnc.org/docs/ja/html/gcode/overview.html#gcode:comments
- make uppercase
- return true if a line is
+ Takes the next line of the job from the ring without waiting.
+ line must hold LINE_BUFFER_SIZE characters. '()' comments on the line are reported here.
+ Returns SD_LINE_OVERFLOW with the first LINE_BUFFER_SIZE-1 characters of a line that was too long,
+ and SD_LINE_RECORD with a precompiled job record for gc_binary_execute().
 */
-boolean readFileLine(char *line)
+uint8_t sd_get_next_line(char *line)
 {
-  char c;
-  uint8_t index = 0;
-  uint8_t line_flags = 0;
-  uint8_t comment_char_counter = 0;
-
-  if (!myFile) {
-    report_status_message(STATUS_SD_FAILED_READ, SD_client);
-    return false;
+  size_t size;
+  sd_line_header_t *item = (sd_line_header_t *)xRingbufferReceive(sd_lines, &size, 0);
+  if (item == NULL) {
+    if (!sd_stream_eof) {
+      return SD_LINE_PENDING;
+    }
+    // The end flag is set after the last line was queued, so one more look settles it.
+    item = (sd_line_header_t *)xRingbufferReceive(sd_lines, &size, 0);
+    if (item == NULL) {
+      return SD_LINE_END;
+    }
   }
 
-  sd_current_line_number += 1;
-
-  while(myFile.available()) {
-    c = myFile.read();
-		
-	if (line_flags & LINE_FLAG_COMMENT_PARENTHESES) {  // capture all characters into a comment buffer
-		comment[comment_char_counter++] = c;
-	}
-	
-    if (c == '\r' || c == ' ' ) {
-      // ignore these whitespace items
-    } else if (c == '(') {
-      line_flags |= LINE_FLAG_COMMENT_PARENTHESES;
-    } else if (c == ')') {
-      // End of '()' comment. Resume line allowed.
-	  if (line_flags & LINE_FLAG_COMMENT_PARENTHESES) { 
-			line_flags &= ~(LINE_FLAG_COMMENT_PARENTHESES); 
-			comment[comment_char_counter] = 0; // null terminate								
-			report_gcode_comment(comment);								
-		}
-    } else if (c == ';') {
-      // NOTE: ';' comment to EOL is a LinuxCNC definition. Not NIST.
-      if (!(line_flags & LINE_FLAG_COMMENT_PARENTHESES)) { // semi colon inside parentheses do not mean anything
-        line_flags |= LINE_FLAG_COMMENT_SEMICOLON;
-      }
-    } else if (c == '%') {
-		// discard this character
-	} else if (c == '\n') { // found the newline, so mark the end and return true
-      line[index] = '\0';
-      return true;
-    } else { // add characters to the line
-      if (!line_flags) {
-        c = toupper(c); // make upper case
-        line[index] = c;
-        index++;
-      }
+  sd_current_line_number = item->line_number;
+  sd_file_pos = item->file_pos;
+  sd_lines_taken++;
+  char *text = (char *)(item + 1);
+  char *end = (char *)item + size;
+  uint8_t line_flags = item->line_flags;
+  if (line_flags & LINE_FLAG_RECORD) {
+    memcpy(line, text, end - text);
+  } else {
+    strcpy(line, text);
+    for (char *c = text + strlen(text) + 1; c < end; c += strlen(c) + 1) {
+      report_gcode_comment(c);
     }
+  }
+  vRingbufferReturnItem(sd_lines, item);
 
-    if (index == 255) { // name is too long so return false
-      line[index] = '\0';
-      report_status_message(STATUS_OVERFLOW, SD_client);
-      return false;
-    }
+  if (line_flags & LINE_FLAG_RECORD) {
+    return SD_LINE_RECORD;
   }
-  // some files end without a newline
-  if (index !=0) {
-    line[index] = '\0';
-    return true;
-  } else { // empty line after new line
-    return false;
+  if (line_flags & LINE_FLAG_FAILED) {
+    return SD_LINE_FAILED;
+  }
+  return (line_flags & LINE_FLAG_OVERFLOW) ? SD_LINE_OVERFLOW : SD_LINE_READY;
+}
+
+/*
+ Starts compiling a G-code file on the card, plain or gzip compressed, into a precompiled job next
+ to it, with the last extension replaced by GC_BINARY_EXTENSION. The streamer task compiles it
+ the way it streams a job, so realtime commands keep running, and reports the line count or the
+ error to client when it is done. Only starts while no job runs.
+*/
+uint8_t sd_compile_file(fs::FS &fs, const char *path, uint8_t client)
+{
+  // closeFile() only asks the streamer to stop. Let it finish with the buffers first.
+  while (sd_stream_running) {
+    vTaskDelay(1);
   }
+
+  strncpy(sd_compile_path, path, LINE_BUFFER_SIZE - sizeof(GC_BINARY_EXTENSION));
+  sd_compile_path[LINE_BUFFER_SIZE - sizeof(GC_BINARY_EXTENSION)] = '\0';
+  char *ext = strrchr(sd_compile_path, '.');
+  if ((ext == NULL) || (strchr(ext, '/') != NULL)) {
+    ext = sd_compile_path + strlen(sd_compile_path);
+  }
+  strcpy(ext, GC_BINARY_EXTENSION);
+  if (strcmp(sd_compile_path, path) == 0) {
+    return STATUS_SD_FAILED_READ; // Already compiled
+  }
+
+  myFile = fs.open(path);
+  if (!myFile) {
+    return STATUS_SD_FAILED_READ;
+  }
+  sd_stream_gz = NULL;
+  if (gz_is_compressed(myFile) && ((sd_stream_gz = gz_begin(myFile, sd_block, SD_READ_BLOCK_SIZE)) == NULL)) {
+    myFile.close();
+    return STATUS_SD_FAILED_READ;
+  }
+  sd_compile_job = fs.open(sd_compile_path, FILE_WRITE);
+  if (!sd_compile_job) {
+    if (sd_stream_gz) {
+      gz_end(sd_stream_gz);
+      sd_stream_gz = NULL;
+    }
+    myFile.close();
+    return STATUS_SD_FAILED_WRITE;
+  }
+  sd_remove_index(fs, sd_compile_path);
+  set_sd_state(SDCARD_BUSY_PARSING);
+
+  sd_compile_fs = &fs;
+  sd_compile_client = client;
+  sd_stream_compile = true;
+  sd_stream_stop = false;
+  sd_stream_running = true;
+  xTaskNotifyGive(sdStreamTaskHandle);
+  return STATUS_OK;
 }
 
 // return a percentage complete 50.5 = 50.5%
 float sd_report_perc_complete()
 {
-  if (!myFile) {
+  if ((get_sd_state(false) != SDCARD_BUSY_PRINTING) || (sd_file_size == 0)) {
     return 0.0;
   }
 
-  return  ((float)myFile.position() /  (float)myFile.size() * 100.0);
+  // Progress is where the protocol loop is, not how far the streamer has read ahead. With an
+  // index it counts lines, so long comments and headers do not skew it.
+  if (sd_job_lines) {
+    return ((float)sd_lines_taken / (float)sd_job_lines * 100.0);
+  }
+  return  ((float)sd_file_pos /  (float)sd_file_size * 100.0);
 }
 
 uint32_t sd_get_current_line_number()
@@ -220,11 +880,13 @@ uint8_t set_sd_state(uint8_t flag)
   return sd_state;
 }
 
-void sd_get_current_filename(char* name)
+// Copies the name of the file being run into size bytes, cut short if it does not fit.
+void sd_get_current_filename(char* name, size_t size)
 {
 
-  if (myFile) {
-    strcpy(name, myFile.name());
+  if (get_sd_state(false) == SDCARD_BUSY_PRINTING) {
+    strncpy(name, sd_filename, size-1);
+    name[size-1] = '\0';
   } else {
     name[0] = 0;
   }
@@ -21,6 +21,7 @@
  	#include "FS.h"
 	#include "SD.h"
 	#include "SPI.h"
+	#include "gzip_stream.h"
 
 #define FILE_TYPE_COUNT 5   // number of acceptable gcode file types in array
 
@@ -35,19 +36,50 @@
 
 
 
+// Job streaming. A task on core 0 reads the file in SD_READ_BLOCK_SIZE blocks, one block while the
+// protocol loop is parsing the lines from the last ones, and queues the filtered lines in a ring of
+// SD_LINE_QUEUE_SIZE bytes. The protocol loop only ever takes ready lines out of that ring.
+#ifndef SD_READ_BLOCK_SIZE
+  #define SD_READ_BLOCK_SIZE 8192 // 4-16KB. A multiple of the 512 byte sector, so reads stay aligned.
+#endif
+#ifndef SD_LINE_QUEUE_SIZE
+  #define SD_LINE_QUEUE_SIZE 4096
+#endif
+
+// Line index. The first run of a job from its start writes <file>.idx next to it: the file
+// offset and the parser checkpoint (gcode.h) of every SD_INDEX_INTERVAL-th line, and the
+// number of lines to run. A job resumes at any line from the entry before it, and progress
+// counts lines instead of bytes once a complete index exists.
+#ifndef SD_INDEX_INTERVAL
+  #define SD_INDEX_INTERVAL 64 // File lines per entry. At most this many lines are read to resume.
+#endif
+#define SD_INDEX_EXTENSION ".idx"
+
+// sd_get_next_line() results
+#define SD_LINE_READY 0
+#define SD_LINE_PENDING 1 // The streamer has not queued the next line yet
+#define SD_LINE_END 2     // All lines of the file have been taken
+#define SD_LINE_OVERFLOW 3 // The line was longer than LINE_BUFFER_SIZE-1 and has been cut
+#define SD_LINE_RECORD 4   // A record of a precompiled job, for gc_binary_execute()
+#define SD_LINE_FAILED 5   // The compressed data of the job is corrupt from here on
+
 extern bool SD_ready_next; // Grbl has processed a line and is waiting for another
 extern  uint8_t SD_client;
 
 //bool sd_mount();
+void sd_init();
 uint8_t get_sd_state(bool refresh);
 uint8_t set_sd_state(uint8_t flag);
 void listDir(fs::FS &fs, const char * dirname, uint8_t levels, uint8_t client);
 boolean openFile(fs::FS &fs, const char * path);
+uint8_t sd_resume_file(fs::FS &fs, const char *path, uint32_t line_number, uint8_t client);
 boolean closeFile();
-boolean readFileLine(char *line);
+void sd_remove_index(fs::FS &fs, const char *path);
+uint8_t sd_get_next_line(char *line);
+uint8_t sd_compile_file(fs::FS &fs, const char *path, uint8_t client);
 void readFile(fs::FS &fs, const char * path);
 float sd_report_perc_complete();
 uint32_t sd_get_current_line_number();
-void sd_get_current_filename(char* name);
+void sd_get_current_filename(char* name, size_t size);
 
 #endif
@@ -0,0 +1,167 @@
+/*
+  gzip_stream.cpp - reads gzip compressed job files as they stream
+  Part of Grbl_ESP32
+
+  The gzip header and trailer are read here (RFC 1952) and the deflate data between them is
+  inflated by tinfl. tinfl writes into a 32KB window that wraps around, and every block it
+  inflates is handed to the caller straight from that window, so nothing is copied.
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "gzip_stream.h"
+#include "rom/miniz.h"
+
+// gzip header flags
+#define GZ_FLAG_HCRC bit(1)
+#define GZ_FLAG_EXTRA bit(2)
+#define GZ_FLAG_NAME bit(3)
+#define GZ_FLAG_COMMENT bit(4)
+
+#define GZ_HEADER_SIZE 10
+#define GZ_TRAILER_SIZE 8 // CRC-32 and size. The CRC comes too late to stop a job, so it is not checked.
+
+struct gz_stream {
+  File *file;
+  tinfl_decompressor inflator;
+  uint8_t window[TINFL_LZ_DICT_SIZE];
+  uint8_t *input;
+  size_t input_size;
+  uint8_t *in_next;  // Compressed bytes read but not inflated yet
+  size_t in_avail;
+  bool more_input;   // The file has more to read
+  size_t out_pos;    // Where tinfl writes the window next
+  int status;        // Last tinfl status
+  uint32_t size;
+  uint8_t *chunk;    // Rest of the last block, for gz_getc()
+  int chunk_len;
+};
+
+bool gz_is_compressed(File &file)
+{
+  uint8_t magic[2];
+  bool compressed = (file.read(magic, 2) == 2) && (magic[0] == 0x1f) && (magic[1] == 0x8b);
+  file.seek(0);
+  return compressed;
+}
+
+// Skips a zero-terminated header field.
+static bool gz_skip_string(File &file)
+{
+  int c;
+  while ((c = file.read()) > 0) {}
+  return (c == 0);
+}
+
+gz_stream_t *gz_begin(File &file, uint8_t *input, size_t input_size)
+{
+  uint8_t header[GZ_HEADER_SIZE];
+  uint32_t file_size = file.size();
+  file.seek(0);
+  if ((file_size < (GZ_HEADER_SIZE + GZ_TRAILER_SIZE)) || (file.read(header, GZ_HEADER_SIZE) != GZ_HEADER_SIZE) ||
+      (header[0] != 0x1f) || (header[1] != 0x8b) || (header[2] != 8)) { // 8 is deflate, the only method there is
+    return NULL;
+  }
+  uint8_t flags = header[3];
+  if (flags & GZ_FLAG_EXTRA) {
+    uint8_t len[2];
+    if ((file.read(len, 2) != 2) || !file.seek(file.position() + len[0] + (len[1] << 8))) {
+      return NULL;
+    }
+  }
+  if (((flags & GZ_FLAG_NAME) && !gz_skip_string(file)) || ((flags & GZ_FLAG_COMMENT) && !gz_skip_string(file))) {
+    return NULL;
+  }
+  if (flags & GZ_FLAG_HCRC) {
+    file.seek(file.position() + 2);
+  }
+  uint32_t data_pos = file.position();
+
+  gz_stream_t *gz = (gz_stream_t *)malloc(sizeof(gz_stream_t) + (input ? 0 : GZ_INPUT_SIZE));
+  if (gz == NULL) {
+    file.seek(0);
+    return NULL;
+  }
+  uint8_t size[4];
+  file.seek(file_size - 4);
+  file.read(size, 4);
+  gz->size = size[0] | (size[1] << 8) | (size[2] << 16) | ((uint32_t)size[3] << 24);
+  file.seek(data_pos);
+
+  gz->file = &file;
+  tinfl_init(&gz->inflator);
+  gz->input = input ? input : (uint8_t *)(gz + 1);
+  gz->input_size = input ? input_size : GZ_INPUT_SIZE;
+  gz->in_next = gz->input;
+  gz->in_avail = 0;
+  gz->more_input = true;
+  gz->out_pos = 0;
+  gz->status = TINFL_STATUS_NEEDS_MORE_INPUT;
+  gz->chunk_len = 0;
+  return gz;
+}
+
+uint32_t gz_size(gz_stream_t *gz)
+{
+  return gz->size;
+}
+
+int gz_read(gz_stream_t *gz, uint8_t **data)
+{
+  while (gz->status != TINFL_STATUS_DONE) {
+    if ((gz->in_avail == 0) && gz->more_input) {
+      int len = gz->file->read(gz->input, gz->input_size);
+      gz->more_input = (len > 0);
+      gz->in_next = gz->input;
+      gz->in_avail = (len > 0) ? len : 0;
+    }
+    size_t in_size = gz->in_avail;
+    size_t out_size = TINFL_LZ_DICT_SIZE - gz->out_pos; // Up to the end of the window, it wraps after that.
+    gz->status = tinfl_decompress(&gz->inflator, gz->in_next, &in_size, gz->window, gz->window + gz->out_pos,
+                                  &out_size, gz->more_input ? TINFL_FLAG_HAS_MORE_INPUT : 0);
+    gz->in_next += in_size;
+    gz->in_avail -= in_size;
+    if (gz->status < TINFL_STATUS_DONE) {
+      return -1;
+    }
+    if (out_size) {
+      *data = gz->window + gz->out_pos;
+      gz->out_pos = (gz->out_pos + out_size) & (TINFL_LZ_DICT_SIZE - 1);
+      return out_size;
+    }
+    if ((gz->status == TINFL_STATUS_NEEDS_MORE_INPUT) && !gz->more_input) {
+      gz->status = TINFL_STATUS_FAILED;
+      return -1; // The file was cut short.
+    }
+  }
+  return 0;
+}
+
+int gz_getc(gz_stream_t *gz)
+{
+  if (gz->chunk_len == 0) {
+    gz->chunk_len = gz_read(gz, &gz->chunk);
+    if (gz->chunk_len <= 0) {
+      gz->chunk_len = 0;
+      return -1;
+    }
+  }
+  gz->chunk_len--;
+  return *gz->chunk++;
+}
+
+void gz_end(gz_stream_t *gz)
+{
+  free(gz);
+}
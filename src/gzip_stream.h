@@ -0,0 +1,54 @@
+/*
+  gzip_stream.h - reads gzip compressed job files as they stream
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef gzip_stream_h
+#define gzip_stream_h
+
+#include "FS.h"
+
+// A job file made with "gzip job.nc" is run as job.nc.gz. The file is inflated a block at a
+// time by the tinfl decompressor in the ESP32 ROM, which needs a 32KB window, so a stream
+// takes about 44KB of heap while it is open.
+#define GZ_EXTENSION ".gz"
+#ifndef GZ_INPUT_SIZE
+  #define GZ_INPUT_SIZE 1024 // Compressed bytes read at once, unless the caller lends a buffer
+#endif
+
+typedef struct gz_stream gz_stream_t;
+
+// Returns true if the file starts with the gzip magic. The file position is left at the start.
+bool gz_is_compressed(File &file);
+
+// Starts inflating a gzip file from its start. input is where compressed blocks are read to,
+// or NULL for a buffer of GZ_INPUT_SIZE bytes of the stream's own. Returns NULL if the file
+// is not gzip deflate data or the memory is not there.
+gz_stream_t *gz_begin(File &file, uint8_t *input, size_t input_size);
+
+// Size of the inflated file, from the gzip trailer. Files over 4GB are reported modulo 4GB.
+uint32_t gz_size(gz_stream_t *gz);
+
+// Inflates the next bytes and points data at them. Returns their count, 0 at the end of the
+// file and -1 if the data is corrupt. The bytes stay valid until the next call.
+int gz_read(gz_stream_t *gz, uint8_t **data);
+
+// Next inflated byte, or -1 at the end of the file or on corrupt data.
+int gz_getc(gz_stream_t *gz);
+
+void gz_end(gz_stream_t *gz);
+
+#endif
@@ -23,9 +23,14 @@
 
 #include "config.h"
 #include "inputbuffer.h"
+#include "serial.h"
 
 InputBuffer inputBuffer;
 
+// Lines are pushed from other tasks (the GUI, machine specific code) while the serial task
+// reads them, possibly on the other core, so the ring is only changed under this lock.
+static portMUX_TYPE input_buffer_mux = portMUX_INITIALIZER_UNLOCKED;
+
 
 InputBuffer::InputBuffer(){
     _RXbufferSize = 0;
@@ -69,12 +74,16 @@ size_t InputBuffer::write(const uint8_t *buffer, size_t size)
 }
 
 int InputBuffer::peek(void){
-    if (_RXbufferSize > 0)return _RXbuffer[_RXbufferpos];
-    else return -1;
+    int v = -1;
+    portENTER_CRITICAL(&input_buffer_mux);
+    if (_RXbufferSize > 0) v = _RXbuffer[_RXbufferpos];
+    portEXIT_CRITICAL(&input_buffer_mux);
+    return v;
 }
 
 bool InputBuffer::push (const char * data){
     int data_size = strlen(data);
+    portENTER_CRITICAL(&input_buffer_mux);
     if ((data_size + _RXbufferSize) <= RXBUFFERSIZE){
         int current = _RXbufferpos + _RXbufferSize;
         if (current > RXBUFFERSIZE) current = current - RXBUFFERSIZE;
@@ -83,20 +92,44 @@ bool InputBuffer::push (const char * data){
         _RXbuffer[current] = data[i];
         current ++;
         }
-        _RXbufferSize+=strlen(data);
+        _RXbufferSize+=data_size;
+        portEXIT_CRITICAL(&input_buffer_mux);
+        serial_wake();
         return true;
     }
+    portEXIT_CRITICAL(&input_buffer_mux);
     return false;
 }
 
 int InputBuffer::read(void){
+    int v = -1;
+    portENTER_CRITICAL(&input_buffer_mux);
     if (_RXbufferSize > 0) {
-        int v = _RXbuffer[_RXbufferpos];
+        v = _RXbuffer[_RXbufferpos];
         _RXbufferpos++;
         if (_RXbufferpos > (RXBUFFERSIZE-1))_RXbufferpos = 0;
         _RXbufferSize--;
-        return v;
-    } else return -1;
+    }
+    portEXIT_CRITICAL(&input_buffer_mux);
+    return v;
+}
+
+size_t InputBuffer::read(uint8_t *buffer, size_t size){
+    size_t count = 0;
+    portENTER_CRITICAL(&input_buffer_mux);
+    while ((count < size) && (_RXbufferSize > 0)) {
+        //copy up to the end of the ring, then wrap
+        size_t chunk = RXBUFFERSIZE - _RXbufferpos;
+        if (chunk > _RXbufferSize) chunk = _RXbufferSize;
+        if (chunk > (size - count)) chunk = size - count;
+        memcpy(&buffer[count], &_RXbuffer[_RXbufferpos], chunk);
+        _RXbufferpos += chunk;
+        if (_RXbufferpos > (RXBUFFERSIZE-1))_RXbufferpos = 0;
+        _RXbufferSize -= chunk;
+        count += chunk;
+    }
+    portEXIT_CRITICAL(&input_buffer_mux);
+    return count;
 }
 
 void InputBuffer::flush(void){
@@ -56,6 +56,7 @@ class InputBuffer: public Print{
     int available();
     int peek(void);
     int read(void);
+    size_t read(uint8_t *buffer, size_t size);
     bool push (const char * data);
     void flush(void);
     operator bool() const;
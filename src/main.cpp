@@ -27,6 +27,7 @@
 void setup(){
   setupGUI();
   setupGRBL();
+  startGUI();
 }
 
 void loop() {  
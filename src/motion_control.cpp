@@ -31,6 +31,7 @@ uint8_t ganged_mode = SQUARING_MODE_DUAL;
 void mc_line_kins(float *target, plan_line_data_t *pl_data, float *position)
 {		
 	#ifndef USE_KINEMATICS	
+		(void)position;
 		mc_line(target, pl_data);
 	#else // else use kinematics
 		inverse_kinematics(target, pl_data, position);
@@ -76,6 +77,9 @@ void mc_line(float *target, plan_line_data_t *pl_data)
     protocol_execute_realtime(); // Check for any run-time commands
     if (sys.abort) { return; } // Bail, if system abort.
     if ( plan_check_full_buffer() ) { protocol_auto_cycle_start(); } // Auto-cycle start when buffer is full.
+    #ifdef LASER_RASTER
+      else if ( plan_check_raster_full(pl_data->raster_count) ) { protocol_auto_cycle_start(); } // Same for its pixels.
+    #endif
     else { break; }
   } while (1);
 
@@ -404,6 +408,7 @@ uint8_t mc_probe_cycle(float *target, plan_line_data_t *pl_data, uint8_t parser_
 
 // Plans and executes the single special motion case for parking. Independent of main planner buffer.
 // NOTE: Uses the always free planner ring buffer head to store motion parameters for execution.
+#ifdef PARKING_ENABLE
 void mc_parking_motion(float *parking_target, plan_line_data_t *pl_data)
 {
   if (sys.abort) { return; } // Block during abort.
@@ -427,6 +432,7 @@ void mc_parking_motion(float *parking_target, plan_line_data_t *pl_data)
   }
 
 }
+#endif
 
 
 // Method to ready the system to reset by setting the realtime reset command and killing any
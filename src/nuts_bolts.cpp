@@ -133,10 +133,39 @@ void delay_sec(float seconds, uint8_t mode)
   }
 }
 
+// One store to the GPIO set or clear register, as the step pins are written. Unlike digitalWrite(),
+// this is in IRAM, so the stepper ISR can set spindle and coolant outputs with it.
+void IRAM_ATTR grbl_digitalWrite(uint8_t pin, uint8_t level)
+{
+  if (pin < 32) {
+    if (level) { GPIO.out_w1ts = (1UL << pin); } else { GPIO.out_w1tc = (1UL << pin); }
+  } else {
+    if (level) { GPIO.out1_w1ts.val = (1UL << (pin-32)); } else { GPIO.out1_w1tc.val = (1UL << (pin-32)); }
+  }
+}
+
 // Simple hypotenuse computation function.
 float hypot_f(float x, float y) { return(sqrt(x*x + y*y)); }
 
 
+// Bit-level first guess refined by Newton-Raphson. Three iterations bring the result within 2 ULP
+// of 1.0f/sqrtf(x), though not always bit for bit the same, using only single precision
+// multiplies the FPU does in one cycle each.
+float inv_sqrt_f(float x)
+{
+  uint32_t bits;
+  float y;
+  memcpy(&bits, &x, sizeof(float));
+  bits = 0x5f375a86 - (bits >> 1);
+  memcpy(&y, &bits, sizeof(float));
+  float half_x = 0.5f*x;
+  y *= 1.5f - half_x*y*y;
+  y *= 1.5f - half_x*y*y;
+  y *= 1.5f - half_x*y*y;
+  return(y);
+}
+
+
 float convert_delta_vector_to_unit_vector(float *vector)
 {
   uint8_t idx;
@@ -81,9 +81,15 @@ void delay_sec(float seconds, uint8_t mode);
 // Delays variable-defined milliseconds. Compiler compatibility fix for _delay_ms().
 void delay_ms(uint16_t ms);
 
+// Sets an output pin high or low. Safe to call from an ISR.
+void grbl_digitalWrite(uint8_t pin, uint8_t level);
+
 // Computes hypotenuse, avoiding avr-gcc's bloated version and the extra error checking.
 float hypot_f(float x, float y);
 
+// Returns 1/sqrt(x) for x > 0 without a divide or a library square root.
+float inv_sqrt_f(float x);
+
 float convert_delta_vector_to_unit_vector(float *vector);
 float limit_value_by_axis_maximum(float *max_value, float *unit_vec);
 
@@ -27,11 +27,18 @@
 #include <stdlib.h> // PSoc Required for labs
 
 
-static plan_block_t block_buffer[BLOCK_BUFFER_SIZE];  // A ring buffer for motion instructions
-static uint8_t block_buffer_tail;     // Index of the block to process now
-static uint8_t block_buffer_head;     // Index of the next block to be pushed
-static uint8_t next_buffer_head;      // Index of the next buffer head
-static uint8_t block_buffer_planned;  // Index of the optimally planned block
+static plan_block_t *block_buffer;    // A ring buffer for motion instructions. Allocated by plan_init().
+static uint16_t block_buffer_size;    // Number of blocks in the ring buffer ($37)
+static uint16_t block_buffer_tail;    // Index of the block to process now
+static uint16_t block_buffer_head;    // Index of the next block to be pushed
+static uint16_t next_buffer_head;     // Index of the next buffer head
+static uint16_t block_buffer_planned; // Index of the optimally planned block
+
+#ifdef LASER_RASTER
+static uint8_t raster_buffer[RASTER_BUFFER_SIZE]; // Pixels of the queued blocks
+static uint32_t raster_head;  // Ring position of the next pixel to be pushed
+static uint32_t raster_tail;  // Ring position of the first pixel of the block to process now
+#endif
 
 // Define planner variables
 typedef struct {
@@ -43,20 +50,67 @@ typedef struct {
 } planner_t;
 static planner_t pl;
 
+// Axis settings in the form plan_buffer_line() uses them, so the per-block kernel multiplies
+// instead of divides. Refreshed by plan_update_axis_limits() whenever the axis settings change.
+typedef struct {
+  float mm_per_step[N_AXIS];      // 1/$100-$102
+  float inv_max_rate[N_AXIS];     // 1/$110-$112 (min/mm)
+  float inv_acceleration[N_AXIS]; // 1/$120-$122 (min^2/mm)
+} planner_axis_limits_t;
+static planner_axis_limits_t pl_limits;
+
+
+// Allocates the block ring buffer with the number of blocks in setting $37. Internal RAM is tried
+// first, then PSRAM on boards that have it. If neither has room, the size is halved until it fits.
+void plan_init()
+{
+  uint16_t size = settings.planner_blocks;
+  if ((size < PLANNER_BLOCKS_MIN) || (size > PLANNER_BLOCKS_MAX)) { size = BLOCK_BUFFER_SIZE; }
+
+  if (block_buffer != NULL) { free(block_buffer); }
+  block_buffer = NULL;
+  while (block_buffer == NULL) {
+    block_buffer = (plan_block_t *)malloc(size*sizeof(plan_block_t));
+    #ifdef BOARD_HAS_PSRAM
+      if ((block_buffer == NULL) && psramFound()) {
+        block_buffer = (plan_block_t *)ps_malloc(size*sizeof(plan_block_t));
+      }
+    #endif
+    if ((block_buffer == NULL) && (size > PLANNER_BLOCKS_MIN)) { size /= 2; }
+    else { break; }
+  }
+  block_buffer_size = size;
+  if (block_buffer_size != settings.planner_blocks) {
+    grbl_sendf(CLIENT_SERIAL, "[MSG:Planner buffer %d blocks]\r\n", block_buffer_size);
+  }
+  plan_update_axis_limits();
+  plan_reset();
+}
+
+
+void plan_update_axis_limits()
+{
+  for (uint8_t idx=0; idx<N_AXIS; idx++) {
+    pl_limits.mm_per_step[idx] = 1.0f/settings.steps_per_mm[idx];
+    pl_limits.inv_max_rate[idx] = 1.0f/settings.max_rate[idx];
+    pl_limits.inv_acceleration[idx] = 1.0f/settings.acceleration[idx];
+  }
+}
+
 
 // Returns the index of the next block in the ring buffer. Also called by stepper segment buffer.
-uint8_t plan_next_block_index(uint8_t block_index)
+uint16_t plan_next_block_index(uint16_t block_index)
 {
   block_index++;
-  if (block_index == BLOCK_BUFFER_SIZE) { block_index = 0; }
+  if (block_index == block_buffer_size) { block_index = 0; }
   return(block_index);
 }
 
 
 // Returns the index of the previous block in the ring buffer
-static uint8_t plan_prev_block_index(uint8_t block_index)
+static uint16_t plan_prev_block_index(uint16_t block_index)
 {
-  if (block_index == 0) { block_index = BLOCK_BUFFER_SIZE; }
+  if (block_index == 0) { block_index = block_buffer_size; }
   block_index--;
   return(block_index);
 }
@@ -126,11 +180,18 @@ static uint8_t plan_prev_block_index(uint8_t block_index)
   to compute an optimal plan, so select carefully. The Arduino 328p memory is already maxed out, but future
   ARM versions should have enough memory and speed for look-ahead blocks numbering up to a hundred or more.
 
+  With a deep buffer ($37), a new block only raises the exit speed of the previously last block, so the
+  reverse pass can only raise entry speeds. As soon as it computes an entry speed that equals the one
+  already stored, every block before it is unchanged too, and both passes stop or start there. This keeps
+  the cost of adding a block proportional to the part of the plan it actually changes. A full pass is
+  still done when the plan is reinitialized (feed hold, overrides), because the maximum entry speeds may
+  have dropped.
+
 */
-static void planner_recalculate()
+static void planner_recalculate(bool incremental)
 {
   // Initialize block index to the last block in the planner buffer.
-  uint8_t block_index = plan_prev_block_index(block_buffer_head);
+  uint16_t block_index = plan_prev_block_index(block_buffer_head);
 
   // Bail. Can't do anything with one only one plan-able block.
   if (block_index == block_buffer_planned) { return; }
@@ -141,6 +202,7 @@ static void planner_recalculate()
   float entry_speed_sqr;
   plan_block_t *next;
   plan_block_t *current = &block_buffer[block_index];
+  uint16_t forward_index = block_buffer_planned; // Where the forward pass starts
 
   // Calculate maximum entry speed for last block in buffer, where the exit speed is always zero.
   current->entry_speed_sqr = MIN( current->max_entry_speed_sqr, 2*current->acceleration*current->millimeters);
@@ -161,19 +223,21 @@ static void planner_recalculate()
       // Compute maximum entry speed decelerating over the current block from its exit speed.
       if (current->entry_speed_sqr != current->max_entry_speed_sqr) {
         entry_speed_sqr = next->entry_speed_sqr + 2*current->acceleration*current->millimeters;
-        if (entry_speed_sqr < current->max_entry_speed_sqr) {
-          current->entry_speed_sqr = entry_speed_sqr;
-        } else {
-          current->entry_speed_sqr = current->max_entry_speed_sqr;
+        if (entry_speed_sqr > current->max_entry_speed_sqr) { entry_speed_sqr = current->max_entry_speed_sqr; }
+        if (incremental && (entry_speed_sqr == current->entry_speed_sqr)) {
+          // Unchanged, so are all blocks before it. Forward pass resumes from here.
+          forward_index = plan_next_block_index(block_index);
+          break;
         }
+        current->entry_speed_sqr = entry_speed_sqr;
       }
     }
   }
 
   // Forward Pass: Forward plan the acceleration curve from the planned pointer onward.
   // Also scans for optimal plan breakpoints and appropriately updates the planned pointer.
-  next = &block_buffer[block_buffer_planned]; // Begin at buffer planned pointer
-  block_index = plan_next_block_index(block_buffer_planned);
+  next = &block_buffer[forward_index]; // Begin at buffer planned pointer, or where the reverse pass stopped
+  block_index = plan_next_block_index(forward_index);
   while (block_index != block_buffer_head) {
     current = next;
     next = &block_buffer[block_index];
@@ -213,15 +277,23 @@ void plan_reset_buffer()
   block_buffer_head = 0; // Empty = tail
   next_buffer_head = 1; // plan_next_block_index(block_buffer_head)
   block_buffer_planned = 0; // = block_buffer_tail;
+  #ifdef LASER_RASTER
+    raster_head = raster_tail = 0;
+  #endif
 }
 
 
 void plan_discard_current_block()
 {
   if (block_buffer_head != block_buffer_tail) { // Discard non-empty buffer.
-    uint8_t block_index = plan_next_block_index( block_buffer_tail );
+    uint16_t block_index = plan_next_block_index( block_buffer_tail );
     // Push block_buffer_planned pointer, if encountered.
     if (block_buffer_tail == block_buffer_planned) { block_buffer_planned = block_index; }
+    #ifdef LASER_RASTER
+      // The segment generator has copied the pixels it needs by now.
+      plan_block_t *block = &block_buffer[block_buffer_tail];
+      if (block->raster_count) { raster_tail = block->raster_start + block->raster_count; }
+    #endif
     block_buffer_tail = block_index;
   }
 }
@@ -244,7 +316,7 @@ plan_block_t *plan_get_current_block()
 
 float plan_get_exec_block_exit_speed_sqr()
 {
-  uint8_t block_index = plan_next_block_index(block_buffer_tail);
+  uint16_t block_index = plan_next_block_index(block_buffer_tail);
   if (block_index == block_buffer_head) { return( 0.0 ); }
   return( block_buffer[block_index].entry_speed_sqr );
 }
@@ -258,6 +330,20 @@ uint8_t plan_check_full_buffer()
 }
 
 
+#ifdef LASER_RASTER
+uint8_t plan_check_raster_full(uint8_t count)
+{
+  return((raster_head - raster_tail + count) > RASTER_BUFFER_SIZE);
+}
+
+
+uint8_t plan_get_raster_pixel(plan_block_t *block, uint8_t idx)
+{
+  return(raster_buffer[(block->raster_start + idx) & (RASTER_BUFFER_SIZE-1)]);
+}
+#endif
+
+
 // Computes and returns block nominal speed based on running condition and override values.
 // NOTE: All system motion commands, such as homing/parking, are not subject to overrides.
 float plan_compute_profile_nominal_speed(plan_block_t *block)
@@ -287,7 +373,7 @@ static void plan_compute_profile_parameters(plan_block_t *block, float nominal_s
 // Re-calculates buffered motions profile parameters upon a motion-based override change.
 void plan_update_velocity_profile_parameters()
 {
-  uint8_t block_index = block_buffer_tail;
+  uint16_t block_index = block_buffer_tail;
   plan_block_t *block;
   float nominal_speed;
   float prev_nominal_speed = SOME_LARGE_VALUE; // Set high for first block nominal speed calculation.
@@ -332,51 +418,76 @@ uint8_t plan_buffer_line(float *target, plan_line_data_t *pl_data)
   } else { memcpy(position_steps, pl.position, sizeof(pl.position)); }
 
   #ifdef COREXY
-    target_steps[A_MOTOR] = lround(target[A_MOTOR]*settings.steps_per_mm[A_MOTOR]);
-    target_steps[B_MOTOR] = lround(target[B_MOTOR]*settings.steps_per_mm[B_MOTOR]);
+    target_steps[A_MOTOR] = lroundf(target[A_MOTOR]*settings.steps_per_mm[A_MOTOR]);
+    target_steps[B_MOTOR] = lroundf(target[B_MOTOR]*settings.steps_per_mm[B_MOTOR]);
     block->steps[A_MOTOR] = labs((target_steps[X_AXIS]-position_steps[X_AXIS]) + (target_steps[Y_AXIS]-position_steps[Y_AXIS]));
     block->steps[B_MOTOR] = labs((target_steps[X_AXIS]-position_steps[X_AXIS]) - (target_steps[Y_AXIS]-position_steps[Y_AXIS]));
   #endif
 
+  // The block length and both axis limited rates come out of this one pass. An axis limit
+  // max_value[idx]/|unit_vec[idx]| equals millimeters/(|delta_mm|/max_value[idx]), so only the
+  // largest |delta_mm|*(1/max_value[idx]) has to be tracked, and no per axis divide is needed.
+  float length_sqr = 0.0f;
+  float rate_scale = 0.0f;
+  float acceleration_scale = 0.0f;
   for (idx=0; idx<N_AXIS; idx++) {
     // Calculate target position in absolute steps, number of steps for each axis, and determine max step events.
     // Also, compute individual axes distance for move and prep unit vector calculations.
     // NOTE: Computes true distance from converted step values.
     #ifdef COREXY
       if ( !(idx == A_MOTOR) && !(idx == B_MOTOR) ) {
-        target_steps[idx] = lround(target[idx]*settings.steps_per_mm[idx]);
+        target_steps[idx] = lroundf(target[idx]*settings.steps_per_mm[idx]);
         block->steps[idx] = labs(target_steps[idx]-position_steps[idx]);
       }
       block->step_event_count = MAX(block->step_event_count, block->steps[idx]);
       if (idx == A_MOTOR) {
-        delta_mm = (target_steps[X_AXIS]-position_steps[X_AXIS] + target_steps[Y_AXIS]-position_steps[Y_AXIS])/settings.steps_per_mm[idx];
+        delta_mm = (target_steps[X_AXIS]-position_steps[X_AXIS] + target_steps[Y_AXIS]-position_steps[Y_AXIS])*pl_limits.mm_per_step[idx];
       } else if (idx == B_MOTOR) {
-        delta_mm = (target_steps[X_AXIS]-position_steps[X_AXIS] - target_steps[Y_AXIS]+position_steps[Y_AXIS])/settings.steps_per_mm[idx];
+        delta_mm = (target_steps[X_AXIS]-position_steps[X_AXIS] - target_steps[Y_AXIS]+position_steps[Y_AXIS])*pl_limits.mm_per_step[idx];
       } else {
-        delta_mm = (target_steps[idx] - position_steps[idx])/settings.steps_per_mm[idx];
+        delta_mm = (target_steps[idx] - position_steps[idx])*pl_limits.mm_per_step[idx];
       }
     #else
-      target_steps[idx] = lround(target[idx]*settings.steps_per_mm[idx]);
+      target_steps[idx] = lroundf(target[idx]*settings.steps_per_mm[idx]);
       block->steps[idx] = labs(target_steps[idx]-position_steps[idx]);
       block->step_event_count = MAX(block->step_event_count, block->steps[idx]);
-      delta_mm = (target_steps[idx] - position_steps[idx])/settings.steps_per_mm[idx];
+      delta_mm = (target_steps[idx] - position_steps[idx])*pl_limits.mm_per_step[idx];
 	  #endif
     unit_vec[idx] = delta_mm; // Store unit vector numerator
 
     // Set direction bits. Bit enabled always means direction is negative.
-    if (delta_mm < 0.0 ) { block->direction_bits |= get_direction_pin_mask(idx); }
+    if (delta_mm < 0.0f) {
+      block->direction_bits |= get_direction_pin_mask(idx);
+      delta_mm = -delta_mm;
+    }
+    length_sqr += delta_mm*delta_mm;
+    rate_scale = MAX(rate_scale, delta_mm*pl_limits.inv_max_rate[idx]);
+    acceleration_scale = MAX(acceleration_scale, delta_mm*pl_limits.inv_acceleration[idx]);
   }
 
   // Bail if this is a zero-length block. Highly unlikely to occur.
   if (block->step_event_count == 0) { return(PLAN_EMPTY_BLOCK); }
 
+  #ifdef LASER_RASTER
+    // mc_line() has waited for room in the ring.
+    if (pl_data->raster_count && !(block->condition & PL_COND_FLAG_SYSTEM_MOTION)) {
+      block->raster_start = raster_head;
+      block->raster_count = pl_data->raster_count;
+      for (uint8_t idx = 0; idx < pl_data->raster_count; idx++) {
+        raster_buffer[raster_head++ & (RASTER_BUFFER_SIZE-1)] = pl_data->raster[idx];
+      }
+    }
+  #endif
+
   // Calculate the unit vector of the line move and the block maximum feed rate and acceleration scaled
   // down such that no individual axes maximum values are exceeded with respect to the line direction.
   // NOTE: This calculation assumes all axes are orthogonal (Cartesian) and works with ABC-axes,
   // if they are also orthogonal/independent. Operates on the absolute value of the unit vector.
-  block->millimeters = convert_delta_vector_to_unit_vector(unit_vec);
-  block->acceleration = limit_value_by_axis_maximum(settings.acceleration, unit_vec);
-  block->rapid_rate = limit_value_by_axis_maximum(settings.max_rate, unit_vec);
+  float inv_millimeters = inv_sqrt_f(length_sqr);
+  for (idx=0; idx<N_AXIS; idx++) { unit_vec[idx] *= inv_millimeters; }
+  block->millimeters = length_sqr*inv_millimeters;
+  block->acceleration = block->millimeters/acceleration_scale;
+  block->rapid_rate = block->millimeters/rate_scale;
 
   // Store programmed rate.
   if (block->condition & PL_COND_FLAG_RAPID_MOTION) { block->programmed_rate = block->rapid_rate; }
@@ -416,27 +527,34 @@ uint8_t plan_buffer_line(float *target, plan_line_data_t *pl_data)
     // memory in the event of a feedrate override changing the nominal speeds of blocks, which can
     // change the overall maximum entry speed conditions of all blocks.
 
-    float junction_unit_vec[N_AXIS];
-    float junction_cos_theta = 0.0;
+    // The junction vector only matters through its axis limited acceleration, which is found the same
+    // way as for the block itself: its length over the largest |component|*(1/acceleration[idx]).
+    float junction_cos_theta = 0.0f;
+    float junction_length_sqr = 0.0f;
+    float junction_scale = 0.0f;
     for (idx=0; idx<N_AXIS; idx++) {
       junction_cos_theta -= pl.previous_unit_vec[idx]*unit_vec[idx];
-      junction_unit_vec[idx] = unit_vec[idx]-pl.previous_unit_vec[idx];
+      float junction_delta = fabsf(unit_vec[idx]-pl.previous_unit_vec[idx]);
+      junction_length_sqr += junction_delta*junction_delta;
+      junction_scale = MAX(junction_scale, junction_delta*pl_limits.inv_acceleration[idx]);
     }
 
     // NOTE: Computed without any expensive trig, sin() or acos(), by trig half angle identity of cos(theta).
-    if (junction_cos_theta > 0.999999) {
+    if (junction_cos_theta > 0.999999f) {
       //  For a 0 degree acute junction, just set minimum junction speed.
       block->max_junction_speed_sqr = MINIMUM_JUNCTION_SPEED*MINIMUM_JUNCTION_SPEED;
     } else {
-      if (junction_cos_theta < -0.999999) {
+      if (junction_cos_theta < -0.999999f) {
         // Junction is a straight line or 180 degrees. Junction speed is infinite.
         block->max_junction_speed_sqr = SOME_LARGE_VALUE;
       } else {
-        convert_delta_vector_to_unit_vector(junction_unit_vec);
-        float junction_acceleration = limit_value_by_axis_maximum(settings.acceleration, junction_unit_vec);
-        float sin_theta_d2 = sqrt(0.5*(1.0-junction_cos_theta)); // Trig half angle identity. Always positive.
+        float junction_acceleration = junction_length_sqr*inv_sqrt_f(junction_length_sqr)/junction_scale;
+        float sin_theta_d2 = sqrtf(0.5f*(1.0f-junction_cos_theta)); // Trig half angle identity. Always positive.
+        // 1-sin_theta_d2 cancels badly in single precision for shallow junctions. Since the junction
+        // vector length squared is 2*(1+cos_theta), it equals junction_length_sqr/(4*(1+sin_theta_d2)).
+        float one_minus_sin_theta_d2 = 0.25f*junction_length_sqr/(1.0f+sin_theta_d2);
         block->max_junction_speed_sqr = MAX( MINIMUM_JUNCTION_SPEED*MINIMUM_JUNCTION_SPEED,
-                       (junction_acceleration * settings.junction_deviation * sin_theta_d2)/(1.0-sin_theta_d2) );
+                       (junction_acceleration * settings.junction_deviation * sin_theta_d2)/one_minus_sin_theta_d2 );
       }
     }
   }
@@ -451,12 +569,16 @@ uint8_t plan_buffer_line(float *target, plan_line_data_t *pl_data)
     memcpy(pl.previous_unit_vec, unit_vec, sizeof(unit_vec)); // pl.previous_unit_vec[] = unit_vec[]
     memcpy(pl.position, target_steps, sizeof(target_steps)); // pl.position[] = target_steps[]
 
+    // The block carries the spindle and coolant state, so a change left to it is no longer pending.
+    spindle_sync_planned();
+    coolant_sync_planned();
+
     // New block is all set. Update buffer head and next buffer head indices.
     block_buffer_head = next_buffer_head;
     next_buffer_head = plan_next_block_index(block_buffer_head);
 
     // Finish up by recalculating the plan with the new block.
-    planner_recalculate();
+    planner_recalculate(true);
   }
   return(PLAN_OK);
 }
@@ -484,19 +606,19 @@ void plan_sync_position()
 
 
 // Returns the number of available blocks are in the planner buffer.
-uint8_t plan_get_block_buffer_available()
+uint16_t plan_get_block_buffer_available()
 {
-  if (block_buffer_head >= block_buffer_tail) { return((BLOCK_BUFFER_SIZE-1)-(block_buffer_head-block_buffer_tail)); }
+  if (block_buffer_head >= block_buffer_tail) { return((block_buffer_size-1)-(block_buffer_head-block_buffer_tail)); }
   return((block_buffer_tail-block_buffer_head-1));
 }
 
 
 // Returns the number of active blocks are in the planner buffer.
 // NOTE: Deprecated. Not used unless classic status reports are enabled in config.h
-uint8_t plan_get_block_buffer_count()
+uint16_t plan_get_block_buffer_count()
 {
   if (block_buffer_head >= block_buffer_tail) { return(block_buffer_head-block_buffer_tail); }
-  return(BLOCK_BUFFER_SIZE - (block_buffer_tail-block_buffer_head));
+  return(block_buffer_size - (block_buffer_tail-block_buffer_head));
 }
 
 
@@ -507,5 +629,5 @@ void plan_cycle_reinitialize()
   // Re-plan from a complete stop. Reset planner entry speeds and buffer planned pointer.
   st_update_plan_block_parameters();
   block_buffer_planned = block_buffer_tail;
-  planner_recalculate();
+  planner_recalculate(false);
 }
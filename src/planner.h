@@ -25,7 +25,8 @@
 #ifndef planner_h
 #define planner_h
   
-// The number of linear motions that can be in the plan at any give time
+// The default number of linear motions that can be in the plan at any give time. The actual size
+// is setting $37, allocated once at boot by plan_init().
 #ifndef BLOCK_BUFFER_SIZE
   #ifdef USE_LINE_NUMBERS
     #define BLOCK_BUFFER_SIZE 15
@@ -33,6 +34,13 @@
     #define BLOCK_BUFFER_SIZE 16
   #endif
 #endif
+#define PLANNER_BLOCKS_MIN 16
+#define PLANNER_BLOCKS_MAX 256
+
+// Raster pixels of the queued blocks, in the order of the blocks. Must be a power of 2.
+#ifndef RASTER_BUFFER_SIZE
+  #define RASTER_BUFFER_SIZE 4096
+#endif
  
 // Returned status message from planner.
 #define PLAN_OK true
@@ -85,6 +93,11 @@ typedef struct {
     // Stored spindle speed data used by spindle overrides and resuming methods.
     float spindle_speed;    // Block spindle speed. Copied from pl_line_data.
   //#endif
+
+  #ifdef LASER_RASTER
+    uint32_t raster_start;  // Raster ring position of the first pixel
+    uint8_t raster_count;   // Pixels spread evenly over the block, 0 for none
+  #endif
 } plan_block_t;
  
 // Planner data prototype. Must be used when passing new motions to the planner.
@@ -95,6 +108,10 @@ typedef struct {
   #ifdef USE_LINE_NUMBERS
     int32_t line_number;    // Desired line number to report when executing.
   #endif
+  #ifdef LASER_RASTER
+    uint8_t *raster;        // Pixels of the motion, copied into the raster ring.
+    uint8_t raster_count;
+  #endif
 } plan_line_data_t;
  
  
@@ -118,8 +135,14 @@ plan_block_t *plan_get_system_motion_block();
 // Gets the current block. Returns NULL if buffer empty
 plan_block_t *plan_get_current_block();
  
+// Allocates the block buffer. Called once at boot after the settings are loaded.
+void plan_init();
+
+// Recomputes the cached inverse axis limits. Called whenever the axis settings change.
+void plan_update_axis_limits();
+
 // Called periodically by step segment buffer. Mostly used internally by planner.
-uint8_t plan_next_block_index(uint8_t block_index);
+uint16_t plan_next_block_index(uint16_t block_index);
  
 // Called by step segment buffer when computing executing block velocity profile.
 float plan_get_exec_block_exit_speed_sqr();
@@ -137,14 +160,22 @@ void plan_sync_position();
 void plan_cycle_reinitialize();
  
 // Returns the number of available blocks are in the planner buffer.
-uint8_t plan_get_block_buffer_available();
+uint16_t plan_get_block_buffer_available();
  
 // Returns the number of active blocks are in the planner buffer.
 // NOTE: Deprecated. Not used unless classic status reports are enabled in config.h
-uint8_t plan_get_block_buffer_count();
+uint16_t plan_get_block_buffer_count();
  
 // Returns the status of the block ring buffer. True, if buffer is full.
 uint8_t plan_check_full_buffer();
+
+#ifdef LASER_RASTER
+  // True, if the raster ring has no room for count more pixels.
+  uint8_t plan_check_raster_full(uint8_t count);
+
+  // Pixel idx of a block. Called by the segment generator.
+  uint8_t plan_get_raster_pixel(plan_block_t *block, uint8_t idx);
+#endif
  
 void plan_get_planner_mpos(float *target);
  
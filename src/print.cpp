@@ -137,6 +137,69 @@ void printFloat_CoordValue(float n) {
   }
 }
 
+// Buffer formatting for reports that are built in one pass. Each function writes at dst, zero
+// terminates the output and returns a pointer to that zero, so the next field goes straight
+// after it.
+char *print_append_string(char *dst, const char *s)
+{
+  while (*s) { *dst++ = *s++; }
+  *dst = 0;
+  return(dst);
+}
+
+
+char *print_append_uint32(char *dst, uint32_t n)
+{
+  char buf[10];
+  uint8_t i = 0;
+  do {
+    buf[i++] = '0' + n % 10;
+    n /= 10;
+  } while (n > 0);
+  for (; i > 0; i--) { *dst++ = buf[i-1]; }
+  *dst = 0;
+  return(dst);
+}
+
+
+char *print_append_int32(char *dst, int32_t n)
+{
+  if (n < 0) {
+    *dst++ = '-';
+    return(print_append_uint32(dst, -(uint32_t)n));
+  }
+  return(print_append_uint32(dst, n));
+}
+
+
+// Fixed point float formatting. The value is scaled and rounded to an integer once, and the
+// decimal point is placed while the digits are written, so no float division or printf is used.
+// Good for magnitudes up to 2^31/10^decimal_places, which is far beyond any machine travel.
+char *print_append_float(char *dst, float n, uint8_t decimal_places)
+{
+  // The scaling is done in double. A float product can round up across the last reported digit.
+  static const double scale[] = { 1.0, 10.0, 100.0, 1000.0, 10000.0, 100000.0 };
+  if (decimal_places > 5) { decimal_places = 5; }
+
+  int32_t fixed = lrint(n*scale[decimal_places]); // Ties to even, like printf.
+  if (fixed < 0) {
+    *dst++ = '-';
+    fixed = -fixed;
+  }
+  char buf[16];
+  uint8_t i = 0;
+  uint8_t min_length = decimal_places ? decimal_places+2 : 1; // Always a digit before the point.
+  do {
+    buf[i++] = '0' + fixed % 10;
+    fixed /= 10;
+    if (i == decimal_places) { buf[i++] = '.'; }
+  } while ((fixed > 0) || (i < min_length));
+  for (; i > 0; i--) { *dst++ = buf[i-1]; }
+  *dst = 0;
+  return(dst);
+}
+
+
 // Debug tool to print free memory in bytes at the called point.
 // NOTE: Keep commented unless using. Part of this function always gets compiled in.
 // void printFreeMemory()
@@ -48,6 +48,12 @@ void printFloat(float n, uint8_t decimal_places);
 void printFloat_CoordValue(float n);
 void printFloat_RateValue(float n);
 
+// Append a value to a report buffer and return the new end. See print.cpp.
+char *print_append_string(char *dst, const char *s);
+char *print_append_uint32(char *dst, uint32_t n);
+char *print_append_int32(char *dst, int32_t n);
+char *print_append_float(char *dst, float n, uint8_t decimal_places);
+
 // Debug tool to print free memory in bytes at the called point. Not used otherwise.
 void printFreeMemory();
 
@@ -26,7 +26,6 @@
 #include "config.h"
 #include "commands.h"
 #include "espresponse.h"
-#include "lvgl.h"
 
 // Define line flags. Includes comment type tracking and line overflow detection.
 #define LINE_FLAG_OVERFLOW bit(0)
@@ -35,11 +34,224 @@
 #define LINE_FLAG_BRACKET bit(3) // square bracket for WebUI commands
 
 
-static char line[LINE_BUFFER_SIZE]; // Line to be executed. Zero-terminated.
-static char comment[LINE_BUFFER_SIZE]; // Line to be executed. Zero-terminated.
-
 static void protocol_exec_rt_suspend();
 
+// Size of the chunks the main loop takes from a client's receive ring at a time.
+#define PROTOCOL_RX_CHUNK 64
+
+// Line assembly state of a client. Characters are filtered into line[] until the end of line is
+// found. Every client has its own, so lines arriving from several clients at once never mix.
+typedef struct {
+  char line[LINE_BUFFER_SIZE]; // Line to be executed. Zero-terminated.
+  char comment[LINE_BUFFER_SIZE];
+  uint8_t line_flags;
+  uint8_t char_counter;
+  uint8_t comment_char_counter;
+  uint8_t rx_chunk[PROTOCOL_RX_CHUNK];
+  uint8_t rx_next; // Start of the part of rx_chunk that has not been filtered yet
+  uint8_t rx_len;
+} protocol_client_t;
+
+static protocol_client_t protocol_clients[CLIENT_COUNT]; // Index is client-1
+static uint8_t protocol_first_client = 0; // Client served first in the next pass, rotates
+
+#ifdef ENABLE_JOB_OWNERSHIP
+  static uint8_t job_owner = 0; // Client whose G-code is running, 0 for none
+  static uint32_t job_owner_time; // millis() at the owner's last G-code line
+#endif
+
+// Returns the first '\n' or '\r' in [data, end), or end if there is none. Aligned words are
+// tested four bytes at a time with the usual "has zero byte" bit trick on data^'\n' and data^'\r',
+// so the common case of a long run without a line end costs a few operations per word.
+static const uint8_t *protocol_find_eol(const uint8_t *data, const uint8_t *end)
+{
+  while ((data < end) && ((uintptr_t)data & 3)) {
+    if ((*data == '\n') || (*data == '\r')) { return(data); }
+    data++;
+  }
+  while (data+4 <= end) {
+    uint32_t word = *(const uint32_t *)data;
+    uint32_t lf = word ^ 0x0a0a0a0a;
+    uint32_t cr = word ^ 0x0d0d0d0d;
+    if (((lf-0x01010101) & ~lf & 0x80808080) | ((cr-0x01010101) & ~cr & 0x80808080)) { break; }
+    data += 4;
+  }
+  while ((data < end) && (*data != '\n') && (*data != '\r')) { data++; }
+  return(data);
+}
+
+// Filters a run of characters without line ends into line[]. Performs an initial filtering by
+// removing spaces and comments and capitalizing all letters.
+static void protocol_filter_chars(protocol_client_t *pc, const uint8_t *data, const uint8_t *end)
+{
+  char *line = pc->line;
+  for (; data < end; data++) {
+    uint8_t c = *data;
+    if (pc->line_flags) {
+      if (pc->line_flags & LINE_FLAG_BRACKET) {  // in bracket mode all characters are accepted
+        line[pc->char_counter++] = c;
+      }
+      // Throw away all (except EOL) comment characters and overflow characters.
+      if (c == ')') {
+        // End of '()' comment. Resume line allowed.
+        if (pc->line_flags & LINE_FLAG_COMMENT_PARENTHESES) { 
+          pc->line_flags &= ~(LINE_FLAG_COMMENT_PARENTHESES); 
+          pc->comment[pc->comment_char_counter] = 0; // null terminate								
+          report_gcode_comment(pc->comment);								
+        }
+      }
+      if (pc->line_flags & LINE_FLAG_COMMENT_PARENTHESES) {  // capture all characters into a comment buffer
+        pc->comment[pc->comment_char_counter++] = c;
+      }
+    } else {
+      if (c <= ' ') {
+        // Throw away whitepace and control characters
+      } 
+      /*
+      else if (c == '/') {
+        // Block delete NOT SUPPORTED. Ignore character.
+        // NOTE: If supported, would simply need to check the system if block delete is enabled.
+      } 
+      */
+      else if (c == '(') {
+        // Enable comments flag and ignore all characters until ')' or EOL.
+        // NOTE: This doesn't follow the NIST definition exactly, but is good enough for now.
+        // In the future, we could simply remove the items within the comments, but retain the
+        // comment control characters, so that the g-code parser can error-check it.
+        pc->line_flags |= LINE_FLAG_COMMENT_PARENTHESES;
+        pc->comment_char_counter = 0;
+      } else if (c == ';') {
+        // NOTE: ';' comment to EOL is a LinuxCNC definition. Not NIST.
+        pc->line_flags |= LINE_FLAG_COMMENT_SEMICOLON;
+      } else if (c == '[') {
+        // For ESP3D bracket commands like [ESP100]<SSID>pwd=<admin password>
+        // prevents spaces being striped and converting to uppercase
+        pc->line_flags |= LINE_FLAG_BRACKET;
+        line[pc->char_counter++] = c; // capture this character
+
+      // TODO: Install '%' feature
+      } else if (c == '%') {
+        // Program start-end percent sign NOT SUPPORTED.
+        // NOTE: This maybe installed to tell Grbl when a program is running vs manual input,
+        // where, during a program, the system auto-cycle start will continue to execute
+        // everything until the next '%' sign. This will help fix resuming issues with certain
+        // functions that empty the planner buffer to execute its task on-time.
+      } else if (pc->char_counter >= (LINE_BUFFER_SIZE-1)) {
+        // Detect line buffer overflow and set flag.
+        pc->line_flags |= LINE_FLAG_OVERFLOW;
+      } else if (c >= 'a' && c <= 'z') { // Upcase lowercase
+        line[pc->char_counter++] = c-'a'+'A';
+      } else {
+        line[pc->char_counter++] = c;
+      }
+    }
+  }
+}
+
+// Filters the client's input until a whole line is assembled in its line[]. Returns false when
+// the receive ring runs out first, and the line is continued on the next call.
+static bool protocol_read_line(protocol_client_t *pc, uint8_t client)
+{
+  for (;;) {
+    if (pc->rx_next == pc->rx_len) {
+      pc->rx_next = 0;
+      pc->rx_len = serial_read_bytes(client, pc->rx_chunk, PROTOCOL_RX_CHUNK);
+      if (pc->rx_len == 0) { return(false); }
+    }
+    const uint8_t *data = pc->rx_chunk+pc->rx_next;
+    const uint8_t *end = pc->rx_chunk+pc->rx_len;
+    const uint8_t *eol = protocol_find_eol(data, end);
+    protocol_filter_chars(pc, data, eol);
+    if (eol == end) { // Line continues in the next chunk.
+      pc->rx_next = pc->rx_len;
+    } else {
+      pc->rx_next = eol+1-pc->rx_chunk;
+      return(true);
+    }
+  }
+}
+
+static void protocol_reset_line(protocol_client_t *pc)
+{
+  pc->line_flags = 0;
+  pc->char_counter = 0;
+  pc->comment_char_counter = 0;
+}
+
+#ifdef ENABLE_JOB_OWNERSHIP
+// G-code, jogging and homing lines. Other '$' and '[ESP' commands are queries and settings.
+static bool protocol_line_moves(const char *line)
+{
+  if (line[0] == '$') { return((line[1] == 'J') || (line[1] == 'H')); }
+  return(line[0] != '[');
+}
+
+// Returns true if client may run G-code now, and makes it the owner of the job.
+static bool protocol_take_job(uint8_t client)
+{
+  #ifdef ENABLE_SD_CARD
+    if (get_sd_state(false) == SDCARD_BUSY_PRINTING) { return(false); }
+  #endif
+  if (job_owner && (job_owner != client)) { return(false); }
+  job_owner = client;
+  job_owner_time = millis();
+  return(true);
+}
+
+// The owner lets go once the machine has been idle with nothing planned for JOB_OWNER_RELEASE_MS
+// after its last line. A sender waiting for a dwell or a tool change keeps the job.
+static void protocol_release_job()
+{
+  if (job_owner && (sys.state == STATE_IDLE) && (plan_get_current_block() == NULL)) {
+    if ((millis()-job_owner_time) > JOB_OWNER_RELEASE_MS) { job_owner = 0; }
+  }
+}
+#endif
+
+// Executes the assembled line[] from client, reports the status and starts the next line.
+static void protocol_execute_line(protocol_client_t *pc, uint8_t client)
+{
+  char *line = pc->line;
+  line[pc->char_counter] = 0; // Set string termination character.
+  #ifdef REPORT_ECHO_LINE_RECEIVED
+    report_echo_line_received(line, client);
+  #endif
+
+  // Direct and execute one line of formatted input, and report status of execution.
+  if (pc->line_flags & LINE_FLAG_OVERFLOW) {
+    // Report line overflow error.
+    report_status_message(gc_line_overflow_status(line), client);
+  } else if (line[0] == 0) {
+    // Empty or comment line. For syncing purposes.
+    report_status_message(STATUS_OK, client);
+  #ifdef ENABLE_JOB_OWNERSHIP
+  } else if (protocol_line_moves(line) && !protocol_take_job(client)) {
+    report_status_message(STATUS_NOT_JOB_OWNER, client);
+  #endif
+  } else if (line[0] == '$') {
+    // Grbl '$' system command
+    report_status_message(system_execute_line(line, client), client);
+  } else if (line[0] == '[') {
+    int cmd = 0;
+    String cmd_params;
+    if (COMMANDS::check_command (line, &cmd, cmd_params)) {
+      ESPResponseStream espresponse(client, true);
+      if (!COMMANDS::execute_internal_command  (cmd, cmd_params, LEVEL_GUEST, &espresponse)) {
+        report_status_message(STATUS_GCODE_UNSUPPORTED_COMMAND, CLIENT_ALL);
+      }
+    } else grbl_sendf(client, "[MSG: Unknow Command...%s]\r\n", line);
+  } else if (sys.state & (STATE_ALARM | STATE_JOG)) {
+    // Everything else is gcode. Block if in alarm or jog mode.
+    report_status_message(STATUS_SYSTEM_GC_LOCK, client);
+  } else {
+    // Parse and execute g-code block.
+    report_status_message(gc_execute_line(line, client), client);
+  }
+
+  // Reset tracking data for next line.
+  protocol_reset_line(pc);
+}
+
 
 /*
   GRBL PRIMARY LOOP:
@@ -70,7 +282,7 @@ void protocol_main_loop()
       protocol_execute_realtime(); // Enter safety door mode. Should return as IDLE state.
     }
     // All systems go!
-    system_execute_startup(line); // Execute startup script.
+    system_execute_startup(protocol_clients[0].line); // Execute startup script. Any line buffer will do.
   }
 
   // ---------------------------------------------------------------------------------
@@ -78,130 +290,79 @@ void protocol_main_loop()
   // This is also where Grbl idles while waiting for something to do.
   // ---------------------------------------------------------------------------------
 
-  uint8_t line_flags = 0;
-  uint8_t char_counter = 0;
-  uint8_t comment_char_counter = 0;
-  uint8_t c;
-	
-  for (;;) {
-		lv_task_handler();
+  // Start from empty lines. A reset may have interrupted the last ones.
+  memset(protocol_clients, 0, sizeof(protocol_clients));
+  #ifdef ENABLE_JOB_OWNERSHIP
+    job_owner = 0;
+  #endif
 
-    // Process one line of incoming serial data, as the data becomes available. Performs an
-    // initial filtering by removing spaces and comments and capitalizing all letters.
-		
-		uint8_t client = CLIENT_SERIAL;
-		for (client = 0; client <= CLIENT_COUNT; client++)
+  for (;;) {
+    // Process the lines of incoming serial data, as the data becomes available. Each client's
+    // receive ring is read a chunk at a time and split at the line ends, and the runs in between
+    // go through the filtering that removes spaces and comments and capitalizes all letters.
+    // The clients take turns, a line each, so a busy sender can't hold the others off.
+		bool lines_pending = false; // A client may have more lines than its turn took
+		for (uint8_t i = 0; i < CLIENT_COUNT; i++)
 		{
-			while((c = serial_read(client)) != SERIAL_NO_DATA) {
-				if ((c == '\n') || (c == '\r')) { // End of line reached
-
-					protocol_execute_realtime(); // Runtime command check point.
-					if (sys.abort) { return; } // Bail to calling function upon system abort
-
-					line[char_counter] = 0; // Set string termination character.
-					#ifdef REPORT_ECHO_LINE_RECEIVED
-						report_echo_line_received(line, client);
-					#endif
-
-					// Direct and execute one line of formatted input, and report status of execution.
-					if (line_flags & LINE_FLAG_OVERFLOW) {
-						// Report line overflow error.
-						report_status_message(STATUS_OVERFLOW, client);
-					} else if (line[0] == 0) {
-						// Empty or comment line. For syncing purposes.
-						report_status_message(STATUS_OK, client);
-					} else if (line[0] == '$') {
-						// Grbl '$' system command
-						report_status_message(system_execute_line(line, client), client);
-					} else if (line[0] == '[') {
-                        int cmd = 0;
-                        String cmd_params;
-                        if (COMMANDS::check_command (line, &cmd, cmd_params)) {
-                            ESPResponseStream espresponse(client, true);
-                            if (!COMMANDS::execute_internal_command  (cmd, cmd_params, LEVEL_GUEST, &espresponse)) {
-                                report_status_message(STATUS_GCODE_UNSUPPORTED_COMMAND, CLIENT_ALL);
-                            }
-                        } else grbl_sendf(client, "[MSG: Unknow Command...%s]\r\n", line);
-					} else if (sys.state & (STATE_ALARM | STATE_JOG)) {
-						// Everything else is gcode. Block if in alarm or jog mode.
-						report_status_message(STATUS_SYSTEM_GC_LOCK, client);
-					} else {
-						// Parse and execute g-code block.
-						report_status_message(gc_execute_line(line, client), client);
-					}
-
-					// Reset tracking data for next line.
-					line_flags = 0;
-					char_counter = 0;
-					comment_char_counter = 0;
-				} else {
-					if (line_flags) {
-						if (line_flags & LINE_FLAG_BRACKET) {  // in bracket mode all characters are accepted
-							line[char_counter++] = c;
-						}
-						// Throw away all (except EOL) comment characters and overflow characters.
-						if (c == ')') {
-							// End of '()' comment. Resume line allowed.
-							if (line_flags & LINE_FLAG_COMMENT_PARENTHESES) { 
-								line_flags &= ~(LINE_FLAG_COMMENT_PARENTHESES); 
-								comment[comment_char_counter] = 0; // null terminate								
-								report_gcode_comment(comment);								
-							}
-						}
-						if (line_flags & LINE_FLAG_COMMENT_PARENTHESES) {  // capture all characters into a comment buffer
-							comment[comment_char_counter++] = c;
-						}
-					} else {
-						if (c <= ' ') {
-							// Throw away whitepace and control characters
-						} 
-						/*
-						else if (c == '/') {
-							// Block delete NOT SUPPORTED. Ignore character.
-							// NOTE: If supported, would simply need to check the system if block delete is enabled.
-						} 
-						*/
-						else if (c == '(') {
-							// Enable comments flag and ignore all characters until ')' or EOL.
-							// NOTE: This doesn't follow the NIST definition exactly, but is good enough for now.
-							// In the future, we could simply remove the items within the comments, but retain the
-							// comment control characters, so that the g-code parser can error-check it.
-							line_flags |= LINE_FLAG_COMMENT_PARENTHESES;
-							comment_char_counter = 0;
-						} else if (c == ';') {
-							// NOTE: ';' comment to EOL is a LinuxCNC definition. Not NIST.
-							line_flags |= LINE_FLAG_COMMENT_SEMICOLON;
-						} else if (c == '[') {
-							// For ESP3D bracket commands like [ESP100]<SSID>pwd=<admin password>
-							// prevents spaces being striped and converting to uppercase
-							line_flags |= LINE_FLAG_BRACKET;
-							line[char_counter++] = c; // capture this character
-							
-						// TODO: Install '%' feature
-						} else if (c == '%') {
-							// Program start-end percent sign NOT SUPPORTED.
-							// NOTE: This maybe installed to tell Grbl when a program is running vs manual input,
-							// where, during a program, the system auto-cycle start will continue to execute
-							// everything until the next '%' sign. This will help fix resuming issues with certain
-							// functions that empty the planner buffer to execute its task on-time.
-						} else if (char_counter >= (LINE_BUFFER_SIZE-1)) {
-							// Detect line buffer overflow and set flag.
-							line_flags |= LINE_FLAG_OVERFLOW;
-						} else if (c >= 'a' && c <= 'z') { // Upcase lowercase
-							line[char_counter++] = c-'a'+'A';
-						} else {
-							line[char_counter++] = c;
-						}
-					}
-
+			uint8_t client = ((protocol_first_client+i) % CLIENT_COUNT)+1;
+			protocol_client_t *pc = &protocol_clients[client-1];
+			uint8_t lines = 1;
+			#ifdef ENABLE_JOB_OWNERSHIP
+				if (client == job_owner) { lines = JOB_OWNER_LINES; }
+			#endif
+			while (protocol_read_line(pc, client)) {
+				// End of line reached
+				protocol_execute_realtime(); // Runtime command check point.
+				if (sys.abort) { return; } // Bail to calling function upon system abort
+				protocol_execute_line(pc, client);
+				if (--lines == 0) {
+					lines_pending = true;
+					break;
 				}
-			} // while serial read
+			}
 		} // for clients
+		protocol_first_client = (protocol_first_client+1) % CLIENT_COUNT;
+		#ifdef ENABLE_JOB_OWNERSHIP
+			protocol_release_job();
+		#endif
+
+#ifdef ENABLE_SD_CARD
+		// Feed a running SD job one line per "ok". The streamer task has already read and filtered
+		// the lines, so they go straight to the parser.
+		if (SD_ready_next) {
+			char fileLine[LINE_BUFFER_SIZE];
+			switch (sd_get_next_line(fileLine)) {
+				case SD_LINE_READY:
+					SD_ready_next = false;
+					report_status_message(gc_execute_line(fileLine, SD_client), SD_client);
+					break;
+				case SD_LINE_RECORD:
+					SD_ready_next = false;
+					report_status_message(gc_binary_execute((uint8_t *)fileLine, SD_client), SD_client);
+					break;
+				case SD_LINE_OVERFLOW:
+					SD_ready_next = false;
+					report_status_message(gc_line_overflow_status(fileLine), SD_client); // Stops the job.
+					break;
+				case SD_LINE_FAILED:
+					SD_ready_next = false;
+					report_status_message(STATUS_SD_FAILED_READ, SD_client); // Stops the job.
+					break;
+				case SD_LINE_END:
+					sd_get_current_filename(fileLine, LINE_BUFFER_SIZE);
+					grbl_notifyf("SD print done", "%s print is successful", fileLine);
+					closeFile();
+					break;
+				default: // SD_LINE_PENDING
+					break;
+			}
+		}
+#endif
 		
     // If there are no more characters in the serial read buffer to be processed and executed,
     // this indicates that g-code streaming has either filled the planner buffer or has
     // completed. In either case, auto-cycle start, if enabled, any queued moves.
-    protocol_auto_cycle_start();
+    if (!lines_pending) { protocol_auto_cycle_start(); }
 
     protocol_execute_realtime();  // Runtime command check point.
     if (sys.abort) { return; } // Bail to main() program loop to reset system.
@@ -228,7 +389,15 @@ void protocol_buffer_synchronize()
   do {
     protocol_execute_realtime();   // Check and execute run-time commands
     if (sys.abort) { return; } // Check for system abort
-  } while (plan_get_current_block() || (sys.state == STATE_CYCLE));
+  } while (protocol_motion_pending());
+}
+
+
+// True while protocol_buffer_synchronize() would wait. Spindle and coolant changes then go with
+// the motion instead of waiting for it.
+bool protocol_motion_pending()
+{
+  return((plan_get_current_block() != NULL) || (sys.state == STATE_CYCLE));
 }
 
 
@@ -269,6 +438,9 @@ void protocol_execute_realtime()
 // NOTE: Do not alter this unless you know exactly what you are doing!
 void protocol_exec_rt_system()
 {
+  // Refresh the state the serial task reports from when a client asks for '?'.
+  report_status_publish();
+
   uint8_t rt_exec; // Temp variable to avoid calling volatile multiple times.
   rt_exec = sys_rt_exec_alarm; // Copy volatile sys_rt_exec_alarm.
   if (rt_exec) { // Enter only if any bit flag is true
@@ -451,6 +623,11 @@ void protocol_exec_rt_system()
         } else {
           sys.suspend = SUSPEND_DISABLE;
           sys.state = STATE_IDLE;
+          if (plan_get_current_block() == NULL) {
+            // Set spindle and coolant changes that came after the last block.
+            spindle_sync_flush();
+            coolant_sync_flush();
+          }
         }
       }
       system_clear_exec_state_flag(EXEC_CYCLE_STOP);
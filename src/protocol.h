@@ -49,6 +49,9 @@ void protocol_auto_cycle_start();
 // Block until all buffered steps are executed
 void protocol_buffer_synchronize();
 
+// Returns true while there are buffered steps to execute.
+bool protocol_motion_pending();
+
 // Executes the auto cycle feature, if enabled.
 void protocol_auto_cycle_start();
 
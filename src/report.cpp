@@ -51,57 +51,39 @@
 #define DEFAULTBUFFERSIZE 64
 
 // this is a generic send function that everything should use, so interfaces could be added (Bluetooth, etc)
+// The text is only queued here. The serial, Bluetooth, WebUI and telnet outputs each have a task
+// that writes it out (see serial_send()), so a slow peer does not hold up the caller.
 void grbl_send(uint8_t client, const char *text)
 {	
     if (client == CLIENT_INPUT) return;
-#ifdef ENABLE_BLUETOOTH
-    if (SerialBT.hasClient() && ( client == CLIENT_BT || client == CLIENT_ALL ) )
-    {
-				
-        SerialBT.print(text);
-        //delay(10); // possible fix for dropped characters					
-    }
-#endif
-    
-#if defined (ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_OUT)
-		if ( client == CLIENT_WEBUI || client == CLIENT_ALL )
-			Serial2Socket.write((const uint8_t*)text, strlen(text));
-#endif
+	if ( client == CLIENT_GUI || client == CLIENT_ALL )
+		gui_send(text);
 
-#if defined (ENABLE_WIFI) && defined(ENABLE_TELNET)
-		if ( client == CLIENT_TELNET || client == CLIENT_ALL ){
-                telnet_server.write((const uint8_t*)text, strlen(text));
-            }
-#endif
-	
-	if ( client == CLIENT_SERIAL || client == CLIENT_ALL )
-		Serial.print(text);	
+	serial_send(client, text);
+}
+
+// Formats a message for grbl_sendf() and grbl_notifyf() in one pass, into a REPORT_MESSAGE_SIZE
+// buffer on the caller's stack. Text that does not fit is cut short, but a line keeps its end so
+// the next message starts on a line of its own.
+static void report_util_vformat(char *text, const char *format, va_list arg)
+{
+  int len = vsnprintf(text, REPORT_MESSAGE_SIZE, format, arg);
+  size_t format_len = strlen(format);
+  if ((len >= REPORT_MESSAGE_SIZE) && (format_len > 0) && (format[format_len-1] == '\n')) {
+    strcpy(&text[REPORT_MESSAGE_SIZE-3], "\r\n");
+  }
 }
 
 // This is a formating version of the grbl_send(CLIENT_ALL,...) function that work like printf
 void grbl_sendf(uint8_t client, const char *format, ...)
 {
     if (client == CLIENT_INPUT) return;
-    char loc_buf[64];
-    char * temp = loc_buf;
+    char text[REPORT_MESSAGE_SIZE];
     va_list arg;
-    va_list copy;
     va_start(arg, format);
-    va_copy(copy, arg);
-    size_t len = vsnprintf(NULL, 0, format, arg);
-    va_end(copy);
-    if(len >= sizeof(loc_buf)){
-        temp = new char[len+1];
-        if(temp == NULL) {
-            return;
-        }
-    }
-    len = vsnprintf(temp, len+1, format, arg);
-    grbl_send(client, temp);
+    report_util_vformat(text, format, arg);
     va_end(arg);
-    if(len > 64){
-        delete[] temp;
-    }
+    grbl_send(client, text);
 }
 
 //function to notify
@@ -112,53 +94,63 @@ void grbl_notify(const char *title, const char *msg){
 }
 
 void grbl_notifyf(const char *title, const char *format, ...){
-char loc_buf[64];
-    char * temp = loc_buf;
+    char text[REPORT_MESSAGE_SIZE];
     va_list arg;
-    va_list copy;
     va_start(arg, format);
-    va_copy(copy, arg);
-    size_t len = vsnprintf(NULL, 0, format, arg);
-    va_end(copy);
-    if(len >= sizeof(loc_buf)){
-        temp = new char[len+1];
-        if(temp == NULL) {
-            return;
-        }
-    }
-    len = vsnprintf(temp, len+1, format, arg);
-    grbl_notify(title, temp);
+    report_util_vformat(text, format, arg);
     va_end(arg);
-    if(len > 64){
-        delete[] temp;
-    }
+    grbl_notify(title, text);
 }
 
-// formats axis values into a string and returns that string in rpt
-static void report_util_axis_values(float *axis_value, char *rpt) {
-  uint8_t idx;
-	char axisVal[10];
-	float unit_conv = 1.0; // unit conversion multiplier..default is mm
-	
-	rpt[0] = '\0';
-	
-	if (bit_istrue(settings.flags,BITFLAG_REPORT_INCHES))
-		unit_conv = 1.0 / MM_PER_INCH;
-	
-  for (idx=0; idx<N_AXIS; idx++) {
-		
-		if (bit_istrue(settings.flags,BITFLAG_REPORT_INCHES))
-			sprintf(axisVal, "%4.4f", axis_value[idx] * unit_conv);  // Report inches to 4 decimals
-		else
-			sprintf(axisVal, "%4.3f", axis_value[idx] * unit_conv);  // Report mm to 3 decimals
-			
-		strcat(rpt, axisVal);
-    
-    if (idx < (N_AXIS-1)) 
-		{ 
-			strcat(rpt, ",");
-		}
+// Appends the axis values, comma separated, in the report units.
+static char *report_util_append_axis_values(char *rpt, float *axis_value)
+{
+  for (uint8_t idx=0; idx<N_AXIS; idx++) {
+    if (bit_istrue(settings.flags,BITFLAG_REPORT_INCHES)) {
+      rpt = print_append_float(rpt, axis_value[idx]*INCH_PER_MM, N_DECIMAL_COORDVALUE_INCH);
+    } else {
+      rpt = print_append_float(rpt, axis_value[idx], N_DECIMAL_COORDVALUE_MM);
+    }
+    if (idx < (N_AXIS-1)) { *rpt++ = ','; }
   }
+  return(rpt);
+}
+
+// Sends prefix, a number and suffix as one message, like "error:" 20 "\r\n".
+static void report_util_send_int(uint8_t client, const char *prefix, int32_t n, const char *suffix)
+{
+  char text[REPORT_MESSAGE_SIZE];
+  char *p = print_append_string(text, prefix);
+  p = print_append_int32(p, n);
+  print_append_string(p, suffix);
+  grbl_send(client, text);
+}
+
+// Appends text from the user, cut short at end so a bounded message always fits.
+static char *report_util_append_text(char *rpt, const char *text, const char *end)
+{
+  while (*text && (rpt < end)) { *rpt++ = *text++; }
+  *rpt = 0;
+  return(rpt);
+}
+
+// Appends a setting line for $$, like "$11=0.010\r\n".
+static char *report_util_setting_uint(char *rpt, uint8_t n, uint32_t value)
+{
+  *rpt++ = '$';
+  rpt = print_append_uint32(rpt, n);
+  *rpt++ = '=';
+  rpt = print_append_uint32(rpt, value);
+  return(print_append_string(rpt, "\r\n"));
+}
+
+static char *report_util_setting_float(char *rpt, uint8_t n, float value)
+{
+  *rpt++ = '$';
+  rpt = print_append_uint32(rpt, n);
+  *rpt++ = '=';
+  rpt = print_append_float(rpt, value, N_DECIMAL_SETTINGVALUE);
+  return(print_append_string(rpt, "\r\n"));
 }
 
 void get_state(char *foo)
@@ -176,6 +168,19 @@ void get_state(char *foo)
   }
 }
 
+#ifdef ENABLE_SD_CARD
+static void report_util_sd_error(uint8_t status_code)
+{
+	char text[REPORT_MESSAGE_SIZE];
+	char *p = print_append_string(text, "error:");
+	p = print_append_uint32(p, status_code);
+	p = print_append_string(p, " in SD file at line ");
+	p = print_append_uint32(p, sd_get_current_line_number());
+	print_append_string(p, "\r\n");
+	grbl_send(CLIENT_ALL, text);
+}
+#endif
+
 // Handles the primary confirmation protocol response for streaming interfaces and human-feedback.
 // For every incoming line, this method responds with an 'ok' for a successful command or an
 // 'error:'  to indicate some error event with the line or some critical system error during
@@ -200,19 +205,19 @@ void report_status_message(uint8_t status_code, uint8_t client)
 			// do we need to stop a running SD job?
 			if (get_sd_state(false) == SDCARD_BUSY_PRINTING) {
 				if (status_code == STATUS_GCODE_UNSUPPORTED_COMMAND) {
-					grbl_sendf(client, "error:%d\r\n", status_code); // most senders seem to tolerate this error and keep on going
-					grbl_sendf(CLIENT_ALL, "error:%d in SD file at line %d\r\n", status_code, sd_get_current_line_number());
+					report_util_send_int(client, "error:", status_code, "\r\n"); // most senders seem to tolerate this error and keep on going
+					report_util_sd_error(status_code);
 					// don't close file
 				}
 				else {
 					grbl_notifyf("SD print error", "Error:%d during SD file at line: %d", status_code, sd_get_current_line_number());
-					grbl_sendf(CLIENT_ALL, "error:%d in SD file at line %d\r\n", status_code, sd_get_current_line_number());
+					report_util_sd_error(status_code);
 					closeFile();
 				}
 				return;
 			}
 			#endif
-			grbl_sendf(client, "error:%d\r\n", status_code);
+			report_util_send_int(client, "error:", status_code, "\r\n");
   }
 }
 
@@ -221,7 +226,7 @@ void report_status_message(uint8_t status_code, uint8_t client)
 // Prints alarm messages.
 void report_alarm_message(uint8_t alarm_code)
 {	
-	grbl_sendf(CLIENT_ALL, "ALARM:%d\r\n", alarm_code);		// OK to send to all clients
+	report_util_send_int(CLIENT_ALL, "ALARM:", alarm_code, "\r\n");		// OK to send to all clients
   delay_ms(500); // Force delay to ensure message clears serial write buffer.
 }
 
@@ -258,7 +263,7 @@ void report_feedback_message(uint8_t message_code)  // OK to send to all clients
 #ifdef ENABLE_SD_CARD
 		case MESSAGE_SD_FILE_QUIT:
 			grbl_notifyf("SD print canceled", "Reset during SD file at line: %d", sd_get_current_line_number());
-			grbl_sendf(CLIENT_ALL, "[MSG:Reset during SD file at line: %d]\r\n", sd_get_current_line_number()); break;
+			report_util_send_int(CLIENT_ALL, "[MSG:Reset during SD file at line: ", sd_get_current_line_number(), "]\r\n"); break;
 #endif
   }  		
 }
@@ -283,51 +288,50 @@ void report_grbl_help(uint8_t client) {
 // NOTE: The numbering scheme here must correlate to storing in settings.c
 void report_grbl_settings(uint8_t client) {
   // Print Grbl settings.
-	char setting[20];
-	char rpt[1000];
-	
-	rpt[0] = '\0';
+	char rpt[1100];
+	char *p = rpt;
 	
-	sprintf(setting, "$0=%d\r\n", settings.pulse_microseconds); strcat(rpt, setting);	
-	sprintf(setting, "$1=%d\r\n", settings.stepper_idle_lock_time);  strcat(rpt, setting);
-	sprintf(setting, "$2=%d\r\n", settings.step_invert_mask);  strcat(rpt, setting);
-	sprintf(setting, "$3=%d\r\n", settings.dir_invert_mask);  strcat(rpt, setting);
-	sprintf(setting, "$4=%d\r\n", bit_istrue(settings.flags,BITFLAG_INVERT_ST_ENABLE));  strcat(rpt, setting);
-	sprintf(setting, "$5=%d\r\n", bit_istrue(settings.flags,BITFLAG_INVERT_LIMIT_PINS));  strcat(rpt, setting);
-	sprintf(setting, "$6=%d\r\n", bit_istrue(settings.flags,BITFLAG_INVERT_PROBE_PIN));  strcat(rpt, setting);
-	sprintf(setting, "$10=%d\r\n", settings.status_report_mask);  strcat(rpt, setting);
+	p = report_util_setting_uint(p, 0, settings.pulse_microseconds);
+	p = report_util_setting_uint(p, 1, settings.stepper_idle_lock_time);
+	p = report_util_setting_uint(p, 2, settings.step_invert_mask);
+	p = report_util_setting_uint(p, 3, settings.dir_invert_mask);
+	p = report_util_setting_uint(p, 4, bit_istrue(settings.flags,BITFLAG_INVERT_ST_ENABLE));
+	p = report_util_setting_uint(p, 5, bit_istrue(settings.flags,BITFLAG_INVERT_LIMIT_PINS));
+	p = report_util_setting_uint(p, 6, bit_istrue(settings.flags,BITFLAG_INVERT_PROBE_PIN));
+	p = report_util_setting_uint(p, 10, settings.status_report_mask);
 	
-	sprintf(setting, "$11=%4.3f\r\n", settings.junction_deviation);   strcat(rpt, setting);	
-	sprintf(setting, "$12=%4.3f\r\n", settings.arc_tolerance);   strcat(rpt, setting);	
+	p = report_util_setting_float(p, 11, settings.junction_deviation);
+	p = report_util_setting_float(p, 12, settings.arc_tolerance);
 	
 	
-	sprintf(setting, "$13=%d\r\n", bit_istrue(settings.flags,BITFLAG_REPORT_INCHES));   strcat(rpt, setting);	
-	sprintf(setting, "$20=%d\r\n", bit_istrue(settings.flags,BITFLAG_SOFT_LIMIT_ENABLE));   strcat(rpt, setting);	
-	sprintf(setting, "$21=%d\r\n", bit_istrue(settings.flags,BITFLAG_HARD_LIMIT_ENABLE));   strcat(rpt, setting);	
-	sprintf(setting, "$22=%d\r\n", bit_istrue(settings.flags,BITFLAG_HOMING_ENABLE));   strcat(rpt, setting);	
-	sprintf(setting, "$23=%d\r\n", settings.homing_dir_mask);   strcat(rpt, setting);	
+	p = report_util_setting_uint(p, 13, bit_istrue(settings.flags,BITFLAG_REPORT_INCHES));
+	p = report_util_setting_uint(p, 20, bit_istrue(settings.flags,BITFLAG_SOFT_LIMIT_ENABLE));
+	p = report_util_setting_uint(p, 21, bit_istrue(settings.flags,BITFLAG_HARD_LIMIT_ENABLE));
+	p = report_util_setting_uint(p, 22, bit_istrue(settings.flags,BITFLAG_HOMING_ENABLE));
+	p = report_util_setting_uint(p, 23, settings.homing_dir_mask);
 	
-	sprintf(setting, "$24=%4.3f\r\n", settings.homing_feed_rate);   strcat(rpt, setting);	
-	sprintf(setting, "$25=%4.3f\r\n", settings.homing_seek_rate);   strcat(rpt, setting);	
+	p = report_util_setting_float(p, 24, settings.homing_feed_rate);
+	p = report_util_setting_float(p, 25, settings.homing_seek_rate);
 
-	sprintf(setting, "$26=%d\r\n", settings.homing_debounce_delay);   strcat(rpt, setting);	
+	p = report_util_setting_uint(p, 26, settings.homing_debounce_delay);
   
-	sprintf(setting, "$27=%4.3f\r\n", settings.homing_pulloff);   strcat(rpt, setting);	
-	sprintf(setting, "$30=%4.3f\r\n", settings.rpm_max);   strcat(rpt, setting);	
-	sprintf(setting, "$31=%4.3f\r\n", settings.rpm_min);   strcat(rpt, setting);	
+	p = report_util_setting_float(p, 27, settings.homing_pulloff);
+	p = report_util_setting_float(p, 30, settings.rpm_max);
+	p = report_util_setting_float(p, 31, settings.rpm_min);
 	 
   #ifdef VARIABLE_SPINDLE
-		sprintf(setting, "$32=%d\r\n", bit_istrue(settings.flags,BITFLAG_LASER_MODE));  strcat(rpt, setting);	
+		p = report_util_setting_uint(p, 32, bit_istrue(settings.flags,BITFLAG_LASER_MODE));
   #else
-    strcat(rpt, "$32=0\r\n");
+    p = print_append_string(p, "$32=0\r\n");
   #endif
   
   #ifdef SHOW_EXTENDED_SETTINGS
-		sprintf(setting, "$33=%5.3f\r\n", settings.spindle_pwm_freq);   strcat(rpt, setting);
-		sprintf(setting, "$34=%3.3f\r\n", settings.spindle_pwm_off_value);   strcat(rpt, setting);
-		sprintf(setting, "$35=%3.3f\r\n", settings.spindle_pwm_min_value);   strcat(rpt, setting);
-		sprintf(setting, "$36=%3.3f\r\n", settings.spindle_pwm_max_value);   strcat(rpt, setting);		
+		p = report_util_setting_float(p, 33, settings.spindle_pwm_freq);
+		p = report_util_setting_float(p, 34, settings.spindle_pwm_off_value);
+		p = report_util_setting_float(p, 35, settings.spindle_pwm_min_value);
+		p = report_util_setting_float(p, 36, settings.spindle_pwm_max_value);
   #endif
+	p = report_util_setting_uint(p, 37, settings.planner_blocks);
 	
   // Print axis settings
   uint8_t idx, set_idx;
@@ -335,14 +339,14 @@ void report_grbl_settings(uint8_t client) {
   for (set_idx=0; set_idx<AXIS_N_SETTINGS; set_idx++) {
     for (idx=0; idx<N_AXIS; idx++) {
       switch (set_idx) {
-				case 0: sprintf(setting, "$%d=%4.3f\r\n", val+idx, settings.steps_per_mm[idx]);   strcat(rpt, setting);	 break;
-				case 1: sprintf(setting, "$%d=%4.3f\r\n", val+idx, settings.max_rate[idx]);   strcat(rpt, setting);	 break;
-				case 2: sprintf(setting, "$%d=%4.3f\r\n", val+idx, settings.acceleration[idx]/(60*60));   strcat(rpt, setting);	 break;
-				case 3: sprintf(setting, "$%d=%4.3f\r\n", val+idx, -settings.max_travel[idx]);   strcat(rpt, setting);	 break;
+				case 0: p = report_util_setting_float(p, val+idx, settings.steps_per_mm[idx]); break;
+				case 1: p = report_util_setting_float(p, val+idx, settings.max_rate[idx]); break;
+				case 2: p = report_util_setting_float(p, val+idx, settings.acceleration[idx]/(60*60)); break;
+				case 3: p = report_util_setting_float(p, val+idx, -settings.max_travel[idx]); break;
 				#ifdef SHOW_EXTENDED_SETTINGS
-					case 4: sprintf(setting, "$%d=%4.3f\r\n", val+idx, settings.current[idx]);   strcat(rpt, setting);	 break;
-					case 5: sprintf(setting, "$%d=%4.3f\r\n", val+idx, settings.hold_current[idx]);   strcat(rpt, setting);	 break;
-					case 6: sprintf(setting, "$%d=%d\r\n", val+idx, settings.microsteps[idx]);   strcat(rpt, setting);	 break;
+					case 4: p = report_util_setting_float(p, val+idx, settings.current[idx]); break;
+					case 5: p = report_util_setting_float(p, val+idx, settings.hold_current[idx]); break;
+					case 6: p = report_util_setting_uint(p, val+idx, settings.microsteps[idx]); break;
 				#endif
       }
     }
@@ -365,18 +369,16 @@ void report_probe_parameters(uint8_t client)
   // Report in terms of machine position.	
 	float print_position[N_AXIS];
 	char probe_rpt[100];	// the probe report we are building here
-	char temp[60];
-	
-	strcpy(probe_rpt, "[PRB:"); // initialize the string with the first characters
+	char *p = print_append_string(probe_rpt, "[PRB:");
   
 	// get the machine position and put them into a string and append to the probe report
   system_convert_array_steps_to_mpos(print_position,sys_probe_position);
-	report_util_axis_values(print_position, temp);	
-	strcat(probe_rpt, temp);
+	p = report_util_append_axis_values(p, print_position);
 	
 	// add the success indicator and add closing characters
-	sprintf(temp, ":%d]\r\n", sys.probe_succeeded);	
-	strcat(probe_rpt, temp);
+	*p++ = ':';
+	p = print_append_uint32(p, sys.probe_succeeded);
+	print_append_string(p, "]\r\n");
 	
 	grbl_send(client, probe_rpt); // send the report 
 }
@@ -389,43 +391,35 @@ void report_ngc_parameters(uint8_t client)
 {
   float coord_data[N_AXIS];
   uint8_t coord_select;
-	char temp[60];
 	char ngc_rpt[500];	
-	
-	ngc_rpt[0] = '\0';	
+	char *p = ngc_rpt;
 	
   for (coord_select = 0; coord_select <= SETTING_INDEX_NCOORD; coord_select++) {
     if (!(settings_read_coord_data(coord_select,coord_data))) {
       report_status_message(STATUS_SETTING_READ_FAIL, CLIENT_SERIAL);
       return;
     }
-		strcat(ngc_rpt, "[G");    
+		p = print_append_string(p, "[G");
     switch (coord_select) {
-      case 6: strcat(ngc_rpt, "28"); break;
-      case 7: strcat(ngc_rpt, "30"); break;
-      default: 
-			  sprintf(temp, "%d", coord_select+54);
-				strcat(ngc_rpt, temp);
-				break; // G54-G59
+      case 6: p = print_append_string(p, "28"); break;
+      case 7: p = print_append_string(p, "30"); break;
+      default: p = print_append_uint32(p, coord_select+54); break; // G54-G59
     }    
-		strcat(ngc_rpt, ":");		
-    report_util_axis_values(coord_data, temp);
-		strcat(ngc_rpt, temp);
-	  strcat(ngc_rpt, "]\r\n");    
+		*p++ = ':';
+    p = report_util_append_axis_values(p, coord_data);
+	  p = print_append_string(p, "]\r\n");
   }
 		
-	strcat(ngc_rpt, "[G92:"); // Print G92,G92.1 which are not persistent in memory
-  report_util_axis_values(gc_state.coord_offset, temp);
-	strcat(ngc_rpt, temp);
-	strcat(ngc_rpt, "]\r\n");
-  strcat(ngc_rpt, "[TLO:"); // Print tool length offset value
+	p = print_append_string(p, "[G92:"); // Print G92,G92.1 which are not persistent in memory
+  p = report_util_append_axis_values(p, gc_state.coord_offset);
+	p = print_append_string(p, "]\r\n[TLO:"); // Print tool length offset value
 	
 	if (bit_istrue(settings.flags,BITFLAG_REPORT_INCHES)) {
-		sprintf(temp, "%4.3f]\r\n", gc_state.tool_length_offset * INCH_PER_MM);
+		p = print_append_float(p, gc_state.tool_length_offset * INCH_PER_MM, N_DECIMAL_COORDVALUE_INCH);
   } else {
-    sprintf(temp, "%4.3f]\r\n", gc_state.tool_length_offset);
+    p = print_append_float(p, gc_state.tool_length_offset, N_DECIMAL_COORDVALUE_MM);
   }
-	strcat(ngc_rpt, temp);
+	print_append_string(p, "]\r\n");
 	
 	grbl_send(client, ngc_rpt);
 	
@@ -437,82 +431,77 @@ void report_ngc_parameters(uint8_t client)
 // Print current gcode parser mode state
 void report_gcode_modes(uint8_t client)
 {
-	char temp[20];
 	char modes_rpt[75];
-	
-	
-  strcpy(modes_rpt, "[GC:G");
-	
+	char *p = print_append_string(modes_rpt, "[GC:G");
 	
   if (gc_state.modal.motion >= MOTION_MODE_PROBE_TOWARD) {
-    sprintf(temp, "38.%d", gc_state.modal.motion - (MOTION_MODE_PROBE_TOWARD-2));		
+    p = print_append_string(p, "38.");
+    p = print_append_uint32(p, gc_state.modal.motion - (MOTION_MODE_PROBE_TOWARD-2));
   } else {
-		sprintf(temp, "%d", gc_state.modal.motion);	    
+		p = print_append_uint32(p, gc_state.modal.motion);
   }
-	strcat(modes_rpt, temp);
 
-	sprintf(temp, " G%d", gc_state.modal.coord_select+54);
-	strcat(modes_rpt, temp);
+	p = print_append_string(p, " G");
+	p = print_append_uint32(p, gc_state.modal.coord_select+54);
 	
-  sprintf(temp, " G%d", gc_state.modal.plane_select+17);
-	strcat(modes_rpt, temp);
+  p = print_append_string(p, " G");
+	p = print_append_uint32(p, gc_state.modal.plane_select+17);
 
-  sprintf(temp, " G%d", 21-gc_state.modal.units);
-	strcat(modes_rpt, temp);
+  p = print_append_string(p, " G");
+	p = print_append_uint32(p, 21-gc_state.modal.units);
 
-	sprintf(temp, " G%d", gc_state.modal.distance+90);
-	strcat(modes_rpt, temp);
+	p = print_append_string(p, " G");
+	p = print_append_uint32(p, gc_state.modal.distance+90);
 
-  sprintf(temp, " G%d", 94-gc_state.modal.feed_rate);
-	strcat(modes_rpt, temp);
+  p = print_append_string(p, " G");
+	p = print_append_uint32(p, 94-gc_state.modal.feed_rate);
 
   
   if (gc_state.modal.program_flow) {
     //report_util_gcode_modes_M();
     switch (gc_state.modal.program_flow) {
-      case PROGRAM_FLOW_PAUSED : strcat(modes_rpt, " M0"); //serial_write('0'); break;
+      case PROGRAM_FLOW_PAUSED : p = print_append_string(p, " M0"); break;
       // case PROGRAM_FLOW_OPTIONAL_STOP : serial_write('1'); break; // M1 is ignored and not supported.
       case PROGRAM_FLOW_COMPLETED_M2 : 
       case PROGRAM_FLOW_COMPLETED_M30 : 
-			  sprintf(temp, " M%d", gc_state.modal.program_flow);
-				strcat(modes_rpt, temp);
+			  p = print_append_string(p, " M");
+				p = print_append_uint32(p, gc_state.modal.program_flow);
         break;
     }
   }
 
   
   switch (gc_state.modal.spindle) {
-    case SPINDLE_ENABLE_CW : strcat(modes_rpt, " M3"); break;
-    case SPINDLE_ENABLE_CCW : strcat(modes_rpt, " M4"); break;
-    case SPINDLE_DISABLE : strcat(modes_rpt, " M5"); break;
+    case SPINDLE_ENABLE_CW : p = print_append_string(p, " M3"); break;
+    case SPINDLE_ENABLE_CCW : p = print_append_string(p, " M4"); break;
+    case SPINDLE_DISABLE : p = print_append_string(p, " M5"); break;
   }
 
   //report_util_gcode_modes_M();  // optional M7 and M8 should have been dealt with by here
 	if (gc_state.modal.coolant) { // Note: Multiple coolant states may be active at the same time.
-		if (gc_state.modal.coolant & PL_COND_FLAG_COOLANT_MIST) { strcat(modes_rpt, " M7"); }      
-		if (gc_state.modal.coolant & PL_COND_FLAG_COOLANT_FLOOD) { strcat(modes_rpt, " M8"); }			
+		if (gc_state.modal.coolant & PL_COND_FLAG_COOLANT_MIST) { p = print_append_string(p, " M7"); }
+		if (gc_state.modal.coolant & PL_COND_FLAG_COOLANT_FLOOD) { p = print_append_string(p, " M8"); }
 	} 
 	else { 
-		strcat(modes_rpt, " M9"); 
+		p = print_append_string(p, " M9");
 	}  
 
-	sprintf(temp, " T%d", gc_state.tool);
-	strcat(modes_rpt, temp); 
-	
+	p = print_append_string(p, " T");
+	p = print_append_uint32(p, gc_state.tool);
 	
+	p = print_append_string(p, " F");
 	if (bit_istrue(settings.flags,BITFLAG_REPORT_INCHES)) {
-		sprintf(temp, " F%.1f", gc_state.feed_rate);
+		p = print_append_float(p, gc_state.feed_rate, 1);
 	} else {
-		sprintf(temp, " F%.0f", gc_state.feed_rate);
+		p = print_append_float(p, gc_state.feed_rate, 0);
 	}
-	strcat(modes_rpt, temp);
 	
   #ifdef VARIABLE_SPINDLE 
-		sprintf(temp, " S%4.3f", gc_state.spindle_speed);
-	  strcat(modes_rpt, temp);
+		p = print_append_string(p, " S");
+		p = print_append_float(p, gc_state.spindle_speed, 3);
   #endif
 
-  strcat(modes_rpt, "]\r\n");
+  print_append_string(p, "]\r\n");
 	
 	grbl_send(client, modes_rpt);
 }
@@ -522,12 +511,22 @@ void report_gcode_modes(uint8_t client)
 // Prints specified startup line
 void report_startup_line(uint8_t n, char *line, uint8_t client)
 {	
-	grbl_sendf(client, "$N%d=%s\r\n", n, line);	// OK to send to all
+	char text[REPORT_MESSAGE_SIZE];
+	char *p = print_append_string(text, "$N");
+	p = print_append_uint32(p, n);
+	*p++ = '=';
+	p = report_util_append_text(p, line, text+sizeof(text)-3);
+	print_append_string(p, "\r\n");
+	grbl_send(client, text);	// OK to send to all
 }
 
 void report_execute_startup_message(char *line, uint8_t status_code, uint8_t client)
 {	
-	grbl_sendf(client, ">%s:", line);  	// OK to send to all
+	char text[REPORT_MESSAGE_SIZE];
+	text[0] = '>';
+	char *p = report_util_append_text(text+1, line, text+sizeof(text)-2);
+	print_append_string(p, ":");
+	grbl_send(client, text);  	// OK to send to all
   report_status_message(status_code, client); 
 }
 	
@@ -614,7 +613,60 @@ void report_build_info(char *line, uint8_t client)
 // and has been sent into protocol_execute_line() routine to be executed by Grbl.
 void report_echo_line_received(char *line, uint8_t client)
 {		
-	grbl_sendf(client, "[echo: %s]\r\n", line);
+	char text[REPORT_MESSAGE_SIZE];
+	char *p = print_append_string(text, "[echo: ");
+	p = report_util_append_text(p, line, text+sizeof(text)-4);
+	print_append_string(p, "]\r\n");
+	grbl_send(client, text);
+}
+
+// Status snapshot published by the main loop, and by the homing cycle, which does not get back to
+// it until the cycle ends. The realtime report is requested on the serial
+// task (core 0) while the main loop and stepper run on core 1, so the report never reads the
+// live machine state. It copies this snapshot under a sequence lock instead: the writer makes
+// the sequence odd while it updates the data, and a reader retries until it copied the data
+// between two reads of the same even sequence. Neither side ever waits on the other.
+static report_status_snapshot_t status_snapshot;
+static volatile uint32_t status_snapshot_seq;
+
+void report_status_publish()
+{
+  uint32_t seq = status_snapshot_seq;
+  __atomic_store_n(&status_snapshot_seq, seq+1, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  status_snapshot.state = sys.state;
+  status_snapshot.suspend = sys.suspend;
+  memcpy(status_snapshot.position, sys_position, sizeof(sys_position));
+  for (uint8_t idx=0; idx<N_AXIS; idx++) {
+    // Apply work coordinate offsets and tool length offset to current position.
+    status_snapshot.wco[idx] = gc_state.coord_system[idx]+gc_state.coord_offset[idx];
+    if (idx == TOOL_LENGTH_OFFSET_AXIS) { status_snapshot.wco[idx] += gc_state.tool_length_offset; }
+  }
+  status_snapshot.planner_blocks_available = plan_get_block_buffer_available();
+  #ifdef USE_LINE_NUMBERS
+    plan_block_t * cur_block = plan_get_current_block();
+    status_snapshot.line_number = (cur_block != NULL) ? cur_block->line_number : 0;
+  #endif
+  status_snapshot.feed_rate = st_get_realtime_rate();
+  status_snapshot.spindle_speed = sys.spindle_speed;
+  status_snapshot.f_override = sys.f_override;
+  status_snapshot.r_override = sys.r_override;
+  status_snapshot.spindle_speed_ovr = sys.spindle_speed_ovr;
+  status_snapshot.spindle_state = spindle_get_state();
+  status_snapshot.coolant_state = coolant_get_state();
+
+  __atomic_store_n(&status_snapshot_seq, seq+2, __ATOMIC_RELEASE);
+}
+
+void report_status_snapshot(report_status_snapshot_t *copy)
+{
+  uint32_t seq;
+  do {
+    while ((seq = __atomic_load_n(&status_snapshot_seq, __ATOMIC_ACQUIRE)) & 1) { } // Update in progress
+    memcpy(copy, &status_snapshot, sizeof(report_status_snapshot_t));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  } while (__atomic_load_n(&status_snapshot_seq, __ATOMIC_RELAXED) != seq);
 }
 
  // Prints real-time data. This function grabs a real-time snapshot of the stepper subprogram
@@ -622,80 +674,66 @@ void report_echo_line_received(char *line, uint8_t client)
  // specific needs, but the desired real-time data report must be as short as possible. This is
  // requires as it minimizes the computational overhead and allows grbl to keep running smoothly,
  // especially during g-code programs with fast, short line segments and high frequency reports (5-20Hz).
+ // The report is formatted in a single pass into one buffer, from the snapshot published by
+ // report_status_publish().
 void report_realtime_status(uint8_t client)
 {
   uint8_t idx;
-  int32_t current_position[N_AXIS]; // Copy current state of the system position variable
-  memcpy(current_position,sys_position,sizeof(sys_position));
+  report_status_snapshot_t snap;
+  report_status_snapshot(&snap);
+
   float print_position[N_AXIS];
-	
-	char status[200];
-	char temp[80];
-	
-  system_convert_array_steps_to_mpos(print_position,current_position);
+  system_convert_array_steps_to_mpos(print_position, snap.position);
+
+  char status[REPORT_STATUS_BUFFER_SIZE];
+  char *p = status;
 
   // Report current machine state and sub-states  
-	strcpy(status, "<");
-  switch (sys.state) {
-    case STATE_IDLE: strcat(status, "Idle"); break;
-    case STATE_CYCLE: strcat(status, "Run"); break;
+  *p++ = '<';
+  switch (snap.state) {
+    case STATE_IDLE: p = print_append_string(p, "Idle"); break;
+    case STATE_CYCLE: p = print_append_string(p, "Run"); break;
     case STATE_HOLD:
-    
-      if (!(sys.suspend & SUSPEND_JOG_CANCEL)) {
-        strcat(status, "Hold:");
-        if (sys.suspend & SUSPEND_HOLD_COMPLETE) { strcat(status, "0"); } // Ready to resume
-        else { strcat(status, "1"); } // Actively holding
+      if (!(snap.suspend & SUSPEND_JOG_CANCEL)) {
+        p = print_append_string(p, "Hold:");
+        if (snap.suspend & SUSPEND_HOLD_COMPLETE) { *p++ = '0'; } // Ready to resume
+        else { *p++ = '1'; } // Actively holding
         break;
       } // Continues to print jog state during jog cancel.
-    case STATE_JOG: strcat(status, "Jog"); break;
-    case STATE_HOMING: strcat(status, "Home"); break;
-    case STATE_ALARM: strcat(status, "Alarm"); break;
-    case STATE_CHECK_MODE: strcat(status, "Check"); break;
+    case STATE_JOG: p = print_append_string(p, "Jog"); break;
+    case STATE_HOMING: p = print_append_string(p, "Home"); break;
+    case STATE_ALARM: p = print_append_string(p, "Alarm"); break;
+    case STATE_CHECK_MODE: p = print_append_string(p, "Check"); break;
     case STATE_SAFETY_DOOR:
-      strcat(status, "Door:");
-      if (sys.suspend & SUSPEND_INITIATE_RESTORE) {
-        strcat(status, "3"); // Restoring
+      p = print_append_string(p, "Door:");
+      if (snap.suspend & SUSPEND_INITIATE_RESTORE) {
+        *p++ = '3'; // Restoring
       } else {
-        if (sys.suspend & SUSPEND_RETRACT_COMPLETE) {
-          if (sys.suspend & SUSPEND_SAFETY_DOOR_AJAR) {
-            strcat(status, "1"); // Door ajar
+        if (snap.suspend & SUSPEND_RETRACT_COMPLETE) {
+          if (snap.suspend & SUSPEND_SAFETY_DOOR_AJAR) {
+            *p++ = '1'; // Door ajar
           } else {
-            strcat(status, "0");
+            *p++ = '0';
           } // Door closed and ready to resume
         } else {
-          strcat(status, "2"); // Retracting
+          *p++ = '2'; // Retracting
         }
       }
       break;
-    case STATE_SLEEP: strcat(status, "Sleep"); break;
-  }
-
-  float wco[N_AXIS];
-  if (bit_isfalse(settings.status_report_mask,BITFLAG_RT_STATUS_POSITION_TYPE) ||
-      (sys.report_wco_counter == 0) ) {
-    for (idx=0; idx< N_AXIS; idx++) {
-      // Apply work coordinate offsets and tool length offset to current position.
-      wco[idx] = gc_state.coord_system[idx]+gc_state.coord_offset[idx];
-      if (idx == TOOL_LENGTH_OFFSET_AXIS) { wco[idx] += gc_state.tool_length_offset; }
-      if (bit_isfalse(settings.status_report_mask,BITFLAG_RT_STATUS_POSITION_TYPE)) {
-        print_position[idx] -= wco[idx];
-      }
-    }
+    case STATE_SLEEP: p = print_append_string(p, "Sleep"); break;
   }
 
   // Report machine position
   if (bit_istrue(settings.status_report_mask,BITFLAG_RT_STATUS_POSITION_TYPE)) {
-    strcat(status, "|MPos:");
+    p = print_append_string(p, "|MPos:");
   } else {
+    for (idx=0; idx< N_AXIS; idx++) { print_position[idx] -= snap.wco[idx]; }
 	#ifdef FWD_KINEMATICS_REPORTING
 		forward_kinematics(print_position);
 	#endif
-    strcat(status, "|WPos:");
+    p = print_append_string(p, "|WPos:");
   }
-  
-  
-  report_util_axis_values(print_position, temp);
-	strcat(status, temp);
+  p = report_util_append_axis_values(p, print_position);
 
   // Returns planner and serial read buffer states.
 #ifdef REPORT_FIELD_BUFFER_STATE
@@ -715,21 +753,19 @@ void report_realtime_status(uint8_t client)
         if (client == CLIENT_SERIAL){
             bufsize = serial_get_rx_buffer_available(CLIENT_SERIAL);
         }
-			sprintf(temp, "|Bf:%d,%d", plan_get_block_buffer_available(), bufsize);
-			strcat(status, temp);
+			p = print_append_string(p, "|Bf:");
+			p = print_append_uint32(p, snap.planner_blocks_available);
+			*p++ = ',';
+			p = print_append_int32(p, bufsize);
     }
 #endif
 
   #ifdef USE_LINE_NUMBERS
     #ifdef REPORT_FIELD_LINE_NUMBERS
       // Report current line number
-      plan_block_t * cur_block = plan_get_current_block();
-      if (cur_block != NULL) {
-        uint32_t ln = cur_block->line_number;
-        if (ln > 0) {
-					sprintf(temp, "|Ln:%d", ln);
-					strcat(status, temp);
-        }
+      if (snap.line_number > 0) {
+        p = print_append_string(p, "|Ln:");
+        p = print_append_int32(p, snap.line_number);
       }
     #endif
   #endif
@@ -737,19 +773,23 @@ void report_realtime_status(uint8_t client)
   // Report realtime feed speed
   #ifdef REPORT_FIELD_CURRENT_FEED_SPEED
     #ifdef VARIABLE_SPINDLE
+			p = print_append_string(p, "|FS:");
 			if (bit_istrue(settings.flags,BITFLAG_REPORT_INCHES)) {
-				sprintf(temp, "|FS:%.1f,%.0f", st_get_realtime_rate(), sys.spindle_speed / MM_PER_INCH);
+				p = print_append_float(p, snap.feed_rate, N_DECIMAL_RATEVALUE_INCH);
+				*p++ = ',';
+				p = print_append_float(p, snap.spindle_speed / MM_PER_INCH, N_DECIMAL_RPMVALUE);
 			} else {
-				sprintf(temp, "|FS:%.0f,%.0f", st_get_realtime_rate(), sys.spindle_speed);
-			}			
-			strcat(status, temp);
+				p = print_append_float(p, snap.feed_rate, N_DECIMAL_RATEVALUE_MM);
+				*p++ = ',';
+				p = print_append_float(p, snap.spindle_speed, N_DECIMAL_RPMVALUE);
+			}
     #else
+			p = print_append_string(p, "|F:");
 			if (bit_istrue(settings.flags,BITFLAG_REPORT_INCHES)) {
-				sprintf(temp, "|F:%.1f", st_get_realtime_rate() / MM_PER_INCH);
+				p = print_append_float(p, snap.feed_rate / MM_PER_INCH, N_DECIMAL_RATEVALUE_INCH);
 			} else {
-				sprintf(temp, "|F:%.0f", st_get_realtime_rate());
+				p = print_append_float(p, snap.feed_rate, N_DECIMAL_RATEVALUE_MM);
 			}
-			strcat(status, temp);
     #endif      
   #endif
 
@@ -758,29 +798,29 @@ void report_realtime_status(uint8_t client)
     uint8_t ctrl_pin_state = system_control_get_state();
     uint8_t prb_pin_state = probe_get_state();
     if (lim_pin_state | ctrl_pin_state | prb_pin_state) {      
-			strcat(status, "|Pn:");
-      if (prb_pin_state) { strcat(status, "P"); }
+      p = print_append_string(p, "|Pn:");
+      if (prb_pin_state) { *p++ = 'P'; }
       if (lim_pin_state) {
-        if (bit_istrue(lim_pin_state,bit(X_AXIS))) { strcat(status, "X"); }
-        if (bit_istrue(lim_pin_state,bit(Y_AXIS))) { strcat(status, "Y"); }
-        if (bit_istrue(lim_pin_state,bit(Z_AXIS))) { strcat(status, "Z"); }
+        if (bit_istrue(lim_pin_state,bit(X_AXIS))) { *p++ = 'X'; }
+        if (bit_istrue(lim_pin_state,bit(Y_AXIS))) { *p++ = 'Y'; }
+        if (bit_istrue(lim_pin_state,bit(Z_AXIS))) { *p++ = 'Z'; }
         #if (N_AXIS > A_AXIS)
-         if (bit_istrue(lim_pin_state,bit(A_AXIS))) { strcat(status, "A"); }
+         if (bit_istrue(lim_pin_state,bit(A_AXIS))) { *p++ = 'A'; }
         #endif
         #if (N_AXIS > B_AXIS)
-         if (bit_istrue(lim_pin_state,bit(B_AXIS))) { strcat(status, "B"); }
+         if (bit_istrue(lim_pin_state,bit(B_AXIS))) { *p++ = 'B'; }
         #endif
         #if (N_AXIS > C_AXIS)
-         if (bit_istrue(lim_pin_state,bit(C_AXIS))) { strcat(status, "C"); }
+         if (bit_istrue(lim_pin_state,bit(C_AXIS))) { *p++ = 'C'; }
         #endif
       }
       if (ctrl_pin_state) {
         #ifdef ENABLE_SAFETY_DOOR_INPUT_PIN
-          if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_SAFETY_DOOR)) { strcat(status, "D"); }
+          if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_SAFETY_DOOR)) { *p++ = 'D'; }
         #endif
-        if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_RESET)) { strcat(status, "R"); }
-        if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_FEED_HOLD)) { strcat(status, "H"); }
-        if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_CYCLE_START)) { strcat(status, "S"); }
+        if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_RESET)) { *p++ = 'R'; }
+        if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_FEED_HOLD)) { *p++ = 'H'; }
+        if (bit_istrue(ctrl_pin_state,CONTROL_PIN_INDEX_CYCLE_START)) { *p++ = 'S'; }
       }
     }
   #endif
@@ -788,46 +828,49 @@ void report_realtime_status(uint8_t client)
   #ifdef REPORT_FIELD_WORK_COORD_OFFSET
     if (sys.report_wco_counter > 0) { sys.report_wco_counter--; }
     else {
-      if (sys.state & (STATE_HOMING | STATE_CYCLE | STATE_HOLD | STATE_JOG | STATE_SAFETY_DOOR)) {
+      if (snap.state & (STATE_HOMING | STATE_CYCLE | STATE_HOLD | STATE_JOG | STATE_SAFETY_DOOR)) {
         sys.report_wco_counter = (REPORT_WCO_REFRESH_BUSY_COUNT-1); // Reset counter for slow refresh
       } else { sys.report_wco_counter = (REPORT_WCO_REFRESH_IDLE_COUNT-1); }
       if (sys.report_ovr_counter == 0) { sys.report_ovr_counter = 1; } // Set override on next report.
-      strcat(status, "|WCO:");
-      report_util_axis_values(wco, temp);
-	  strcat(status, temp);
+      p = print_append_string(p, "|WCO:");
+      p = report_util_append_axis_values(p, snap.wco);
     }
   #endif
 
   #ifdef REPORT_FIELD_OVERRIDES
     if (sys.report_ovr_counter > 0) { sys.report_ovr_counter--; }
     else {
-      if (sys.state & (STATE_HOMING | STATE_CYCLE | STATE_HOLD | STATE_JOG | STATE_SAFETY_DOOR)) {
+      if (snap.state & (STATE_HOMING | STATE_CYCLE | STATE_HOLD | STATE_JOG | STATE_SAFETY_DOOR)) {
         sys.report_ovr_counter = (REPORT_OVR_REFRESH_BUSY_COUNT-1); // Reset counter for slow refresh
       } else { sys.report_ovr_counter = (REPORT_OVR_REFRESH_IDLE_COUNT-1); }      
-			
-		sprintf(temp, "|Ov:%d,%d,%d", sys.f_override, sys.r_override, sys.spindle_speed_ovr);
-		strcat(status, temp);      
 
-      uint8_t sp_state = spindle_get_state();
-      uint8_t cl_state = coolant_get_state();
+      p = print_append_string(p, "|Ov:");
+      p = print_append_uint32(p, snap.f_override);
+      *p++ = ',';
+      p = print_append_uint32(p, snap.r_override);
+      *p++ = ',';
+      p = print_append_uint32(p, snap.spindle_speed_ovr);
+
+      uint8_t sp_state = snap.spindle_state;
+      uint8_t cl_state = snap.coolant_state;
       if (sp_state || cl_state) {
-        strcat(status, "|A:");
+        p = print_append_string(p, "|A:");
         if (sp_state) { // != SPINDLE_STATE_DISABLE
           #ifdef VARIABLE_SPINDLE 
             #ifdef USE_SPINDLE_DIR_AS_ENABLE_PIN
-              strcat(status, "S"); // CW
+              *p++ = 'S'; // CW
             #else
-              if (sp_state == SPINDLE_STATE_CW) { strcat(status, "S"); } // CW
-              else { strcat(status, "C"); } // CCW
+              if (sp_state == SPINDLE_STATE_CW) { *p++ = 'S'; } // CW
+              else { *p++ = 'C'; } // CCW
             #endif
           #else
-            if (sp_state & SPINDLE_STATE_CW) { strcat(status, "S"); } // CW
-            else { strcat(status, "C"); } // CCW
+            if (sp_state & SPINDLE_STATE_CW) { *p++ = 'S'; } // CW
+            else { *p++ = 'C'; } // CCW
           #endif
         }
-        if (cl_state & COOLANT_STATE_FLOOD) { strcat(status, "F"); }
+        if (cl_state & COOLANT_STATE_FLOOD) { *p++ = 'F'; }
         #ifdef COOLANT_MIST_PIN // TODO Deal with M8 - Flood
-          if (cl_state & COOLANT_STATE_MIST) { strcat(status, "M"); }
+          if (cl_state & COOLANT_STATE_MIST) { *p++ = 'M'; }
         #endif
       }  
     }
@@ -835,15 +878,16 @@ void report_realtime_status(uint8_t client)
 	
 	#ifdef ENABLE_SD_CARD
 		if (get_sd_state(false) == SDCARD_BUSY_PRINTING) {
-			sprintf(temp, "|SD:%4.2f,", sd_report_perc_complete());
-			strcat(status, temp);
-			
-			sd_get_current_filename(temp);
-			strcat(status, temp);
+			p = print_append_string(p, "|SD:");
+			p = print_append_float(p, sd_report_perc_complete(), 2);
+			*p++ = ',';
+			// The name goes straight into the report, cut short to leave room for ">\r\n".
+			sd_get_current_filename(p, status + REPORT_STATUS_BUFFER_SIZE - 4 - p);
+			p += strlen(p);
 		}
 	#endif
 
-  strcat(status, ">\r\n");
+  p = print_append_string(p, ">\r\n");
 	
 	grbl_send(client, status);
 }
@@ -857,17 +901,76 @@ void report_realtime_steps()
 }
 
 void report_gcode_comment(char *comment) {
-	char msg[80];
 	const uint8_t offset = 4;  // ignore "MSG_" part of comment
-	uint8_t index = offset; 
 	
 	if (strstr(comment, "MSG")) {
-		while(index < strlen(comment)) {
-			msg[index-offset] = comment[index];
-			index++;
-		}
-		msg[index-offset] = 0; // null terminate
-		
-		grbl_sendf(CLIENT_ALL, "[MSG:GCode Comment %s]\r\n",msg);
+		char text[REPORT_MESSAGE_SIZE];
+		char *p = print_append_string(text, "[MSG:GCode Comment ");
+		if (strlen(comment) > offset) { p = report_util_append_text(p, comment+offset, text+sizeof(text)-4); }
+		print_append_string(p, "]\r\n");
+		grbl_send(CLIENT_ALL, text);
 	}	
 }
+
+#ifdef STEPPER_ISR_PROFILE
+static float profile_usec(uint32_t cycles)
+{
+	return (cycles/(F_CPU/1000000.0f));
+}
+
+static void report_profile_hist(uint8_t client, const char *name, uint8_t level, profile_hist_t *hist)
+{
+	if (hist->count == 0) {
+		return;
+	}
+	grbl_sendf(client, "[PRF:%s L%d n=%lu min=%4.2f p99=%4.2f max=%4.2f us]\r\n", name, level, (unsigned long)hist->count,
+	           profile_usec(hist->min), profile_usec(st_profile_percentile(hist, 99)), profile_usec(hist->max));
+}
+
+void report_stepper_profile(uint8_t client)
+{
+	// The profile is about 2.5KB, too much for the stack of the task calling this.
+	static stepper_profile_t profile;
+	st_profile_snapshot(&profile);
+
+	for (uint8_t level = 0; level <= MAX_AMASS_LEVEL; level++) {
+		report_profile_hist(client, "ISR", level, &profile.duration[level]);
+	}
+	for (uint8_t level = 0; level <= MAX_AMASS_LEVEL; level++) {
+		report_profile_hist(client, "JIT", level, &profile.jitter[level]);
+	}
+
+	// Oldest segment first
+	uint8_t idx = (profile.segment_count < PROFILE_SEGMENT_LOG) ? 0 : profile.segment_head;
+	for (uint8_t n = 0; n < profile.segment_count; n++) {
+		profile_segment_t *segment = &profile.segment[idx];
+		grbl_sendf(client, "[PRF:SEG steps=%d period=%d L%d isr=%4.2f jit=%4.2f us]\r\n", segment->n_step,
+		           segment->cycles_per_tick, segment->amass_level, profile_usec(segment->isr_max),
+		           profile_usec(segment->jitter_max));
+		if (++idx == PROFILE_SEGMENT_LOG) {
+			idx = 0;
+		}
+	}
+}
+#endif
+
+#ifdef SPINDLE_PWM_TRACE
+void report_spindle_pwm_trace(uint8_t client)
+{
+	static spindle_pwm_trace_t trace; // Too big for the stack of the task calling this
+	spindle_pwm_trace_snapshot(&trace);
+
+	// Oldest write first, with its time from the one before
+	uint16_t idx = (trace.count < SPINDLE_PWM_TRACE_SIZE) ? 0 : trace.head;
+	uint32_t last = trace.entry[idx].time;
+	for (uint16_t n = 0; n < trace.count; n++) {
+		spindle_pwm_trace_entry_t *entry = &trace.entry[idx];
+		grbl_sendf(client, "[PWM:t=%lu dt=%lu ch=%d duty=%lu]\r\n", (unsigned long)entry->time, (unsigned long)(entry->time - last),
+		           entry->channel, (unsigned long)entry->duty);
+		last = entry->time;
+		if (++idx == SPINDLE_PWM_TRACE_SIZE) {
+			idx = 0;
+		}
+	}
+}
+#endif
@@ -63,12 +63,17 @@
 #define STATUS_GCODE_G43_DYNAMIC_AXIS_ERROR 37
 #define STATUS_GCODE_MAX_VALUE_EXCEEDED 38
 #define STATUS_P_PARAM_MAX_EXCEEDED 39
+#define STATUS_NOT_JOB_OWNER 40 // G-code from a client while another client's job runs. Only with ENABLE_JOB_OWNERSHIP.
+#define STATUS_RASTER_INVALID 41 // D pixels outside laser mode or a G1 move, see LASER_RASTER
+#define STATUS_RASTER_TOO_LONG 42 // More D pixels than GC_RASTER_MAX_PIXELS or than fit the line
 
 #define STATUS_SD_FAILED_MOUNT 60 // SD Failed to mount
 #define STATUS_SD_FAILED_READ 61 // SD Failed to read file
 #define STATUS_SD_FAILED_OPEN_DIR 62 // SD card failed to open directory
 #define STATUS_SD_DIR_NOT_FOUND 63 // SD Card directory not found
 #define STATUS_SD_FILE_EMPTY 64 // SD Card directory not found
+#define STATUS_SD_FAILED_WRITE 65 // SD Failed to write file
+#define STATUS_SD_RESUME_OFFSET 66 // SD job can't resume where a G92 offset is active
 
 #define STATUS_BT_FAIL_BEGIN 70  // Bluetooth failed to start
 
@@ -104,13 +109,22 @@
 #define CLIENT_WEBUI		3
 #define CLIENT_TELNET		4
 #define CLIENT_INPUT        5
+#define CLIENT_GUI          6
 #define CLIENT_ALL			0xFF
-#define CLIENT_COUNT    	5 // total number of client types regardless if they are used
+#define CLIENT_COUNT    	6 // total number of client types regardless if they are used
+
+// Longest message grbl_sendf() and grbl_notifyf() format, and the buffer the fixed reports are
+// built in. Messages are formatted once on the caller's stack, never on the heap, and longer
+// ones are cut short.
+#define REPORT_MESSAGE_SIZE 256
 
 // functions to send data to the user.
 void grbl_send(uint8_t client, const char *text);
 void grbl_sendf(uint8_t client, const char *format, ...);
 
+// Queues text for the touch screen terminal. Defined with the GUI.
+void gui_send(const char *text);
+
 //function to notify
 void grbl_notify(const char *title, const char *msg);
 void grbl_notifyf(const char *title, const char *format, ...);
@@ -137,6 +151,30 @@ void report_grbl_settings(uint8_t client);
 // Prints an echo of the pre-parsed line received right before execution.
 void report_echo_line_received(char *line, uint8_t client);
 
+// Machine state copied by the main loop for the realtime status report
+typedef struct {
+  uint8_t state;
+  uint8_t suspend;
+  int32_t position[N_AXIS];         // Machine position in steps
+  float wco[N_AXIS];                // Work coordinate offset, including tool length offset
+  uint16_t planner_blocks_available;
+  int32_t line_number;              // Line number of the executing block. 0 when none.
+  float feed_rate;                  // Realtime rate (mm/min)
+  float spindle_speed;
+  uint8_t f_override;
+  uint8_t r_override;
+  uint8_t spindle_speed_ovr;
+  uint8_t spindle_state;
+  uint8_t coolant_state;
+} report_status_snapshot_t;
+
+// Longest realtime status report, including all optional fields. A long SD file name is cut short.
+#define REPORT_STATUS_BUFFER_SIZE 256
+
+// Publishes the status snapshot. Called only from the main loop.
+void report_status_publish();
+void report_status_snapshot(report_status_snapshot_t *copy);
+
 // Prints realtime status report
 void report_realtime_status(uint8_t client);
 
@@ -158,6 +196,16 @@ void report_build_info(char *line, uint8_t client);
 
 void report_gcode_comment(char *comment);
 
+#ifdef STEPPER_ISR_PROFILE
+  // Prints the stepper ISR time and jitter histograms and the recent segment log.
+  void report_stepper_profile(uint8_t client);
+#endif
+
+#ifdef SPINDLE_PWM_TRACE
+  // Prints the most recent spindle PWM writes, oldest first.
+  void report_spindle_pwm_trace(uint8_t client);
+#endif
+
 #ifdef DEBUG
   void report_realtime_debug();
 #endif
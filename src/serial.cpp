@@ -22,29 +22,325 @@
 #include "commands.h"
 
 #define RX_RING_BUFFER (RX_BUFFER_SIZE+1)
-#define TX_RING_BUFFER (TX_BUFFER_SIZE+1)
 
-portMUX_TYPE myMutex = portMUX_INITIALIZER_UNLOCKED;
+// One receive ring per client. Each is a single producer, single consumer queue: serialCheckTask
+// (core 0) is the only writer of head, or the GUI task for the GUI's ring, and the protocol loop
+// (core 1) the only writer of tail, so neither side needs a lock. The data is written before head is published with release order,
+// and read before tail is published, which is all the other core needs to see a consistent ring.
+typedef struct {
+	uint8_t buffer[RX_RING_BUFFER];
+	volatile uint16_t head; // Next slot to write. Owned by the producer.
+	volatile uint16_t tail; // Next slot to read. Owned by the consumer.
+} serial_rx_ring_t;
 
-uint8_t serial_rx_buffer[CLIENT_COUNT][RX_RING_BUFFER];
-uint8_t serial_rx_buffer_head[CLIENT_COUNT] = {0};
-volatile uint8_t serial_rx_buffer_tail[CLIENT_COUNT] = {0};
+static serial_rx_ring_t serial_rx_ring[CLIENT_COUNT];
+
+// One transmit ring per output sink, written by whatever task calls grbl_send() and read by the
+// sink's own serialTxTask. The ring holds records: a length byte and the text.
+// Producers are many, so the rings are only touched under serial_tx_mux, and only to copy a
+// record in or out. The writes to the sink happen outside of it.
+#define TX_RECORD_HEADER 1
+#define TX_RECORD_MAX 255 // Longer text is split. A status report always fits in one record.
+
+typedef struct {
+	uint8_t client;
+	TaskHandle_t task;
+	uint8_t buffer[TX_BUFFER_SIZE];
+	uint16_t head; // Where the next record goes
+	uint16_t tail; // Oldest record
+	uint16_t used;
+	uint32_t full_since; // millis() when a producer found the ring full, 0 while the sink keeps up
+	#if TX_OVERFLOW_POLICY == TX_OVERFLOW_COALESCE
+		// The latest status report. It goes out next, ahead of the ring, as real-time output should.
+		// A newer one replaces it while it waits, so only the freshest state reaches a slow peer.
+		uint8_t status[TX_RECORD_MAX];
+		uint8_t status_len;
+	#endif
+	// Owned by the task: the record being written to the sink
+	uint8_t pending[TX_RECORD_MAX];
+	uint8_t pending_len;
+	uint8_t pending_pos;
+} serial_tx_ring_t;
+
+static const uint8_t serial_tx_clients[] = {
+	CLIENT_SERIAL,
+	#ifdef ENABLE_BLUETOOTH
+		CLIENT_BT,
+	#endif
+	#if defined (ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_OUT)
+		CLIENT_WEBUI,
+	#endif
+	#if defined (ENABLE_WIFI) && defined(ENABLE_TELNET)
+		CLIENT_TELNET,
+	#endif
+};
+#define TX_SINKS (sizeof(serial_tx_clients)/sizeof(serial_tx_clients[0]))
+
+static serial_tx_ring_t serial_tx_ring[TX_SINKS];
+static portMUX_TYPE serial_tx_mux = portMUX_INITIALIZER_UNLOCKED;
 static TaskHandle_t serialCheckTaskHandle = 0;
 
+static serial_rx_ring_t *serial_rx_ring_get(uint8_t client)
+{
+	if ((client < 1) || (client > CLIENT_COUNT)) { return(NULL); }
+	return(&serial_rx_ring[client-1]);
+}
+
 // Returns the number of bytes available in the RX serial buffer.
-uint8_t serial_get_rx_buffer_available(uint8_t client)
+uint16_t serial_get_rx_buffer_available(uint8_t client)
 {
-	uint8_t client_idx = client - 1;
-	
-  uint8_t rtail = serial_rx_buffer_tail[client_idx]; // Copy to limit multiple calls to volatile
-  if (serial_rx_buffer_head[client_idx] >= rtail) { return(RX_BUFFER_SIZE - (serial_rx_buffer_head[client_idx]-rtail)); }
-  return((rtail-serial_rx_buffer_head[client_idx]-1));
+	serial_rx_ring_t *ring = serial_rx_ring_get(client);
+	if (ring == NULL) { return(0); }
+
+	uint16_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	uint16_t tail = ring->tail;
+	if (head >= tail) { return(RX_BUFFER_SIZE - (head-tail)); }
+	return((tail-head-1));
+}
+
+// Copies up to len bytes into the client's ring and returns the number stored. Whatever does
+// not fit is dropped, as the senders are expected to track the buffer space. Producer side only.
+uint16_t serial_rx_write(uint8_t client, const uint8_t *data, uint16_t len)
+{
+	serial_rx_ring_t *ring = serial_rx_ring_get(client);
+	if (ring == NULL) { return(0); }
+
+	uint16_t head = ring->head;
+	uint16_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+	uint16_t space = (tail > head) ? (tail-head-1) : (RX_BUFFER_SIZE-(head-tail));
+	if (len > space) { len = space; }
+
+	uint16_t first = MIN(len, RX_RING_BUFFER-head); // Bytes before the end of the array
+	memcpy(&ring->buffer[head], data, first);
+	memcpy(ring->buffer, data+first, len-first);
+	head += len;
+	if (head >= RX_RING_BUFFER) { head -= RX_RING_BUFFER; }
+	__atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+	return(len);
+}
+
+// Copies up to len bytes out of the client's ring and returns the number read. Consumer side only.
+uint16_t serial_read_bytes(uint8_t client, uint8_t *data, uint16_t len)
+{
+	serial_rx_ring_t *ring = serial_rx_ring_get(client);
+	if (ring == NULL) { return(0); }
+
+	uint16_t tail = ring->tail;
+	uint16_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+	uint16_t count = (head >= tail) ? (head-tail) : (RX_RING_BUFFER-(tail-head));
+	if (len > count) { len = count; }
+
+	uint16_t first = MIN(len, RX_RING_BUFFER-tail);
+	memcpy(data, &ring->buffer[tail], first);
+	memcpy(data+first, ring->buffer, len-first);
+	tail += len;
+	if (tail >= RX_RING_BUFFER) { tail -= RX_RING_BUFFER; }
+	__atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+	return(len);
+}
+
+// Producer side only. A line is queued completely or not at all, so a full ring never leaves a
+// partial line for the protocol loop to join with the next one.
+bool serial_queue_line(uint8_t client, const char *line)
+{
+	uint16_t len = strlen(line);
+	if (serial_get_rx_buffer_available(client) < (len+1)) { return(false); }
+	serial_rx_write(client, (const uint8_t *)line, len);
+	serial_rx_write(client, (const uint8_t *)"\n", 1);
+	return(true);
+}
+
+// Copies len bytes into the ring at pos, wrapping at the end, and returns the position after them.
+static uint16_t serial_tx_copy_in(serial_tx_ring_t *ring, uint16_t pos, const uint8_t *data, uint16_t len)
+{
+	uint16_t first = MIN(len, TX_BUFFER_SIZE-pos);
+	memcpy(&ring->buffer[pos], data, first);
+	memcpy(ring->buffer, data+first, len-first);
+	pos += len;
+	return((pos >= TX_BUFFER_SIZE) ? (pos-TX_BUFFER_SIZE) : pos);
+}
+
+static uint16_t serial_tx_copy_out(serial_tx_ring_t *ring, uint16_t pos, uint8_t *data, uint16_t len)
+{
+	uint16_t first = MIN(len, TX_BUFFER_SIZE-pos);
+	memcpy(data, &ring->buffer[pos], first);
+	memcpy(data+first, ring->buffer, len-first);
+	pos += len;
+	return((pos >= TX_BUFFER_SIZE) ? (pos-TX_BUFFER_SIZE) : pos);
+}
+
+// Removes the oldest record. Called under serial_tx_mux.
+static void serial_tx_drop_oldest(serial_tx_ring_t *ring)
+{
+	uint16_t size = TX_RECORD_HEADER+ring->buffer[ring->tail];
+	ring->tail += size;
+	if (ring->tail >= TX_BUFFER_SIZE) { ring->tail -= TX_BUFFER_SIZE; }
+	ring->used -= size;
+}
+
+// Queues one record. When it does not fit, returns false for the caller to give the sink time,
+// unless the sink has made no room for TX_STALL_MS or the caller can't wait. Then the oldest
+// records make room, or with TX_OVERFLOW_BLOCK only when the caller can't wait.
+static bool serial_tx_put(serial_tx_ring_t *ring, const uint8_t *data, uint8_t len, bool may_wait)
+{
+	uint16_t size = TX_RECORD_HEADER+len;
+	uint32_t now = millis() | 1; // full_since is 0 while the sink keeps up
+	portENTER_CRITICAL(&serial_tx_mux);
+	if ((ring->used+size) > TX_BUFFER_SIZE) {
+		if (ring->full_since == 0) { ring->full_since = now; }
+		#if TX_OVERFLOW_POLICY != TX_OVERFLOW_BLOCK
+			if ((now-ring->full_since) >= TX_STALL_MS) { may_wait = false; }
+		#endif
+		if (may_wait) {
+			portEXIT_CRITICAL(&serial_tx_mux);
+			return(false);
+		}
+		while ((ring->used+size) > TX_BUFFER_SIZE) { serial_tx_drop_oldest(ring); }
+	}
+	ring->head = serial_tx_copy_in(ring, ring->head, &len, TX_RECORD_HEADER);
+	ring->head = serial_tx_copy_in(ring, ring->head, data, len);
+	ring->used += size;
+	portEXIT_CRITICAL(&serial_tx_mux);
+	return(true);
+}
+
+void serial_send(uint8_t client, const char *text)
+{
+	size_t len = strlen(text);
+	if (len == 0) { return; }
+	// A sink task sending (through a library callback) must not wait for a ring, maybe its own.
+	TaskHandle_t self = xTaskGetCurrentTaskHandle();
+	bool may_wait = true;
+	for (uint8_t idx = 0; idx < TX_SINKS; idx++) {
+		if ((serial_tx_ring[idx].task == 0) || (serial_tx_ring[idx].task == self)) { may_wait = false; }
+	}
+
+	for (uint8_t idx = 0; idx < TX_SINKS; idx++) {
+		if ((client != serial_tx_clients[idx]) && (client != CLIENT_ALL)) { continue; }
+		#ifdef ENABLE_BLUETOOTH
+			if ((serial_tx_clients[idx] == CLIENT_BT) && !SerialBT.hasClient()) { continue; }
+		#endif
+		serial_tx_ring_t *ring = &serial_tx_ring[idx];
+		#if TX_OVERFLOW_POLICY == TX_OVERFLOW_COALESCE
+			if ((text[0] == '<') && (len <= TX_RECORD_MAX)) {
+				portENTER_CRITICAL(&serial_tx_mux);
+				memcpy(ring->status, text, len);
+				ring->status_len = len;
+				portEXIT_CRITICAL(&serial_tx_mux);
+				if (ring->task != 0) { xTaskNotifyGive(ring->task); }
+				continue;
+			}
+		#endif
+		const uint8_t *data = (const uint8_t *)text;
+		size_t left = len;
+		while (left) {
+			uint8_t size = MIN(left, TX_RECORD_MAX);
+			if (serial_tx_put(ring, data, size, may_wait)) {
+				data += size;
+				left -= size;
+			} else {
+				xTaskNotifyGive(ring->task);
+				vTaskDelay(1); // The sink is still taking data
+			}
+		}
+		if (ring->task != 0) { xTaskNotifyGive(ring->task); }
+	}
+}
+
+// Writes what the sink takes right now and returns how much that was.
+static size_t serial_tx_write(uint8_t client, const uint8_t *data, size_t len)
+{
+	switch (client) {
+		case CLIENT_SERIAL:
+			len = MIN(len, (size_t)MAX(Serial.availableForWrite(), 0)); // Never spin on a full UART FIFO
+			return((len > 0) ? Serial.write(data, len) : 0);
+		#ifdef ENABLE_BLUETOOTH
+			case CLIENT_BT:
+				if (SerialBT.hasClient()) { SerialBT.write(data, len); }
+				break;
+		#endif
+		#if defined (ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_OUT)
+			case CLIENT_WEBUI:
+				Serial2Socket.write(data, len);
+				break;
+		#endif
+		#if defined (ENABLE_WIFI) && defined(ENABLE_TELNET)
+			case CLIENT_TELNET:
+				telnet_server.write(data, len);
+				break;
+		#endif
+	}
+	return(len);
+}
+
+// Writes one sink's ring to it, at whatever pace the sink takes it. A slow or stalled peer only
+// holds up this task.
+static void serialTxTask(void *pvParameters)
+{
+	serial_tx_ring_t *ring = (serial_tx_ring_t *)pvParameters;
+	uint8_t client = serial_tx_clients[ring-serial_tx_ring];
+	while (true) {
+		if (ring->pending_pos == ring->pending_len) {
+			ring->pending_pos = 0;
+			ring->pending_len = 0;
+			portENTER_CRITICAL(&serial_tx_mux);
+			#if TX_OVERFLOW_POLICY == TX_OVERFLOW_COALESCE
+				if (ring->status_len > 0) {
+					memcpy(ring->pending, ring->status, ring->status_len);
+					ring->pending_len = ring->status_len;
+					ring->status_len = 0;
+				}
+			#endif
+			if ((ring->pending_len == 0) && (ring->used > 0)) {
+				uint8_t len;
+				uint16_t pos = serial_tx_copy_out(ring, ring->tail, &len, TX_RECORD_HEADER);
+				ring->tail = serial_tx_copy_out(ring, pos, ring->pending, len);
+				ring->pending_len = len;
+				ring->used -= TX_RECORD_HEADER+len;
+				ring->full_since = 0;
+			}
+			portEXIT_CRITICAL(&serial_tx_mux);
+			if (ring->pending_len == 0) {
+				ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // Until serial_send() queues more
+				continue;
+			}
+		}
+		size_t len = serial_tx_write(client, ring->pending+ring->pending_pos, ring->pending_len-ring->pending_pos);
+		if (len > 0) {
+			ring->pending_pos += len;
+		} else {
+			vTaskDelay(1); // The sink is full
+		}
+	}
+}
+
+void serial_tx_flush(uint32_t timeout_ms)
+{
+	uint32_t start = millis();
+	for (uint8_t idx = 0; idx < TX_SINKS; idx++) {
+		serial_tx_ring_t *ring = &serial_tx_ring[idx];
+		while ((ring->task != 0) && (ring->used || (ring->pending_pos != ring->pending_len)) &&
+		       ((millis()-start) < timeout_ms)) { // A status report left in its slot does not matter
+			vTaskDelay(1);
+		}
+	}
 }
 
 void serial_init()
 {
 	Serial.begin(BAUD_RATE);	
 	grbl_send(CLIENT_SERIAL,"\r\n"); // create some white space after ESP32 boot info
+	// one task per output sink, each writes its TX ring to the sink
+	for (uint8_t idx = 0; idx < TX_SINKS; idx++) {
+		xTaskCreatePinnedToCore(	serialTxTask,    // task
+														"serialTxTask", // name for task
+														3072,   // size of task stack
+														&serial_tx_ring[idx],   // parameters
+														1, // priority
+														&serial_tx_ring[idx].task,
+														0 // core
+														);
+	}
 	serialCheckTaskHandle = 0;
 	// create a task to check for incoming data
 	xTaskCreatePinnedToCore(	serialCheckTask,    // task
@@ -59,133 +355,123 @@ void serial_init()
 }
 
 
-// this task runs and checks for data on all interfaces
-// REaltime stuff is acted upon, then characters are added to the appropriate buffer
-void serialCheckTask(void *pvParameters)
+// Acts on a realtime command character. These are never passed into the receive rings, they set
+// system state flag bits for realtime execution instead. Returns false for ordinary line data.
+static bool serial_realtime_command(uint8_t data, uint8_t client)
 {
-  uint8_t data = 0;
-  uint8_t next_head;
-	uint8_t client = CLIENT_ALL; // who send the data
-	
-	uint8_t client_idx = 0;  // index of data buffer
-	
-	while(true) // run continuously
-	{ 		
-		while (Serial.available() || inputBuffer.available()
-		#ifdef ENABLE_BLUETOOTH 
-			 || (SerialBT.hasClient() && SerialBT.available())
+	switch (data) {
+		case CMD_RESET:
+			mc_reset();   // Call motion control reset routine.
+			//report_init_message(client); // fool senders into thinking a reset happened.
+			return(true);
+		case CMD_STATUS_REPORT: 
+			report_realtime_status(client); // direct call instead of setting flag
+			return(true);
+		case CMD_CYCLE_START:   system_set_exec_state_flag(EXEC_CYCLE_START); return(true); // Set as true
+		case CMD_FEED_HOLD:     system_set_exec_state_flag(EXEC_FEED_HOLD); return(true); // Set as true
+	}
+	if (data <= 0x7F) { return(false); } // Real-time control characters are extended ACSII only.
+
+	switch(data) {
+		case CMD_SAFETY_DOOR:   system_set_exec_state_flag(EXEC_SAFETY_DOOR); break; // Set as true
+		case CMD_JOG_CANCEL:   
+			if (sys.state & STATE_JOG) { // Block all other states from invoking motion cancel.
+				system_set_exec_state_flag(EXEC_MOTION_CANCEL); 
+			}
+			break; 
+		#ifdef DEBUG
+			case CMD_DEBUG_REPORT: {uint8_t sreg = SREG; cli(); bit_true(sys_rt_exec_debug,EXEC_DEBUG_REPORT); SREG = sreg;} break;
 		#endif
-        #if defined (ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_IN)
-			|| Serial2Socket.available()
+		case CMD_FEED_OVR_RESET: system_set_exec_motion_override_flag(EXEC_FEED_OVR_RESET); break;
+		case CMD_FEED_OVR_COARSE_PLUS: system_set_exec_motion_override_flag(EXEC_FEED_OVR_COARSE_PLUS); break;
+		case CMD_FEED_OVR_COARSE_MINUS: system_set_exec_motion_override_flag(EXEC_FEED_OVR_COARSE_MINUS); break;
+		case CMD_FEED_OVR_FINE_PLUS: system_set_exec_motion_override_flag(EXEC_FEED_OVR_FINE_PLUS); break;
+		case CMD_FEED_OVR_FINE_MINUS: system_set_exec_motion_override_flag(EXEC_FEED_OVR_FINE_MINUS); break;
+		case CMD_RAPID_OVR_RESET: system_set_exec_motion_override_flag(EXEC_RAPID_OVR_RESET); break;
+		case CMD_RAPID_OVR_MEDIUM: system_set_exec_motion_override_flag(EXEC_RAPID_OVR_MEDIUM); break;
+		case CMD_RAPID_OVR_LOW: system_set_exec_motion_override_flag(EXEC_RAPID_OVR_LOW); break;
+		case CMD_SPINDLE_OVR_RESET: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_RESET); break;
+		case CMD_SPINDLE_OVR_COARSE_PLUS: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_COARSE_PLUS); break;
+		case CMD_SPINDLE_OVR_COARSE_MINUS: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_COARSE_MINUS); break;
+		case CMD_SPINDLE_OVR_FINE_PLUS: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_FINE_PLUS); break;
+		case CMD_SPINDLE_OVR_FINE_MINUS: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_FINE_MINUS); break;
+		case CMD_SPINDLE_OVR_STOP: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_STOP); break;
+		#ifdef COOLANT_FLOOD_PIN
+		case CMD_COOLANT_FLOOD_OVR_TOGGLE: system_set_exec_accessory_override_flag(EXEC_COOLANT_FLOOD_OVR_TOGGLE); break;
 		#endif
-         #if defined (ENABLE_WIFI) && defined(ENABLE_TELNET)
-			|| telnet_server.available()
+		#ifdef COOLANT_MIST_PIN
+			case CMD_COOLANT_MIST_OVR_TOGGLE: system_set_exec_accessory_override_flag(EXEC_COOLANT_MIST_OVR_TOGGLE); break;
 		#endif
-            )
-		{			
-		  if (Serial.available())
-			{
-				client = CLIENT_SERIAL;
-				data = Serial.read();
+	}
+	// Throw away any unfound extended-ASCII character by not passing it to the serial buffer.
+	return(true);
+}
+
+// Acts on the realtime commands in a chunk read from a client and queues the rest for the
+// protocol loop. The line data is compacted in place, so it goes into the ring in one copy.
+static void serial_intake(uint8_t client, uint8_t *data, size_t len)
+{
+	size_t count = 0;
+	for (size_t idx = 0; idx < len; idx++) {
+		if (!serial_realtime_command(data[idx], client)) { data[count++] = data[idx]; }
+	}
+	if (count) { serial_rx_write(client, data, count); } // Write data to buffer unless it is full.
+}
+
+// Moves everything the clients have sent into the receive rings. Each source gives up to one
+// chunk per pass, so a busy stream can not hold back a realtime command from another client.
+static void serial_drain_sources()
+{
+	uint8_t chunk[SERIAL_INTAKE_CHUNK];
+	size_t len;
+	bool more = true;
+	while (more) {
+		more = false;
+		if ((len = MIN(Serial.available(), SERIAL_INTAKE_CHUNK)) > 0) {
+			len = Serial.readBytes(chunk, len);
+			serial_intake(CLIENT_SERIAL, chunk, len);
+			more = true;
+		}
+		if ((len = inputBuffer.read(chunk, SERIAL_INTAKE_CHUNK)) > 0) {
+			serial_intake(CLIENT_INPUT, chunk, len);
+			more = true;
+		}
+		#ifdef ENABLE_BLUETOOTH
+			if (SerialBT.hasClient() && ((len = MIN(SerialBT.available(), SERIAL_INTAKE_CHUNK)) > 0)) {
+				len = SerialBT.readBytes(chunk, len);
+				serial_intake(CLIENT_BT, chunk, len);
+				more = true;
+			}
+		#endif
+		#if defined (ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_IN)
+			if ((len = Serial2Socket.read(chunk, SERIAL_INTAKE_CHUNK)) > 0) {
+				serial_intake(CLIENT_WEBUI, chunk, len);
+				more = true;
 			}
-       else if (inputBuffer.available()){
-                client = CLIENT_INPUT;
-                data = inputBuffer.read();
-       }
-       else
-			{   //currently is wifi or BT but better to prepare both can be live
-				#ifdef ENABLE_BLUETOOTH
-                if(SerialBT.hasClient() && SerialBT.available()){
-                    client = CLIENT_BT;
-                    data = SerialBT.read();					
-                    //Serial.write(data);  // echo all data to serial
-                } else {		
-				#endif
-                #if defined (ENABLE_WIFI) && defined(ENABLE_HTTP)  && defined(ENABLE_SERIAL2SOCKET_IN)
-                if (Serial2Socket.available()) {
-                    client = CLIENT_WEBUI;
-                    data = Serial2Socket.read();
-                    }
-                    else
-                        {
-                #endif
-                #if defined (ENABLE_WIFI) && defined(ENABLE_TELNET)
-                    if(telnet_server.available()){
-                        client = CLIENT_TELNET;
-                        data = telnet_server.read();
-                    }
-                #endif
-                #if defined (ENABLE_WIFI) && defined(ENABLE_HTTP)  && defined(ENABLE_SERIAL2SOCKET_IN)
-                }
-                #endif
-                #ifdef ENABLE_BLUETOOTH
-                }
-                #endif
+		#endif
+		#if defined (ENABLE_WIFI) && defined(ENABLE_TELNET)
+			if ((len = telnet_server.read(chunk, SERIAL_INTAKE_CHUNK)) > 0) {
+				serial_intake(CLIENT_TELNET, chunk, len);
+				more = true;
 			}
-			
-			client_idx = client - 1;  // for zero based array 
-			
-			// Pick off realtime command characters directly from the serial stream. These characters are
-			// not passed into the main buffer, but these set system state flag bits for realtime execution.
-			switch (data) {
-				case CMD_RESET:
-					mc_reset();   // Call motion control reset routine.
-					//report_init_message(client); // fool senders into thinking a reset happened.
-					break; 
-				case CMD_STATUS_REPORT: 
-					report_realtime_status(client);
-					break; // direct call instead of setting flag
-				case CMD_CYCLE_START:   system_set_exec_state_flag(EXEC_CYCLE_START); break; // Set as true
-				case CMD_FEED_HOLD:     system_set_exec_state_flag(EXEC_FEED_HOLD); break; // Set as true
-				default :
-					if (data > 0x7F) { // Real-time control characters are extended ACSII only.
-						switch(data) {
-							case CMD_SAFETY_DOOR:   system_set_exec_state_flag(EXEC_SAFETY_DOOR); break; // Set as true
-							case CMD_JOG_CANCEL:   
-								if (sys.state & STATE_JOG) { // Block all other states from invoking motion cancel.
-									system_set_exec_state_flag(EXEC_MOTION_CANCEL); 
-								}
-								break; 
-							#ifdef DEBUG
-								case CMD_DEBUG_REPORT: {uint8_t sreg = SREG; cli(); bit_true(sys_rt_exec_debug,EXEC_DEBUG_REPORT); SREG = sreg;} break;
-							#endif
-							case CMD_FEED_OVR_RESET: system_set_exec_motion_override_flag(EXEC_FEED_OVR_RESET); break;
-							case CMD_FEED_OVR_COARSE_PLUS: system_set_exec_motion_override_flag(EXEC_FEED_OVR_COARSE_PLUS); break;
-							case CMD_FEED_OVR_COARSE_MINUS: system_set_exec_motion_override_flag(EXEC_FEED_OVR_COARSE_MINUS); break;
-							case CMD_FEED_OVR_FINE_PLUS: system_set_exec_motion_override_flag(EXEC_FEED_OVR_FINE_PLUS); break;
-							case CMD_FEED_OVR_FINE_MINUS: system_set_exec_motion_override_flag(EXEC_FEED_OVR_FINE_MINUS); break;
-							case CMD_RAPID_OVR_RESET: system_set_exec_motion_override_flag(EXEC_RAPID_OVR_RESET); break;
-							case CMD_RAPID_OVR_MEDIUM: system_set_exec_motion_override_flag(EXEC_RAPID_OVR_MEDIUM); break;
-							case CMD_RAPID_OVR_LOW: system_set_exec_motion_override_flag(EXEC_RAPID_OVR_LOW); break;
-							case CMD_SPINDLE_OVR_RESET: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_RESET); break;
-							case CMD_SPINDLE_OVR_COARSE_PLUS: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_COARSE_PLUS); break;
-							case CMD_SPINDLE_OVR_COARSE_MINUS: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_COARSE_MINUS); break;
-							case CMD_SPINDLE_OVR_FINE_PLUS: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_FINE_PLUS); break;
-							case CMD_SPINDLE_OVR_FINE_MINUS: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_FINE_MINUS); break;
-							case CMD_SPINDLE_OVR_STOP: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_STOP); break;
-							#ifdef COOLANT_FLOOD_PIN
-							case CMD_COOLANT_FLOOD_OVR_TOGGLE: system_set_exec_accessory_override_flag(EXEC_COOLANT_FLOOD_OVR_TOGGLE); break;
-							#endif
-							#ifdef COOLANT_MIST_PIN
-								case CMD_COOLANT_MIST_OVR_TOGGLE: system_set_exec_accessory_override_flag(EXEC_COOLANT_MIST_OVR_TOGGLE); break;
-							#endif
-						}
-						// Throw away any unfound extended-ASCII character by not passing it to the serial buffer.
-					} else { // Write character to buffer
-					
-						vTaskEnterCritical(&myMutex);
-						next_head = serial_rx_buffer_head[client_idx] + 1;
-						if (next_head == RX_RING_BUFFER) { next_head = 0; }
-
-						// Write data to buffer unless it is full.
-						if (next_head != serial_rx_buffer_tail[client_idx]) {
-							serial_rx_buffer[client_idx][serial_rx_buffer_head[client_idx]] = data;
-							serial_rx_buffer_head[client_idx] = next_head;
-						}		
-						vTaskExitCritical(&myMutex);
-					}
-			}  // switch data			
-		}  // if something available
+		#endif
+	}
+}
+
+// Wakes serialCheckTask because a client has new data. Called by the input sources that are
+// filled from other tasks: the input buffer, the web socket, telnet and the Bluetooth callback.
+void serial_wake()
+{
+	if (serialCheckTaskHandle != 0) { xTaskNotifyGive(serialCheckTaskHandle); }
+}
+
+// this task runs and checks for data on all interfaces
+// Realtime stuff is acted upon, then characters are added to the appropriate buffer
+void serialCheckTask(void *pvParameters)
+{
+	while(true) // run continuously
+	{ 		
+		serial_drain_sources();
         COMMANDS::handle();
 #ifdef ENABLE_WIFI
         wifi_config.handle();
@@ -196,7 +482,9 @@ void serialCheckTask(void *pvParameters)
 #if defined (ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_IN)
         Serial2Socket.handle_flush();
 #endif
-        vTaskDelay(1 / portTICK_RATE_MS);  // Yield to other tasks		
+		// Sleep until a source calls serial_wake(). The UART driver has no receive callback, and the
+		// network services above need their turn, so the task also wakes every SERIAL_POLL_TICKS.
+		ulTaskNotifyTake(pdTRUE, SERIAL_POLL_TICKS);
 	}  // while(true)
 }
 
@@ -205,119 +493,17 @@ void serialCheckTask(void *pvParameters)
 // Realtime stuff is acted upon, then characters are added to the appropriate buffer
 void serialCheck()
 {
-	uint8_t data = 0;
-	uint8_t next_head;
-	uint8_t client = CLIENT_SERIAL; // who send the data
-	
-	uint8_t client_idx = 0;  // index of data buffer
-	
-	 		
-		while (Serial.available() || inputBuffer.available()
-		#ifdef ENABLE_BLUETOOTH 
-			 || (SerialBT.hasClient() && SerialBT.available())
-		#endif
-        #if defined (ENABLE_WIFI) && defined(ENABLE_HTTP) && defined(ENABLE_SERIAL2SOCKET_IN)
-			|| Serial2Socket.available()
-		#endif
-            )
-		{			
-		  if (Serial.available())
-			{
-				client = CLIENT_SERIAL;
-				data = Serial.read();
-			}
-       else if (inputBuffer.available())
-            {
-                client = CLIENT_INPUT;
-                data = inputBuffer.read();
-            }     
-#if defined (ENABLE_BLUETOOTH) || (defined (ENABLE_WIFI) && defined(ENABLE_HTTP)  && defined(ENABLE_SERIAL2SOCKET_IN))
-       else
-			{   //currently is wifi or BT but better to prepare both can be live				
-				#ifdef ENABLE_BLUETOOTH
-                if(SerialBT.hasClient() && SerialBT.available()){
-					client = CLIENT_BT;
-					data = SerialBT.read();
-                } else {
-				#endif
-                #if defined (ENABLE_WIFI) && defined(ENABLE_HTTP)  && defined(ENABLE_SERIAL2SOCKET_IN)
-					client = CLIENT_WEBUI;
-                    data = Serial2Socket.read();
-                #endif
-                #ifdef ENABLE_BLUETOOTH
-                }
-                #endif
-			}
-#endif
-						
-			client_idx = client - 1;  // for zero based array 
-			
-			// Pick off realtime command characters directly from the serial stream. These characters are
-			// not passed into the main buffer, but these set system state flag bits for realtime execution.
-			switch (data) {
-				case CMD_RESET:         mc_reset(); break; // Call motion control reset routine.
-				case CMD_STATUS_REPORT: 
-					report_realtime_status(client);
-					break; // direct call instead of setting flag
-				case CMD_CYCLE_START:   system_set_exec_state_flag(EXEC_CYCLE_START); break; // Set as true
-				case CMD_FEED_HOLD:     system_set_exec_state_flag(EXEC_FEED_HOLD); break; // Set as true
-				default :
-					if (data > 0x7F) { // Real-time control characters are extended ACSII only.
-						switch(data) {
-							case CMD_SAFETY_DOOR:   system_set_exec_state_flag(EXEC_SAFETY_DOOR); break; // Set as true
-							case CMD_JOG_CANCEL:   
-								if (sys.state & STATE_JOG) { // Block all other states from invoking motion cancel.
-									system_set_exec_state_flag(EXEC_MOTION_CANCEL); 
-								}
-								break; 
-							#ifdef DEBUG
-								case CMD_DEBUG_REPORT: {uint8_t sreg = SREG; cli(); bit_true(sys_rt_exec_debug,EXEC_DEBUG_REPORT); SREG = sreg;} break;
-							#endif
-							case CMD_FEED_OVR_RESET: system_set_exec_motion_override_flag(EXEC_FEED_OVR_RESET); break;
-							case CMD_FEED_OVR_COARSE_PLUS: system_set_exec_motion_override_flag(EXEC_FEED_OVR_COARSE_PLUS); break;
-							case CMD_FEED_OVR_COARSE_MINUS: system_set_exec_motion_override_flag(EXEC_FEED_OVR_COARSE_MINUS); break;
-							case CMD_FEED_OVR_FINE_PLUS: system_set_exec_motion_override_flag(EXEC_FEED_OVR_FINE_PLUS); break;
-							case CMD_FEED_OVR_FINE_MINUS: system_set_exec_motion_override_flag(EXEC_FEED_OVR_FINE_MINUS); break;
-							case CMD_RAPID_OVR_RESET: system_set_exec_motion_override_flag(EXEC_RAPID_OVR_RESET); break;
-							case CMD_RAPID_OVR_MEDIUM: system_set_exec_motion_override_flag(EXEC_RAPID_OVR_MEDIUM); break;
-							case CMD_RAPID_OVR_LOW: system_set_exec_motion_override_flag(EXEC_RAPID_OVR_LOW); break;
-							case CMD_SPINDLE_OVR_RESET: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_RESET); break;
-							case CMD_SPINDLE_OVR_COARSE_PLUS: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_COARSE_PLUS); break;
-							case CMD_SPINDLE_OVR_COARSE_MINUS: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_COARSE_MINUS); break;
-							case CMD_SPINDLE_OVR_FINE_PLUS: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_FINE_PLUS); break;
-							case CMD_SPINDLE_OVR_FINE_MINUS: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_FINE_MINUS); break;
-							case CMD_SPINDLE_OVR_STOP: system_set_exec_accessory_override_flag(EXEC_SPINDLE_OVR_STOP); break;
-							#ifdef COOLANT_FLOOD_PIN
-							case CMD_COOLANT_FLOOD_OVR_TOGGLE: system_set_exec_accessory_override_flag(EXEC_COOLANT_FLOOD_OVR_TOGGLE); break;
-							#endif
-							#ifdef COOLANT_MIST_PIN
-								case CMD_COOLANT_MIST_OVR_TOGGLE: system_set_exec_accessory_override_flag(EXEC_COOLANT_MIST_OVR_TOGGLE); break;
-							#endif
-						}
-						// Throw away any unfound extended-ASCII character by not passing it to the serial buffer.
-					} else { // Write character to buffer
-					
-						
-						next_head = serial_rx_buffer_head[client_idx] + 1;
-						if (next_head == RX_RING_BUFFER) { next_head = 0; }
-
-						// Write data to buffer unless it is full.
-						if (next_head != serial_rx_buffer_tail[client_idx]) {
-							serial_rx_buffer[client_idx][serial_rx_buffer_head[client_idx]] = data;
-							serial_rx_buffer_head[client_idx] = next_head;
-						}								
-					}
-			}  // switch data						
-		}  // if something available	
+	serial_drain_sources();
 }
 
 void serial_reset_read_buffer(uint8_t client)
 {		
-	for (uint8_t client_num = 0; client_num <= CLIENT_COUNT; client_num++)	
+	for (uint8_t client_num = 1; client_num <= CLIENT_COUNT; client_num++)	
 	{
 		if (client == client_num || client == CLIENT_ALL)
 		{
-			serial_rx_buffer_tail[client_num-1] = serial_rx_buffer_head[client_num-1];
+			serial_rx_ring_t *ring = serial_rx_ring_get(client_num);
+			__atomic_store_n(&ring->tail, __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE), __ATOMIC_RELEASE);
 		}
 	}		  
 }
@@ -329,20 +515,7 @@ void serial_write(uint8_t data) {
 // Fetches the first byte in the serial read buffer. Called by main program.
 uint8_t serial_read(uint8_t client)
 {
-	uint8_t client_idx = client - 1;
-	
-  uint8_t tail = serial_rx_buffer_tail[client_idx]; // Temporary serial_rx_buffer_tail (to optimize for volatile)
-  if (serial_rx_buffer_head[client_idx] == tail) {
-    return SERIAL_NO_DATA;
-  } else {
-		vTaskEnterCritical(&myMutex); // make sure buffer is not modified while reading by newly read chars from the serial when we are here
-    uint8_t data = serial_rx_buffer[client_idx][tail];
-
-    tail++;
-    if (tail == RX_RING_BUFFER) { tail = 0; }
-    serial_rx_buffer_tail[client_idx] = tail;
-		vTaskExitCritical(&myMutex);		
-    return data;
-  }
+	uint8_t data;
+	if (serial_read_bytes(client, &data, 1) == 0) { return SERIAL_NO_DATA; }
+	return data;
 }
-
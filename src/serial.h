@@ -27,31 +27,66 @@
   #define RX_BUFFER_SIZE 128
 #endif
 #ifndef TX_BUFFER_SIZE
-  #ifdef USE_LINE_NUMBERS
-    #define TX_BUFFER_SIZE 112
-  #else
-    #define TX_BUFFER_SIZE 104
-  #endif
+  #define TX_BUFFER_SIZE 1024
+#endif
+
+// What grbl_send() does when a sink's TX ring is full, see config.h.
+#define TX_OVERFLOW_BLOCK 0       // Wait for the sink, however long it takes
+#define TX_OVERFLOW_DROP_OLDEST 1 // Wait up to TX_STALL_MS, then drop the oldest text
+#define TX_OVERFLOW_COALESCE 2    // As DROP_OLDEST, and status reports skip the queue, the newest only
+#ifndef TX_OVERFLOW_POLICY
+  #define TX_OVERFLOW_POLICY TX_OVERFLOW_COALESCE
+#endif
+#ifndef TX_STALL_MS
+  #define TX_STALL_MS 50
 #endif
 
 #define SERIAL_NO_DATA 0xff
 
+// Bytes taken from an input source per read while moving data into the receive rings.
+#define SERIAL_INTAKE_CHUNK 64
+
+// Longest the intake task sleeps when no source wakes it. The UART is only seen on these polls.
+#ifndef SERIAL_POLL_TICKS
+  #define SERIAL_POLL_TICKS (1 / portTICK_RATE_MS)
+#endif
+
 // a task to read for incoming data from serial port
 void serialCheckTask(void *pvParameters);
 
 void serialCheck();
 
+// Wakes the intake task early. Called by input sources when new data arrives.
+void serial_wake();
+
 void serial_write(uint8_t data);
 // Fetches the first byte in the serial read buffer. Called by main program.
 uint8_t serial_read(uint8_t client);
 
+// Bulk access to the per-client receive rings. Each ring has one producer (the serial intake) and
+// one consumer (the protocol loop) and needs no locking. Both return the number of bytes moved.
+uint16_t serial_rx_write(uint8_t client, const uint8_t *data, uint16_t len);
+uint16_t serial_read_bytes(uint8_t client, uint8_t *data, uint16_t len);
+
+// Queues a whole line for a client that fills its own ring instead of going through the intake
+// (CLIENT_GUI). Returns false, and queues nothing, when the line does not fit.
+bool serial_queue_line(uint8_t client, const char *line);
+
 // See if the character is an action command like feedhold or jogging. If so, do the action and return true
 uint8_t check_action_command(uint8_t data);
 
+// Queues text for the client's output sink, or for every sink with CLIENT_ALL. Each sink has a
+// TX ring of TX_BUFFER_SIZE bytes and a task that writes it to the sink, so this only copies,
+// and a slow or stalled peer never holds up the caller for more than TX_STALL_MS.
+void serial_send(uint8_t client, const char *text);
+
+// Waits until the TX rings are empty, or for timeout_ms. For messages that must be out before a restart.
+void serial_tx_flush(uint32_t timeout_ms);
+
 void serial_init();
 void serial_reset_read_buffer(uint8_t client);
 
 // Returns the number of bytes available in the RX serial buffer.
-uint8_t serial_get_rx_buffer_available(uint8_t client);
+uint16_t serial_get_rx_buffer_available(uint8_t client);
 
 #endif
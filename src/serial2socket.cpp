@@ -28,6 +28,7 @@
 
 
 #include "serial2socket.h"
+#include "serial.h"
 #include "web_server.h"
 #include <WebSocketsServer.h>
 #include <WiFi.h>
@@ -135,6 +136,7 @@ bool Serial_2_Socket::push (const char * data){
         current ++;
         }
         _RXbufferSize+=strlen(data);
+        serial_wake();
         return true;
     }
     return false;
@@ -153,6 +155,22 @@ int Serial_2_Socket::read(void){
     } else return -1;
 }
 
+size_t Serial_2_Socket::read(uint8_t *buffer, size_t size){
+    size_t count = 0;
+    while ((count < size) && (_RXbufferSize > 0)) {
+        //copy up to the end of the ring, then wrap
+        size_t chunk = RXBUFFERSIZE - _RXbufferpos;
+        if (chunk > _RXbufferSize) chunk = _RXbufferSize;
+        if (chunk > (size - count)) chunk = size - count;
+        memcpy(&buffer[count], &_RXbuffer[_RXbufferpos], chunk);
+        _RXbufferpos += chunk;
+        if (_RXbufferpos > (RXBUFFERSIZE-1))_RXbufferpos = 0;
+        _RXbufferSize -= chunk;
+        count += chunk;
+    }
+    return count;
+}
+
 void Serial_2_Socket::handle_flush() {
     if (_TXbufferSize > 0) {
         if ((_TXbufferSize>=TXBUFFERSIZE) || ((millis()- _lastflush) > FLUSHTIMEOUT)) {
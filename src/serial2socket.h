@@ -59,6 +59,7 @@ class Serial_2_Socket: public Print{
     int available();
     int peek(void);
     int read(void);
+    size_t read(uint8_t *buffer, size_t size);
     bool push (const char * data);
     void flush(void);
     void handle_flush();
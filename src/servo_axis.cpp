@@ -279,6 +279,7 @@ bool ServoAxis::_cal_is_valid()
 			grbl_sendf(CLIENT_SERIAL, "[MSG:Servo calibration ($10%d) value error. Reset to 100]\r\n", _axis);
 			settings.steps_per_mm[_axis] = 100;
 			write_global_settings();
+			plan_update_axis_limits(); // The planner caches 1/steps_per_mm
 		}
 		settingsOK = false;
 	}
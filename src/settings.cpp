@@ -83,6 +83,8 @@ void settings_restore(uint8_t restore_flag) {
     settings.homing_debounce_delay = DEFAULT_HOMING_DEBOUNCE_DELAY;
     settings.homing_pulloff = DEFAULT_HOMING_PULLOFF;
 
+    settings.planner_blocks = DEFAULT_PLANNER_BLOCKS;
+
     settings.flags = 0;
     if (DEFAULT_REPORT_INCHES) { settings.flags |= BITFLAG_REPORT_INCHES; }
     if (DEFAULT_LASER_MODE) { settings.flags |= BITFLAG_LASER_MODE; }
@@ -156,6 +158,7 @@ void settings_restore(uint8_t restore_flag) {
 	
 
     write_global_settings();
+    plan_update_axis_limits();
   }
 
   if (restore_flag & SETTINGS_RESTORE_PARAMETERS) {
@@ -391,11 +394,16 @@ uint8_t settings_store_global_setting(uint8_t parameter, float value) {
       case 34: settings.spindle_pwm_off_value = value; spindle_init(); break; // Re-initialize spindle pwm calibration
       case 35: settings.spindle_pwm_min_value = value; spindle_init(); break; // Re-initialize spindle pwm calibration
       case 36: settings.spindle_pwm_max_value = value; spindle_init(); break; // Re-initialize spindle pwm calibration
+      case 37: // Reboot to apply. The block buffer is only allocated at boot.
+        if ((value < PLANNER_BLOCKS_MIN) || (value > PLANNER_BLOCKS_MAX)) { return(STATUS_INVALID_STATEMENT); }
+        settings.planner_blocks = (uint16_t)value;
+        break;
       default:
         return(STATUS_INVALID_STATEMENT);
     }
   }
   write_global_settings();
+  plan_update_axis_limits(); // Keep the planner's inverse axis limits in step with $100-$132.
   return(STATUS_OK);
 }
 
@@ -19,9 +19,13 @@ void setupGRBL() {
 
   serial_init();   // Setup serial baud rate and interrupts
   settings_init(); // Load Grbl settings from EEPROM  
+  plan_init();     // Allocate the planner block buffer ($37)
   
   stepper_init();  // Configure stepper pins and interrupt timers
   system_ini();   // Configure pinout pins and pin-change interrupt (Renamed due to conflict with esp32 files)	
+#ifdef ENABLE_SD_CARD
+  sd_init();       // Start the SD job streamer task
+#endif
 	 
   memset(sys_position,0,sizeof(sys_position)); // Clear machine position.
 
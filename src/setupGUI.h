@@ -3,6 +3,9 @@
 #include <lvgl.h>
 #include <Ticker.h>
 #include <TFT_eSPI.h>
+#include <driver/spi_master.h>
+#include <soc/spi_struct.h>
+#include <freertos/ringbuf.h>
 #include "grbl.h"
 #include "terminal.h"
 #include "wificonfig.h"
@@ -16,7 +19,6 @@ TFT_eSPI tft = TFT_eSPI(); /* TFT instance */
 int screenWidth = 480;
 int screenHeight = 320;
 
-char GCode[]= {""};
 
 static const int buzzerPin = 1 ;
 
@@ -25,9 +27,37 @@ static char txt_log[TERMINAL_LOG_LENGTH + 1];
 static lv_obj_t * terminal_label;
 
 #define LVGL_TICK_PERIOD 120 // default is 60
+
+// The GUI runs in its own task on the core the radios and the serial intake use, so a redraw
+// never delays the protocol loop that feeds the planner on the other core. It runs at idle
+// priority, below serialCheckTask, the serial TX tasks and sdStreamTask (all priority 1), so a
+// slow frame never holds up a feed hold or reset coming in on core 0.
+#define GUI_TASK_STACK_SIZE 8192
+#define GUI_TASK_PRIORITY tskIDLE_PRIORITY
+#define GUI_TASK_CORE 0
+#define GUI_FRAME_PERIOD_MS 33 // ~30 frames per second at most
 Ticker tick; /* timer for interrupt handler */
+
+// Display flush. LVGL renders into one band while the other one is sent to the display by
+// SPI DMA, and the DMA completion tells LVGL the band is free again. Without GUI_DISPLAY_DMA
+// (or if the SPI driver can't be set up) the bands are pushed by the CPU in one block each.
+#define GUI_DISPLAY_DMA // Comment to disable
+#define GUI_DRAW_BUF_PIXELS (LV_HOR_RES_MAX * 10) // One band of 10 lines
+#define GUI_DMA_CHANNEL 1
+#ifdef USE_HSPI_PORT
+  #define TFT_SPI_HOST HSPI_HOST
+  #define TFT_SPI_DEV SPI2
+#else
+  #define TFT_SPI_HOST VSPI_HOST
+  #define TFT_SPI_DEV SPI3
+#endif
+#if LV_COLOR_16_SWAP == 0
+  #error "The display takes the bands as rendered. Set LV_COLOR_16_SWAP to 1 in lv_conf.h"
+#endif
+
 static lv_disp_buf_t disp_buf;
-static lv_color_t buf[LV_HOR_RES_MAX * 10];
+DMA_ATTR static lv_color_t buf1[GUI_DRAW_BUF_PIXELS];
+DMA_ATTR static lv_color_t buf2[GUI_DRAW_BUF_PIXELS];
 
 #if USE_LV_LOG != 0 /* Serial debugging */
 void my_print(lv_log_level_t level, const char * file, uint32_t line, const char * dsc)
@@ -37,21 +67,94 @@ void my_print(lv_log_level_t level, const char * file, uint32_t line, const char
     }
 #endif
 
+/* 
+Display DMA
+*/
+#ifdef GUI_DISPLAY_DMA
+static spi_device_handle_t tft_dma = NULL;
+static bool tft_dma_busy = false; // A band is on the wire and the TFT transaction is open.
+
+/* Called by the SPI driver from its interrupt when a band has been sent */
+static void tft_dma_done(spi_transaction_t *trans)
+    {
+    lv_disp_flush_ready((lv_disp_drv_t *)trans->user);
+    }
+
+/* 
+Adds a DMA device on the bus TFT_eSPI already drives. TFT_eSPI keeps control of CS and DC,
+the SPI driver only streams the pixels.
+*/
+static void tft_dma_init()
+    {
+    spi_bus_config_t buscfg;
+    memset(&buscfg, 0, sizeof(buscfg));
+    buscfg.mosi_io_num = TFT_MOSI;
+    buscfg.miso_io_num = TFT_MISO;
+    buscfg.sclk_io_num = TFT_SCLK;
+    buscfg.quadwp_io_num = -1;
+    buscfg.quadhd_io_num = -1;
+    buscfg.max_transfer_sz = GUI_DRAW_BUF_PIXELS * sizeof(lv_color_t);
+
+    spi_device_interface_config_t devcfg;
+    memset(&devcfg, 0, sizeof(devcfg));
+    devcfg.mode = TFT_SPI_MODE;
+    devcfg.clock_speed_hz = SPI_FREQUENCY;
+    devcfg.spics_io_num = -1;
+    devcfg.flags = SPI_DEVICE_NO_DUMMY;
+    devcfg.queue_size = 1;
+    devcfg.post_cb = tft_dma_done;
+
+    if (spi_bus_initialize(TFT_SPI_HOST, &buscfg, GUI_DMA_CHANNEL) != ESP_OK) return;
+    if (spi_bus_add_device(TFT_SPI_HOST, &devcfg, &tft_dma) != ESP_OK) tft_dma = NULL;
+    }
+#endif
+
+/* 
+Waits for the band on the wire and ends the TFT transaction, so the bus is free for the
+touch controller and the SD card. Called before any other use of the bus and at the end
+of every GUI frame.
+*/
+static void tft_dma_wait()
+    {
+#ifdef GUI_DISPLAY_DMA
+    if (!tft_dma_busy) return;
+    spi_transaction_t *trans;
+    spi_device_get_trans_result(tft_dma, &trans, portMAX_DELAY);
+    tft_dma_busy = false;
+    // The SPI driver leaves the bus set up for transmit only. Restore full duplex for the
+    // Arduino SPI driver that the touch controller and the SD card go through.
+    TFT_SPI_DEV.user.usr_mosi = 1;
+    TFT_SPI_DEV.user.usr_miso = 1;
+    TFT_SPI_DEV.user.doutdin = 1;
+    TFT_SPI_DEV.ctrl2.val = 0;
+    tft.endWrite();
+#endif
+    }
+
 /* 
 Display flushing 
 */
 void my_disp_flush(lv_disp_drv_t *disp, const lv_area_t *area, lv_color_t *color_p)
     {
-    uint16_t c;
+    uint32_t w = (area->x2 - area->x1 + 1);
+    uint32_t h = (area->y2 - area->y1 + 1);
+    tft_dma_wait(); /* the window can only move once the previous band is out */
     tft.startWrite(); /* Start new TFT transaction */
-    tft.setAddrWindow(area->x1, area->y1, (area->x2 - area->x1 + 1), (area->y2 - area->y1 + 1)); /* set the working window */
-    for (int y = area->y1; y <= area->y2; y++) {
-        for (int x = area->x1; x <= area->x2; x++) {
-        c = color_p->full;
-        tft.writeColor(c, 1);
-        color_p++;
+    tft.setAddrWindow(area->x1, area->y1, w, h); /* set the working window */
+#ifdef GUI_DISPLAY_DMA
+    if (tft_dma != NULL) {
+        static spi_transaction_t trans;
+        memset(&trans, 0, sizeof(trans));
+        trans.length = w * h * 16; /* bits */
+        trans.tx_buffer = color_p;
+        trans.user = disp;
+        if (spi_device_queue_trans(tft_dma, &trans, portMAX_DELAY) == ESP_OK) {
+            tft_dma_busy = true;
+            return; /* tft_dma_done() tells lvgl when the band is out */
         }
     }
+#endif
+    tft.pushColors((uint16_t *)color_p, w * h, false); /* already byte swapped by lvgl */
     tft.endWrite(); /* terminate TFT transaction */
     lv_disp_flush_ready(disp); /* tell lvgl that flushing is done */
     }
@@ -65,6 +168,40 @@ void beep(){
   digitalWrite(buzzerPin, LOW);  
     }  
 
+void terminal_add(const char * txt_in);
+
+/* 
+Send a command line to Grbl. The GUI is a client of its own (CLIENT_GUI). Its lines go into
+its receive ring and the main loop executes them like lines from any other client. Nothing
+is queued when the ring is full, so a press never waits for the machine.
+*/
+static bool gui_send_line(const char * line){
+  if (serial_queue_line(CLIENT_GUI, line)) return true;
+  terminal_add("Busy, try again\n");
+  return false;
+}
+
+/* 
+Responses to the GUI. grbl_send() is called from the main loop and the serial task, but
+LVGL only from the GUI task, so the text waits in a ring buffer until the next frame.
+*/
+#define GUI_RESPONSE_BUFFER_SIZE 1024
+static RingbufHandle_t gui_responses = NULL;
+
+void gui_send(const char * text){
+  if (gui_responses == NULL) return;
+  xRingbufferSend(gui_responses, text, strlen(text) + 1, 0); // Dropped if the GUI falls behind
+}
+
+static void gui_receive(){
+  size_t size;
+  char * text;
+  while ((text = (char *)xRingbufferReceive(gui_responses, &size, 0)) != NULL) {
+    if (strncmp(text, "ok", 2) != 0) terminal_add(text); // Every line gets an ok. Show the rest.
+    vRingbufferReturnItem(gui_responses, text);
+  }
+}
+
 /* 
 Create Serial Console
 */
@@ -148,6 +285,7 @@ void terminal_add(const char * txt_in){
 
 bool my_touchpad_read(lv_indev_drv_t * indev_driver, lv_indev_data_t * data){
     uint16_t touchX, touchY;
+    tft_dma_wait(); /* the touch controller shares the bus with the display */
     bool touched = tft.getTouch(&touchX, &touchY, 300);
     if(!touched)
     {
@@ -179,20 +317,13 @@ static void cb_keyboard (lv_obj_t * obj, lv_event_t event){
         lv_ta_del_char(ta);
         beep();
         }else if (strcmp(txt, "OK") == 0){
-            strcpy(&GCode[strlen(GCode)], lv_ta_get_text(ta));
-            
-            gc_execute_line(GCode, CLIENT_ALL);
-            
-            terminal_add(GCode);
-            terminal_add("\n");
-
-            grbl_sendf(CLIENT_ALL,GCode);
-            grbl_sendf(CLIENT_ALL,"\n");
-            
+            const char * line = lv_ta_get_text(ta);
+            if (gui_send_line(line)) {
+              terminal_add(line);
+              terminal_add("\n");
+              lv_ta_set_text(ta,"");
+            }
             beep();
-            lv_ta_set_text(ta,"");
-
-            protocol_auto_cycle_start();
             return;
         }else{
           lv_ta_add_text(ta,txt);
@@ -323,9 +454,8 @@ static void ddFileNamelistevent_handler(lv_obj_t * obj, lv_event_t event){
             if (event == LV_EVENT_VALUE_CHANGED){
                 beep();
                 lv_ddlist_get_selected_str(obj  ,ddbuf, sizeof(ddbuf));
-                grbl_sendf(CLIENT_ALL, ddbuf );
-                grbl_sendf(CLIENT_ALL, " selected.\n" );
                 terminal_add(ddbuf);
+                terminal_add(" selected.\n");
                 fileToPrint = ddbuf;
             }
     }
@@ -334,18 +464,12 @@ static void ddFileNamelistevent_handler(lv_obj_t * obj, lv_event_t event){
 /* 
 Travel Distance dropdown
 */
-char travelDist[]= {"10"};
+static char travelDist[8]= {"10"};
 static void ddDistListevent_handler(lv_obj_t * obj, lv_event_t event){
-    static char ddbuf[8]= " ";
             if (event == LV_EVENT_VALUE_CHANGED){
                 beep();
-                lv_ddlist_get_selected_str(obj  ,ddbuf, sizeof(ddbuf));
-
-                strcpy (&travelDist[strlen(travelDist)], ddbuf);
+                lv_ddlist_get_selected_str(obj, travelDist, sizeof(travelDist));
 
-                grbl_sendf(CLIENT_ALL, "Travel distance set to " );
-                grbl_sendf(CLIENT_ALL, &travelDist[strlen(travelDist)]);
-                grbl_sendf(CLIENT_ALL, " mm. \n" );
                 terminal_add("Travel distance set to " );
                 terminal_add(travelDist);
                 terminal_add(" mm \n");
@@ -360,27 +484,29 @@ static void ddDistListevent_handler(lv_obj_t * obj, lv_event_t event){
  Feed Rate
 */
 
-char  FR[]={"500"};
+static char FR[8]={"500"};
 static void sliderFR_event_cb(lv_obj_t * slider, lv_event_t event){
-    static int sliderFR;
-    char fValue[8];
      if (event == LV_EVENT_VALUE_CHANGED){
 
-         sliderFR = lv_slider_get_value(slider);
-        
-         dtostrf(sliderFR, 4, 0, fValue);
+         print_append_uint32(FR, lv_slider_get_value(slider));
 
-         strcpy (&FR[strlen(FR)], fValue);
-
-         grbl_sendf(CLIENT_ALL, "Feedrate: " );
-         grbl_sendf(CLIENT_ALL,FR );
-         grbl_sendf(CLIENT_ALL, " \n" );
+         terminal_add("Feedrate: " );
          terminal_add(FR);
+         terminal_add("\n");
         
    }}
 /*
  Jog Control
 */
+static void gui_jog(const char * axis){
+  char line[32];
+  snprintf(line, sizeof(line), "G90G21%s%sF%s", axis, travelDist, FR);
+  if (gui_send_line(line)) {
+    terminal_add(line);
+    terminal_add("\n");
+  }
+}
+
 static void cb_JogControl(lv_obj_t * btnm, lv_event_t event){
 int btnIdx = lv_btnm_get_active_btn(btnm);
 const char * txt = lv_btnm_get_active_btn_text(btnm);
@@ -392,78 +518,31 @@ const char * txt = lv_btnm_get_active_btn_text(btnm);
           
           break;
         case 1:
-            strcpy (&GCode[strlen(GCode)], "G90G21Y");
-            strcat (&GCode[strlen(GCode)], travelDist);
-            strcat (&GCode[strlen(GCode)], "F");
-            strcat (&GCode[strlen(GCode)],FR);
-            //strcat (&GCode[strlen(GCode)],"]");
-            report_status_message(gc_execute_line(GCode, CLIENT_ALL),CLIENT_ALL);
-            grbl_sendf(CLIENT_ALL, GCode);
-            terminal_add(GCode);
+            gui_jog("Y");
             break;
         case 2:
-            strcpy (&GCode[strlen(GCode)], "G90G21Z");
-            strcat (&GCode[strlen(GCode)], travelDist);
-            strcat (&GCode[strlen(GCode)], "F");
-            strcat (&GCode[strlen(GCode)],FR);
-            //strcat (&GCode[strlen(GCode)],"]");
-            report_status_message(gc_execute_line(GCode, CLIENT_ALL),CLIENT_ALL);
-            grbl_sendf(CLIENT_ALL, GCode);
-            terminal_add(GCode);
+            gui_jog("Z");
             break;
         case 3:
-            strcpy (&GCode[strlen(GCode)], "G90G21X-");
-            strcat (&GCode[strlen(GCode)], travelDist);
-            strcat (&GCode[strlen(GCode)], "F");
-            strcat (&GCode[strlen(GCode)],FR);
-            //strcat (&GCode[strlen(GCode)],"]");
-            report_status_message(gc_execute_line(GCode, CLIENT_ALL),CLIENT_ALL);
-            grbl_sendf(CLIENT_ALL, GCode);
-            terminal_add(GCode);
+            gui_jog("X-");
 
             break;
         case 4:
             //report_status_message(gc_execute_line("$HZ0", CLIENT_ALL),CLIENT_ALL);
-            strcpy (&GCode[strlen(GCode)], "$HX0");
-            report_status_message(gc_execute_line(GCode, CLIENT_ALL),CLIENT_ALL);
-            strcpy (&GCode[strlen(GCode)], "$HY0");
-            report_status_message(gc_execute_line(GCode, CLIENT_ALL),CLIENT_ALL);
-            grbl_sendf(CLIENT_ALL, "Home X&Y");
-            grbl_sendf(CLIENT_ALL, "\n");
-            terminal_add("Home X&Y\n");
+            if (gui_send_line("$HX0") && gui_send_line("$HY0")) terminal_add("Home X&Y\n");
             break;
         case 5:
-            strcpy (&GCode[strlen(GCode)], "G90G21X");
-            strcat (&GCode[strlen(GCode)], travelDist);
-            strcat (&GCode[strlen(GCode)], "F");
-            strcat (&GCode[strlen(GCode)],FR);
-            //strcat (&GCode[strlen(GCode)],"]");
-            report_status_message(gc_execute_line(GCode, CLIENT_ALL),CLIENT_ALL);
-            grbl_sendf(CLIENT_ALL, GCode);
-            terminal_add(GCode);
+            gui_jog("X");
 
             break;
         case 6:
           
           break;
         case 7:
-            strcpy (&GCode[strlen(GCode)], "G90G21Y-");
-            strcat (&GCode[strlen(GCode)], travelDist);
-            strcat (&GCode[strlen(GCode)], "F");
-            strcat (&GCode[strlen(GCode)],FR);
-            //strcat (&GCode[strlen(GCode)],"]");
-            report_status_message(gc_execute_line(GCode, CLIENT_ALL),CLIENT_ALL);
-            grbl_sendf(CLIENT_ALL, GCode);
-            terminal_add(GCode);
+            gui_jog("Y-");
             break;
         case 8:
-            strcpy (&GCode[strlen(GCode)], "G90G21Z-");
-            strcat (&GCode[strlen(GCode)], travelDist);
-            strcat (&GCode[strlen(GCode)], "F");
-            strcat (&GCode[strlen(GCode)],FR);
-            report_status_message(gc_execute_line(GCode, CLIENT_ALL),CLIENT_ALL);
-            grbl_sendf(CLIENT_ALL, GCode);
-            terminal_add(GCode);
+            gui_jog("Z-");
             break;
       default:
           break;
@@ -482,47 +561,160 @@ int btnIdx = lv_btnm_get_active_btn(btnm);
       switch (btnIdx)
       {
         case 0:
-          strcpy (&GCode[strlen(GCode)], "$X");
-          report_status_message(gc_execute_line(GCode, CLIENT_ALL),CLIENT_ALL);
-          terminal_add(GCode);
-          grbl_sendf(CLIENT_ALL, "Locked");
-          grbl_sendf(CLIENT_ALL, "\n");
-          //empty line buffer
-
-
+          if (gui_send_line("$X")) terminal_add("Unlock\n");
           break; 
+        // Hold, reset and resume are realtime commands. Like the '!', ctrl-x and '~' characters
+        // from the other clients, they set the realtime flags and skip the line queue.
         case 1:
-          strcpy (&GCode[strlen(GCode)], "!");
-          report_status_message(gc_execute_line(GCode, CLIENT_ALL),CLIENT_ALL);
-          terminal_add(GCode);
-          grbl_sendf(CLIENT_ALL, "Paused");
-          grbl_sendf(CLIENT_ALL, "\n");
+          system_set_exec_state_flag(EXEC_FEED_HOLD);
+          terminal_add("Paused\n");
           break;
         case 2:
-          strcpy (&GCode[strlen(GCode)], "0x18");
-          report_status_message(gc_execute_line(GCode, CLIENT_ALL),CLIENT_ALL);
-          terminal_add(GCode);
-          grbl_sendf(CLIENT_ALL, "Reset");
-          grbl_sendf(CLIENT_ALL, "\n");
+          mc_reset();
+          terminal_add("Reset\n");
           break;
-        case 3:
-          strcpy (&GCode[strlen(GCode)], "file test.gcode");
-          report_status_message(gc_execute_line(GCode, CLIENT_ALL),CLIENT_ALL);
-          terminal_add(GCode);
-          grbl_sendf(CLIENT_ALL, "Go");
-          grbl_sendf(CLIENT_ALL, "\n");
+        case 3: {
+          report_status_snapshot_t snap;
+          report_status_snapshot(&snap);
+          if (snap.state & (STATE_HOLD | STATE_SAFETY_DOOR)) {
+            system_set_exec_state_flag(EXEC_CYCLE_START);
+            terminal_add("Resume\n");
+          } else if (fileToPrint != NULL) {
+            char line[48];
+            snprintf(line, sizeof(line), "[ESP700]%s", fileToPrint); // Run the selected SPIFFS file
+            if (gui_send_line(line)) terminal_add("Go\n");
+          }
           break;
+        }
       default:
           break;
       }
     }
 }
 //mc_reset();
+/*
+ DRO. Refreshed from the status snapshot the main loop publishes for the status report, so
+ it never reads the live machine state or builds a report. A label only gets new text, and
+ so only gets redrawn, when its formatted text changed.
+*/
+#define GUI_DRO_PERIOD_MS 50 // 20Hz. Anything from 33 to 100ms (30-10Hz) reads fine.
+#define GUI_DRO_AXES 3 // X, Y and Z have big work position labels.
+#define GUI_DRO_TEXT_SIZE 80
+
+typedef struct {
+  lv_obj_t * label;
+  char text[GUI_DRO_TEXT_SIZE];
+} dro_field_t;
+
+static dro_field_t dro_axis[GUI_DRO_AXES]; // Work position
+static dro_field_t dro_mpos;               // Machine position, all axes
+static dro_field_t dro_status;             // State, feed, spindle and planner blocks free
+
+static void dro_attach(dro_field_t *field, lv_obj_t * label){
+  field->label = label;
+  field->text[0] = 0;
+  lv_label_set_static_text(label, field->text);
+}
+
+static void dro_set_text(dro_field_t *field, const char *text){
+  if (strcmp(field->text, text) == 0) return;
+  strncpy(field->text, text, GUI_DRO_TEXT_SIZE-1);
+  field->text[GUI_DRO_TEXT_SIZE-1] = 0;
+  lv_label_set_static_text(field->label, field->text); // Invalidates the label
+}
+
+static const char * dro_state_name(uint8_t state){
+  switch (state) {
+    case STATE_IDLE: return "Idle";
+    case STATE_CYCLE: return "Run";
+    case STATE_HOLD: return "Hold";
+    case STATE_JOG: return "Jog";
+    case STATE_HOMING: return "Home";
+    case STATE_ALARM: return "Alarm";
+    case STATE_CHECK_MODE: return "Check";
+    case STATE_SAFETY_DOOR: return "Door";
+    case STATE_SLEEP: return "Sleep";
+  }
+  return "";
+}
+
+static char * dro_append_position(char *p, float value, bool inches){
+  if (inches) return print_append_float(p, value*INCH_PER_MM, N_DECIMAL_COORDVALUE_INCH);
+  return print_append_float(p, value, N_DECIMAL_COORDVALUE_MM);
+}
+
+static void dro_update(lv_task_t * task){
+  report_status_snapshot_t snap;
+  report_status_snapshot(&snap);
+  bool inches = bit_istrue(settings.flags, BITFLAG_REPORT_INCHES);
+
+  float mpos[N_AXIS];
+  system_convert_array_steps_to_mpos(mpos, snap.position);
+
+  char text[GUI_DRO_TEXT_SIZE];
+  for (uint8_t idx = 0; idx < GUI_DRO_AXES; idx++) {
+    dro_append_position(text, mpos[idx] - snap.wco[idx], inches);
+    dro_set_text(&dro_axis[idx], text);
+  }
+
+  char *p = print_append_string(text, "MPos ");
+  for (uint8_t idx = 0; idx < N_AXIS; idx++) {
+    p = dro_append_position(p, mpos[idx], inches);
+    if (idx < (N_AXIS-1)) *p++ = ' ';
+  }
+  *p = 0;
+  dro_set_text(&dro_mpos, text);
+
+  p = print_append_string(text, dro_state_name(snap.state));
+  p = print_append_string(p, "  F:");
+  if (inches) p = print_append_float(p, snap.feed_rate / MM_PER_INCH, N_DECIMAL_RATEVALUE_INCH);
+  else p = print_append_float(p, snap.feed_rate, N_DECIMAL_RATEVALUE_MM);
+  p = print_append_string(p, "  S:");
+  p = print_append_float(p, snap.spindle_speed, N_DECIMAL_RPMVALUE);
+  p = print_append_string(p, "  Bf:");
+  print_append_uint32(p, snap.planner_blocks_available);
+  dro_set_text(&dro_status, text);
+}
+
+/*
+ GUI Task. All LVGL calls, including the display flush, the touch poll and the event
+ callbacks, happen in here and nowhere else.
+*/
+static TaskHandle_t guiTaskHandle = 0;
+static void guiTask(void *pvParameters){
+  const TickType_t frame_period = pdMS_TO_TICKS(GUI_FRAME_PERIOD_MS);
+  for (;;) {
+    TickType_t frame_start = xTaskGetTickCount();
+    gui_receive();
+    lv_task_handler();
+    tft_dma_wait(); // Never keep the bus between frames.
+    TickType_t frame_time = xTaskGetTickCount() - frame_start;
+    // Sleep for the rest of the frame. A frame that ran over still yields for a tick.
+    vTaskDelay((frame_time < frame_period) ? (frame_period - frame_time) : 1);
+    }
+    }
+
+/*
+ Starts rendering. Called once Grbl is set up, so a touch never reaches a half set up machine.
+*/
+static void startGUI(){
+  xTaskCreatePinnedToCore(guiTask,    // task
+                          "guiTask", // name for task
+                          GUI_TASK_STACK_SIZE,   // size of task stack
+                          NULL,   // parameters
+                          GUI_TASK_PRIORITY, // priority
+                          &guiTaskHandle,
+                          GUI_TASK_CORE // core
+                          );
+    }
+
 /*
  GUI Setup
 */
 static void setupGUI() {
 
+    gui_responses = xRingbufferCreate(GUI_RESPONSE_BUFFER_SIZE, RINGBUF_TYPE_NOSPLIT);
+
     pinMode(buzzerPin, OUTPUT);
 
     SPIFFS.begin();
@@ -540,7 +732,10 @@ static void setupGUI() {
   lv_theme_t * th = lv_theme_night_init(45, NULL);
   lv_theme_set_current(th);
  
-  lv_disp_buf_init(&disp_buf, buf, NULL, LV_HOR_RES_MAX * 10);
+  #ifdef GUI_DISPLAY_DMA
+    tft_dma_init();
+  #endif
+  lv_disp_buf_init(&disp_buf, buf1, buf2, GUI_DRAW_BUF_PIXELS);
   /*Initialize the display*/
   lv_disp_drv_t disp_drv;
   lv_disp_drv_init(&disp_drv);
@@ -662,6 +857,21 @@ static void setupGUI() {
     lv_label_set_text (labelZData, "00.00");
     lv_label_set_style(labelZData,LV_LABEL_STYLE_MAIN , &fjr_style01);
     lv_obj_align(labelZData, NULL, LV_ALIGN_IN_LEFT_MID, 400,-40); 
+
+    dro_attach(&dro_axis[X_AXIS], labelXData);
+    dro_attach(&dro_axis[Y_AXIS], labelYData);
+    dro_attach(&dro_axis[Z_AXIS], labelZData);
+
+    // Machine position and machine status=============================================
+    lv_obj_t *labelMPos = lv_label_create (scr, NULL);
+    lv_obj_align(labelMPos, NULL, LV_ALIGN_IN_LEFT_MID, 370,-15);
+    dro_attach(&dro_mpos, labelMPos);
+
+    lv_obj_t *labelStatus = lv_label_create (scr, NULL);
+    lv_obj_align(labelStatus, NULL, LV_ALIGN_IN_LEFT_MID, 370,-125);
+    dro_attach(&dro_status, labelStatus);
+
+    lv_task_create(dro_update, GUI_DRO_PERIOD_MS, LV_TASK_PRIO_LOW, NULL);
     
     // Labels for TRAVEL AND FEEDRATE===============================
     // lv_obj_t *labelTravel = lv_label_create (scr, NULL);
@@ -21,15 +21,31 @@
 #include "grbl.h"
 
 #ifdef SPINDLE_PWM_PIN
-static float pwm_gradient; // Precalulated value to speed up rpm to PWM conversions.
+// PWM duty at SPINDLE_PWM_LUT_SIZE even steps from rpm_min to rpm_max, from the linear or the
+// piecewise linear spindle model. Built by spindle_init() whenever the settings change, so the
+// segment generator only interpolates between two entries.
+static float pwm_lut[SPINDLE_PWM_LUT_SIZE+1];
+static float pwm_lut_scale; // Entries per rpm
 float spindle_pwm_period;
 float spindle_pwm_off_value;
 float spindle_pwm_min_value;
 float spindle_pwm_max_value;
 #endif
 
+#ifdef SPINDLE_PWM_TRACE
+static spindle_pwm_trace_t pwm_trace;
+static portMUX_TYPE pwm_trace_mux = portMUX_INITIALIZER_UNLOCKED;
+#endif
+
+// A change spindle_sync() left to go with the motion queued ahead of it. It is set here once
+// that motion is done, unless a block followed to carry it.
+static bool spindle_sync_pending = false;
+static uint8_t spindle_pending_state;
+static float spindle_pending_rpm;
+
 void spindle_init()
 {
+	spindle_sync_pending = false;
 	
 	#ifdef SPINDLE_PWM_PIN
 	
@@ -48,8 +64,16 @@ void spindle_init()
 		spindle_pwm_min_value = (spindle_pwm_period * settings.spindle_pwm_min_value / 100);
 		spindle_pwm_max_value = (spindle_pwm_period * settings.spindle_pwm_max_value / 100);
 		
-		//pwm_gradient = (settings.spindle_pwm_max_value - settings.spindle_pwm_min_value)/(settings.rpm_max-settings.rpm_min);
-		pwm_gradient = (spindle_pwm_max_value-spindle_pwm_min_value)/(settings.rpm_max-settings.rpm_min);	
+		if (settings.rpm_max > settings.rpm_min) {
+			pwm_lut_scale = SPINDLE_PWM_LUT_SIZE/(settings.rpm_max-settings.rpm_min);
+			for (uint16_t idx = 0; idx <= SPINDLE_PWM_LUT_SIZE; idx++) {
+				#ifdef ENABLE_PIECEWISE_LINEAR_SPINDLE
+					pwm_lut[idx] = piecewise_linear_fit(settings.rpm_min + idx/pwm_lut_scale);
+				#else
+					pwm_lut[idx] = spindle_pwm_min_value + idx*(spindle_pwm_max_value-spindle_pwm_min_value)/SPINDLE_PWM_LUT_SIZE;
+				#endif
+			}
+		}
 			
 			
 		if ( (F_TIMERS / (uint32_t)settings.spindle_pwm_freq) < spindle_pwm_max_value) {
@@ -116,7 +140,7 @@ uint8_t spindle_get_state()  // returns SPINDLE_STATE_DISABLE, SPINDLE_STATE_CW
 	#endif
 }
 
-void spindle_set_speed(uint32_t pwm_value)
+void IRAM_ATTR spindle_set_speed(uint32_t pwm_value)
 {	
 	#ifndef SPINDLE_PWM_PIN
 		return;
@@ -157,11 +181,10 @@ uint32_t spindle_compute_pwm_value(float rpm){
 			// Compute intermediate PWM value with linear spindle speed model.
 			// NOTE: A nonlinear model could be installed here, if required, but keep it VERY light-weight.
 			sys.spindle_speed = rpm;
-			#ifdef ENABLE_PIECEWISE_LINEAR_SPINDLE
-				pwm_value = piecewise_linear_fit(rpm);
-			#else
-				pwm_value = floor((rpm - settings.rpm_min)*pwm_gradient) + settings.spindle_pwm_min_value;
-			#endif
+			float pos = (rpm - settings.rpm_min)*pwm_lut_scale;
+			uint16_t idx = pos;
+			if (idx >= SPINDLE_PWM_LUT_SIZE) { idx = SPINDLE_PWM_LUT_SIZE-1; } // Rounding just below rpm_max
+			pwm_value = pwm_lut[idx] + (pwm_lut[idx+1]-pwm_lut[idx])*(pos-idx);
 		}
 		return(pwm_value);
 	#else
@@ -197,57 +220,149 @@ void spindle_set_state(uint8_t state, float rpm)
 }
 
 
+// G-code parser entry point. While motion is queued, the new state goes with the next planner
+// block: the stepper sets the direction as the block starts and the speed with its segments, so
+// the look-ahead is not emptied for it. Only a spindle without PWM still waits for the motion.
 void spindle_sync(uint8_t state, float rpm)
 {
 	if (sys.state == STATE_CHECK_MODE) { 
 		return;
 	}
 	
-	protocol_buffer_synchronize(); // Empty planner buffer to ensure spindle is set when programmed.
+	#ifdef VARIABLE_SPINDLE
+		if (protocol_motion_pending()) {
+			spindle_sync_pending = true;
+			spindle_pending_state = state;
+			spindle_pending_rpm = rpm;
+			return;
+		}
+	#else
+		protocol_buffer_synchronize(); // Empty planner buffer to ensure spindle is set when programmed.
+	#endif
+	spindle_sync_pending = false;
 	spindle_set_state(state,rpm);
 }
 
+// Called by the planner as a block takes the spindle state. The stepper sets it from there.
+void spindle_sync_planned()
+{
+	spindle_sync_pending = false;
+}
+
+// Called when a cycle ends with the planner empty. Only a change no block carried is left.
+void spindle_sync_flush()
+{
+	if (spindle_sync_pending) {
+		spindle_sync_pending = false;
+		spindle_set_state(spindle_pending_state, spindle_pending_rpm);
+	}
+}
 
-void grbl_analogWrite(uint8_t chan, uint32_t duty)
+// Called by the stepper ISR as a block with a spindle state starts.
+void IRAM_ATTR spindle_set_direction(uint8_t state)
 {
-	if (ledcRead(chan) != duty) // reduce unnecessary calls to ledcWrite()
-	{
-		grbl_sendf(CLIENT_SERIAL, "[MSG: grbl_analogWrite %d]\r\n", duty);
-		ledcWrite(chan, duty);
+	#ifdef SPINDLE_DIR_PIN
+		if (state & (SPINDLE_ENABLE_CW | SPINDLE_ENABLE_CCW)) {
+			grbl_digitalWrite(SPINDLE_DIR_PIN, (state & SPINDLE_ENABLE_CW) != 0);
+		}
+	#endif
+}
+
+
+// Sets the duty of a LEDC channel the way ledcWrite() does, but without its lock, so the stepper
+// ISR can call it with every segment. The duty register is read back to skip writes that would
+// not change anything.
+void IRAM_ATTR grbl_analogWrite(uint8_t chan, uint32_t duty)
+{
+	uint8_t group = chan/8;
+	uint8_t channel = chan%8;
+	
+	if ((LEDC.channel_group[group].channel[channel].duty.duty >> 4) == duty) {
+		return;
+	}
+	LEDC.channel_group[group].channel[channel].duty.duty = duty << 4; // 4 fractional bits
+	if (duty) {
+		LEDC.channel_group[group].channel[channel].conf0.sig_out_en = 1;
+		LEDC.channel_group[group].channel[channel].conf1.duty_start = 1; // Cleared by the hardware
+		if (group) {
+			LEDC.channel_group[group].channel[channel].conf0.val |= bit(4); // Low speed channels latch the new duty on this
+		} else {
+			LEDC.channel_group[group].channel[channel].conf0.clk_en = 1;
+		}
+	} else {
+		LEDC.channel_group[group].channel[channel].conf0.sig_out_en = 0;
+		LEDC.channel_group[group].channel[channel].conf1.duty_start = 0;
+		if (group) {
+			LEDC.channel_group[group].channel[channel].conf0.val &= ~bit(4);
+		} else {
+			LEDC.channel_group[group].channel[channel].conf0.clk_en = 0;
+		}
 	}
+	
+	#ifdef SPINDLE_PWM_TRACE
+		portENTER_CRITICAL(&pwm_trace_mux);
+		pwm_trace.entry[pwm_trace.head].time = esp_timer_get_time();
+		pwm_trace.entry[pwm_trace.head].channel = chan;
+		pwm_trace.entry[pwm_trace.head].duty = duty;
+		if (++pwm_trace.head == SPINDLE_PWM_TRACE_SIZE) {
+			pwm_trace.head = 0;
+		}
+		if (pwm_trace.count < SPINDLE_PWM_TRACE_SIZE) {
+			pwm_trace.count++;
+		}
+		portEXIT_CRITICAL(&pwm_trace_mux);
+	#endif
+}
+
+#ifdef SPINDLE_PWM_TRACE
+void spindle_pwm_trace_reset()
+{
+	portENTER_CRITICAL(&pwm_trace_mux);
+	memset(&pwm_trace, 0, sizeof(spindle_pwm_trace_t));
+	portEXIT_CRITICAL(&pwm_trace_mux);
 }
 
-void spindle_set_enable(bool enable)
+// Copies the log under the lock, so a report never sees a write half done.
+void spindle_pwm_trace_snapshot(spindle_pwm_trace_t *copy)
+{
+	portENTER_CRITICAL(&pwm_trace_mux);
+	memcpy(copy, &pwm_trace, sizeof(spindle_pwm_trace_t));
+	portEXIT_CRITICAL(&pwm_trace_mux);
+}
+#endif
+
+void IRAM_ATTR spindle_set_enable(bool enable)
 {
 	#ifdef SPINDLE_ENABLE_PIN	
 		#ifndef INVERT_SPINDLE_ENABLE_PIN
-				digitalWrite(SPINDLE_ENABLE_PIN, enable); // turn off (low) with zero speed
+				grbl_digitalWrite(SPINDLE_ENABLE_PIN, enable); // turn off (low) with zero speed
 		#else
-				digitalWrite(SPINDLE_ENABLE_PIN, !enable); // turn off (high) with zero speed
+				grbl_digitalWrite(SPINDLE_ENABLE_PIN, !enable); // turn off (high) with zero speed
 		#endif
 	#endif
 }
 
-uint32_t piecewise_linear_fit(float rpm) {
-	uint32_t pwm_value;
+// Unrounded PWM value of the piecewise linear spindle model. Only used to build the table.
+float piecewise_linear_fit(float rpm) {
+	float pwm_value;
 	
 	#if (N_PIECES > 3)
 		if (rpm > RPM_POINT34) {
-			pwm_value = floor(RPM_LINE_A4*rpm - RPM_LINE_B4);
+			pwm_value = RPM_LINE_A4*rpm - RPM_LINE_B4;
 		} else 
 	#endif
 	#if (N_PIECES > 2)
 		if (rpm > RPM_POINT23) {
-			pwm_value = floor(RPM_LINE_A3*rpm - RPM_LINE_B3);
+			pwm_value = RPM_LINE_A3*rpm - RPM_LINE_B3;
 		} else 
 	#endif
 	#if (N_PIECES > 1)
 		if (rpm > RPM_POINT12) {
-			pwm_value = floor(RPM_LINE_A2*rpm - RPM_LINE_B2);
+			pwm_value = RPM_LINE_A2*rpm - RPM_LINE_B2;
 		} else 
 	#endif
 	{
-		pwm_value = floor(RPM_LINE_A1*rpm - RPM_LINE_B1);
+		pwm_value = RPM_LINE_A1*rpm - RPM_LINE_B1;
 	}
 	return pwm_value;
 }
@@ -32,6 +32,28 @@
 #define SPINDLE_STATE_CCW      bit(1)
 
 #define SPINDLE_PULSE_RES_COUNT ((1<<SPINDLE_PWM_BIT_PRECISION) -1)  //(don't change)
+
+#ifndef SPINDLE_PWM_LUT_SIZE
+  #define SPINDLE_PWM_LUT_SIZE 64 // Steps of the rpm to PWM table, interpolated between. Only the piecewise model can fall between them.
+#endif
+
+#ifdef SPINDLE_PWM_TRACE
+  #ifndef SPINDLE_PWM_TRACE_SIZE
+    #define SPINDLE_PWM_TRACE_SIZE 64 // Most recent PWM writes kept
+  #endif
+
+  typedef struct {
+    uint32_t time;    // esp_timer_get_time() of the write, usec
+    uint8_t channel;
+    uint32_t duty;
+  } spindle_pwm_trace_entry_t;
+
+  typedef struct {
+    spindle_pwm_trace_entry_t entry[SPINDLE_PWM_TRACE_SIZE];
+    uint16_t head;    // Next entry to write. Oldest entry when count is full.
+    uint16_t count;
+  } spindle_pwm_trace_t;
+#endif
   
   void spindle_init();
   void spindle_stop();
@@ -40,8 +62,16 @@
   uint32_t spindle_compute_pwm_value(float rpm);
   void spindle_set_state(uint8_t state, float rpm);
   void spindle_sync(uint8_t state, float rpm);
+  void spindle_sync_planned();
+  void spindle_sync_flush();
+  void spindle_set_direction(uint8_t state);
   void grbl_analogWrite(uint8_t chan, uint32_t duty);
   void spindle_set_enable(bool enable);
-  uint32_t piecewise_linear_fit(float rpm);
+  float piecewise_linear_fit(float rpm);
+
+#ifdef SPINDLE_PWM_TRACE
+  void spindle_pwm_trace_reset();
+  void spindle_pwm_trace_snapshot(spindle_pwm_trace_t *copy);
+#endif
 
 #endif
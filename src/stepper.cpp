@@ -37,12 +37,30 @@ typedef struct {
 	uint32_t steps[N_AXIS];
 	uint32_t step_event_count;
 	uint8_t direction_bits;
+	uint8_t accessory; // Spindle and coolant condition flags of the block, set as it starts
 #ifdef VARIABLE_SPINDLE
 	uint8_t is_pwm_rate_adjusted; // Tracks motions that require constant laser power/rate
 #endif
 } st_block_t;
+
+#define ST_ACCESSORY_UNCHANGED 0xFF // System motions (homing, parking) leave spindle and coolant alone
 static st_block_t st_block_buffer[SEGMENT_BUFFER_SIZE-1];
 
+#ifdef LASER_RASTER
+// A raster pixel starting within a segment.
+typedef struct {
+	uint16_t step_count; // Value of st.step_count at the ISR tick it starts
+	uint16_t pwm;
+} st_raster_pixel_t;
+
+// Raster pixel ring, shared by the segments in the order of the segment buffer. Each segment
+// only holds the position of its pixels in here. The pixel values themselves stay in the
+// planner's raster ring.
+static st_raster_pixel_t st_raster_buffer[RASTER_EVENT_BUFFER_SIZE];
+static uint8_t st_raster_head;          // Ring position of the next pixel from segment prep
+static volatile uint8_t st_raster_tail; // Ring position of the first pixel of the executing segment
+#endif
+
 // Primary stepper segment ring buffer. Contains small, short line segments for the stepper
 // algorithm to execute, which are "checked-out" incrementally from the first block in the
 // planner buffer. Once "checked-out", the steps in the segments buffer cannot be modified by
@@ -59,6 +77,10 @@ typedef struct {
 #ifdef VARIABLE_SPINDLE
 	uint16_t spindle_pwm;
 #endif
+#ifdef LASER_RASTER
+	uint8_t raster_start;  // Ring position of the pixels in st_raster_buffer
+	uint8_t raster_count;  // Pixels starting after the first tick, with spindle_pwm for the first
+#endif
 } segment_t;
 static segment_t segment_buffer[SEGMENT_BUFFER_SIZE];
 
@@ -92,6 +114,10 @@ typedef struct {
 
 	uint16_t step_count;       // Steps remaining in line segment motion
 	uint8_t exec_block_index; // Tracks the current st_block index. Change indicates new block.
+	uint8_t accessory;        // Spindle direction and coolant last set by a block
+#ifdef LASER_RASTER
+	uint8_t raster_next;      // Next raster pixel of the segment
+#endif
 	st_block_t *exec_block;   // Pointer to the block data for the segment being executed
 	segment_t *exec_segment;  // Pointer to the segment being executed
 } stepper_t;
@@ -194,8 +220,9 @@ static st_prep_t prep;
    simultaneously with these two interrupts.
 
 	 NOTE: This interrupt must be as efficient as possible and complete before the next ISR tick,
-   which for ESP32 Grbl must be less than xx.xusec (TBD). Oscilloscope measured time in
-   ISR is 5usec typical and 25usec maximum, well below requirement.
+   which at the highest step rate (over 30kHz, see stepper.h) is about 30usec. Oscilloscope
+   measured time in ISR is 5usec typical and 25usec maximum, well below requirement.
+   Enable STEPPER_ISR_PROFILE in config.h to measure ISR time and step jitter on the target ($P).
    NOTE: This ISR expects at least one step to be executed per segment.
 
 	 The complete step timing should look this...
@@ -211,26 +238,36 @@ static st_prep_t prep;
 #ifdef USE_RMT_STEPS
   inline IRAM_ATTR static void stepperRMT_Outputs();
 #endif
+static void st_generate_gpio_masks();
 // TODO: Replace direct updating of the int32 position counters in the ISR somehow. Perhaps use smaller
 // int8 variables and update position counters only when a segment completes. This can get complicated
 // with probing and homing cycles that require true real-time positions.
-void IRAM_ATTR onStepperDriverTimer(void *para)  // ISR It is time to take a step =======================================================================================
+void IRAM_ATTR onStepperDriverTimer(void *)  // ISR It is time to take a step =======================================================================================
 {
-	#ifndef USE_RMT_STEPS
+	#if !defined(USE_RMT_STEPS) && !defined(USE_STEP_PULSE_TIMER)
 		uint64_t step_pulse_off_time;
 	#endif
 	//const int timer_idx = (int)para;  // get the timer index
+	#ifdef STEPPER_ISR_PROFILE
+		uint32_t profile_entry = xthal_get_ccount();
+		uint8_t profile_level = 0;
+	#endif
 
 	TIMERG0.int_clr_timers.t0 = 1;
 
 	if (busy) {
-		return;    // The busy-flag is used to avoid reentering this interrupt
+		return;    // The busy-flag is used to avoid reentering this interrupt. Not profiled, as no step is taken.
 	}
 
 	set_direction_pins_on(st.dir_outbits);
 	
 	#ifdef USE_RMT_STEPS
 		stepperRMT_Outputs();
+	#elif defined(USE_STEP_PULSE_TIMER)
+		set_stepper_pins_on(st.step_outbits);
+		if (st.step_outbits) {
+			Step_Pulse_Timer_Start(); // onStepPulseOffTimer() ends the pulse
+		}
 	#else
 		set_stepper_pins_on(st.step_outbits);
 		step_pulse_off_time = esp_timer_get_time() + (settings.pulse_microseconds); // determine when to turn off pulse
@@ -261,6 +298,15 @@ void IRAM_ATTR onStepperDriverTimer(void *para)  // ISR It is time to take a ste
 				// Initialize Bresenham line and distance counters
 				st.counter_x = st.counter_y = st.counter_z = (st.exec_block->step_event_count >> 1);
 				// TODO ABC
+
+				// Spindle and coolant changes queued with the motion take effect at the block boundary.
+				// The spindle speed follows with the segment below. Both calls only store to the GPIO
+				// registers, and the status report shows the change with its next override refresh.
+				if ((st.exec_block->accessory != ST_ACCESSORY_UNCHANGED) && (st.exec_block->accessory != st.accessory)) {
+					st.accessory = st.exec_block->accessory;
+					spindle_set_direction(st.accessory);
+					coolant_write_state(st.accessory & (PL_COND_FLAG_COOLANT_FLOOD | PL_COND_FLAG_COOLANT_MIST));
+				}
 			}
 			st.dir_outbits = st.exec_block->direction_bits ^ settings.dir_invert_mask;
 
@@ -286,6 +332,10 @@ void IRAM_ATTR onStepperDriverTimer(void *para)  // ISR It is time to take a ste
 			// Set real-time spindle output as segment is loaded, just prior to the first step.
 			spindle_set_speed(st.exec_segment->spindle_pwm);
 #endif
+#ifdef LASER_RASTER
+			st.raster_next = 0;
+			st_raster_tail = st.exec_segment->raster_start; // Pixels of the segments before are done
+#endif
 
 		} else {
 			// Segment buffer empty. Shutdown.
@@ -300,11 +350,26 @@ void IRAM_ATTR onStepperDriverTimer(void *para)  // ISR It is time to take a ste
 
 #endif
 			system_set_exec_state_flag(EXEC_CYCLE_STOP); // Flag main program for cycle end
+			#ifdef STEPPER_ISR_PROFILE
+				st_profile_isr_exit(profile_entry, profile_level);
+				st_profile_timer_stopped(); // Counted after st_go_idle(), so drop the interval again
+			#endif
 			return; // Nothing to do but exit.
 		}
 	}
 
 
+#ifdef LASER_RASTER
+	// Raster pixel boundary within the segment. The steps of the tick before are going out now.
+	if (st.raster_next < st.exec_segment->raster_count) {
+		st_raster_pixel_t *pixel = &st_raster_buffer[(st.exec_segment->raster_start+st.raster_next) & (RASTER_EVENT_BUFFER_SIZE-1)];
+		if (st.step_count == pixel->step_count) {
+			spindle_set_speed(pixel->pwm);
+			st.raster_next++;
+		}
+	}
+#endif
+
 	// Check probing state.
 	if (sys_probe_state == PROBE_ACTIVE) {
 		probe_state_monitor();
@@ -405,9 +470,16 @@ void IRAM_ATTR onStepperDriverTimer(void *para)  // ISR It is time to take a ste
 		st.step_outbits &= sys.homing_axis_lock;
 	}
 
+	#ifdef STEPPER_ISR_PROFILE
+		profile_level = st.exec_segment->amass_level;
+	#endif
+
 	st.step_count--; // Decrement step events count
 	if (st.step_count == 0) {
 		// Segment is complete. Discard current segment and advance segment indexing.
+		#ifdef STEPPER_ISR_PROFILE
+			st_profile_segment_end(st.exec_segment->n_step, st.exec_segment->cycles_per_tick, profile_level);
+		#endif
 		st.exec_segment = NULL;
 		if ( ++segment_buffer_tail == SEGMENT_BUFFER_SIZE) {
 			segment_buffer_tail = 0;
@@ -416,7 +488,9 @@ void IRAM_ATTR onStepperDriverTimer(void *para)  // ISR It is time to take a ste
 
 	#ifndef USE_RMT_STEPS
 		st.step_outbits ^= step_port_invert_mask;  // Apply step port invert mask
-		
+	#endif
+
+	#if !defined(USE_RMT_STEPS) && !defined(USE_STEP_PULSE_TIMER)
 		// wait for step pulse time to complete...some of it should have expired during code above
 		while (esp_timer_get_time() < step_pulse_off_time) {
 			NOP(); // spin here until time to turn off step
@@ -426,9 +500,25 @@ void IRAM_ATTR onStepperDriverTimer(void *para)  // ISR It is time to take a ste
 
 	TIMERG0.hw_timer[STEP_TIMER_INDEX].config.alarm_en = TIMER_ALARM_EN;
 
+	#ifdef STEPPER_ISR_PROFILE
+		st_profile_isr_exit(profile_entry, profile_level);
+	#endif
+
 	busy = false;
 }
 
+#ifdef USE_STEP_PULSE_TIMER
+/* The Stepper Port Reset Interrupt: a one shot alarm on the step pulse timer, armed by the
+   stepper ISR whenever it raises a step pin. It returns all step pins to idle once the pulse
+   time ($0) has passed, so the stepper ISR does not have to wait for it.
+*/
+void IRAM_ATTR onStepPulseOffTimer(void *)
+{
+	TIMERG0.int_clr_timers.t1 = 1;
+	set_stepper_pins_on(0);
+}
+#endif
+
 
 void stepper_init()
 {
@@ -442,6 +532,10 @@ void stepper_init()
 	#ifdef USE_UNIPOLAR
 		unipolar_init();
 	#endif
+
+	#ifdef STEPPER_ISR_PROFILE
+		st_profile_reset();
+	#endif
 	
 	#ifdef USE_TRINAMIC		
 		Trinamic_Init();
@@ -510,6 +604,8 @@ void stepper_init()
 		pinMode(C_DIRECTION_PIN, OUTPUT);
 	#endif
 
+	st_generate_gpio_masks();
+
 
 	
 
@@ -537,6 +633,19 @@ void stepper_init()
 	timer_enable_intr(STEP_TIMER_GROUP, STEP_TIMER_INDEX);
 	timer_isr_register(STEP_TIMER_GROUP, STEP_TIMER_INDEX, onStepperDriverTimer, NULL, 0, NULL);
 
+#ifdef USE_STEP_PULSE_TIMER
+	// The step pulse timer free runs at the stepper timer rate. Its alarm is armed per pulse and
+	// is one shot, because the hardware clears alarm_en when it fires.
+	config.counter_en  = TIMER_START;
+	config.alarm_en    = TIMER_ALARM_DIS;
+	config.auto_reload = false;
+
+	timer_init(STEP_TIMER_GROUP, STEP_PULSE_TIMER_INDEX, &config);
+	timer_set_alarm_value(STEP_TIMER_GROUP, STEP_PULSE_TIMER_INDEX, settings.pulse_microseconds*TICKS_PER_MICROSECOND);
+	timer_enable_intr(STEP_TIMER_GROUP, STEP_PULSE_TIMER_INDEX);
+	timer_isr_register(STEP_TIMER_GROUP, STEP_PULSE_TIMER_INDEX, onStepPulseOffTimer, NULL, 0, NULL);
+#endif
+
 
 }
 
@@ -677,7 +786,9 @@ void st_wake_up()
 	st.step_outbits = step_port_invert_mask;
 
 	// Initialize step pulse timing from settings. Here to ensure updating after re-writing.
-#ifdef STEP_PULSE_DELAY
+#ifdef USE_STEP_PULSE_TIMER
+	Step_Pulse_Timer_WritePeriod(settings.pulse_microseconds*TICKS_PER_MICROSECOND);
+#elif defined(STEP_PULSE_DELAY)
 	// Step pulse delay handling is not require with ESP32...the RMT function does it.
 #else // Normal operation
 	// Set step pulse time. Ad hoc computation from oscilloscope. Uses two's complement.
@@ -706,6 +817,10 @@ void st_reset()
 	segment_buffer_tail = 0;
 	segment_buffer_head = 0; // empty = tail
 	segment_next_head = 1;
+#ifdef LASER_RASTER
+	st_raster_head = 0;
+	st_raster_tail = 0;
+#endif
 	busy = false;
 
 	st_generate_step_dir_invert_masks();
@@ -719,103 +834,204 @@ void st_reset()
 
 
 
-void set_direction_pins_on(uint8_t onMask)
-{
-	// inverts are applied in step generation
+// Step and direction outputs are written straight to the GPIO set/clear registers, so every edge of
+// a step event lands with one or two stores instead of a digitalWrite() per motor. The pin tables come
+// from cpu_map.h (-1 when an axis has no pin) and stepper_init() expands them into one set of GPIO
+// masks per axis mask. Bank 0 is GPIO0-31 (GPIO.out_w1ts/out_w1tc), bank 1 is GPIO32-39 (out1).
+static const int8_t step_gpio[N_AXIS] = {
+#ifdef X_STEP_PIN
+	X_STEP_PIN,
+#else
+	-1,
+#endif
+#ifdef Y_STEP_PIN
+	Y_STEP_PIN,
+#else
+	-1,
+#endif
+#ifdef Z_STEP_PIN
+	Z_STEP_PIN,
+#else
+	-1,
+#endif
+#if (N_AXIS > A_AXIS)
+#ifdef A_STEP_PIN
+	A_STEP_PIN,
+#else
+	-1,
+#endif
+#endif
+#if (N_AXIS > B_AXIS)
+#ifdef B_STEP_PIN
+	B_STEP_PIN,
+#else
+	-1,
+#endif
+#endif
+#if (N_AXIS > C_AXIS)
+#ifdef C_STEP_PIN
+	C_STEP_PIN,
+#else
+	-1,
+#endif
+#endif
+};
+
+// Second motor of a ganged axis
+static const int8_t step_b_gpio[N_AXIS] = {
+#ifdef X_STEP_B_PIN
+	X_STEP_B_PIN,
+#else
+	-1,
+#endif
+#ifdef Y_STEP_B_PIN
+	Y_STEP_B_PIN,
+#else
+	-1,
+#endif
+#ifdef Z_STEP_B_PIN
+	Z_STEP_B_PIN,
+#else
+	-1,
+#endif
+#if (N_AXIS > A_AXIS)
+#ifdef A_STEP_B_PIN
+	A_STEP_B_PIN,
+#else
+	-1,
+#endif
+#endif
+#if (N_AXIS > B_AXIS)
+#ifdef B_STEP_B_PIN
+	B_STEP_B_PIN,
+#else
+	-1,
+#endif
+#endif
+#if (N_AXIS > C_AXIS)
+#ifdef C_STEP_B_PIN
+	C_STEP_B_PIN,
+#else
+	-1,
+#endif
+#endif
+};
+
+static const int8_t direction_gpio[N_AXIS] = {
 #ifdef X_DIRECTION_PIN
-	digitalWrite(X_DIRECTION_PIN, (onMask & (1<<X_AXIS)));
+	X_DIRECTION_PIN,
+#else
+	-1,
 #endif
 #ifdef Y_DIRECTION_PIN
-	digitalWrite(Y_DIRECTION_PIN, (onMask & (1<<Y_AXIS)));
+	Y_DIRECTION_PIN,
+#else
+	-1,
 #endif
 #ifdef Z_DIRECTION_PIN
-	digitalWrite(Z_DIRECTION_PIN, (onMask & (1<<Z_AXIS)));
+	Z_DIRECTION_PIN,
+#else
+	-1,
 #endif
+#if (N_AXIS > A_AXIS)
 #ifdef A_DIRECTION_PIN
-	digitalWrite(A_DIRECTION_PIN, (onMask & (1<<A_AXIS)));
+	A_DIRECTION_PIN,
+#else
+	-1,
+#endif
 #endif
+#if (N_AXIS > B_AXIS)
 #ifdef B_DIRECTION_PIN
-	digitalWrite(B_DIRECTION_PIN, (onMask & (1<<B_AXIS)));
+	B_DIRECTION_PIN,
+#else
+	-1,
 #endif
+#endif
+#if (N_AXIS > C_AXIS)
 #ifdef C_DIRECTION_PIN
-	digitalWrite(C_DIRECTION_PIN, (onMask & (1<<C_AXIS)));
+	C_DIRECTION_PIN,
+#else
+	-1,
 #endif
-
-
-}
-
-#ifndef USE_GANGED_AXES
-// basic one motor per axis
-void set_stepper_pins_on(uint8_t onMask)
-{
-	onMask ^= settings.step_invert_mask; // invert pins as required by invert mask
-
-#ifdef X_STEP_PIN
-	digitalWrite(X_STEP_PIN, (onMask & (1<<X_AXIS)));
 #endif
+};
 
-#ifdef Y_STEP_PIN
-	digitalWrite(Y_STEP_PIN, (onMask & (1<<Y_AXIS)));
+#define GPIO_AXIS_MASKS (1<<N_AXIS)
+#ifdef USE_GANGED_AXES
+	#define GPIO_STEP_MODES 3 // Indexed by ganged_mode (SQUARING_MODE_DUAL, _A, _B)
+#else
+	#define GPIO_STEP_MODES 1
 #endif
 
-#ifdef Z_STEP_PIN
-	digitalWrite(Z_STEP_PIN, (onMask & (1<<Z_AXIS)));
-#endif
+typedef struct {
+	uint32_t bank0;
+	uint32_t bank1;
+} gpio_masks_t;
 
-#ifdef A_STEP_PIN
-	digitalWrite(A_STEP_PIN, (onMask & (1<<A_AXIS)));
-#endif
-}
-#else // we use ganged axes
-void set_stepper_pins_on(uint8_t onMask)
-{
-	onMask ^= settings.step_invert_mask; // invert pins as required by invert mask
+static gpio_masks_t step_gpio_masks[GPIO_STEP_MODES][GPIO_AXIS_MASKS];
+static gpio_masks_t direction_gpio_masks[GPIO_AXIS_MASKS];
 
-#ifdef X_STEP_PIN
-#ifndef X_STEP_B_PIN // if not a ganged axis
-	digitalWrite(X_STEP_PIN, (onMask & (1<<X_AXIS)));
-#else // is a ganged axis
-	if ( (ganged_mode == SQUARING_MODE_DUAL) || (ganged_mode == SQUARING_MODE_A) ) {
-		digitalWrite(X_STEP_PIN, (onMask & (1<<X_AXIS)));
+static void gpio_masks_add(gpio_masks_t *masks, int8_t pin)
+{
+	if (pin < 0) {
+		return;
 	}
-
-	if ( (ganged_mode == SQUARING_MODE_DUAL) || (ganged_mode == SQUARING_MODE_B) ) {
-		digitalWrite(X_STEP_B_PIN, (onMask & (1<<X_AXIS)));
+	if (pin < 32) {
+		masks->bank0 |= (1UL << pin);
+	} else {
+		masks->bank1 |= (1UL << (pin - 32));
 	}
-#endif
-#endif
+}
 
-#ifdef Y_STEP_PIN
-#ifndef Y_STEP_B_PIN // if not a ganged axis
-	digitalWrite(Y_STEP_PIN, (onMask & (1<<Y_AXIS)));
-#else // is a ganged axis
-	if ( (ganged_mode == SQUARING_MODE_DUAL) || (ganged_mode == SQUARING_MODE_A) ) {
-		digitalWrite(Y_STEP_PIN, (onMask & (1<<Y_AXIS)));
+static void st_generate_gpio_masks()
+{
+	memset(step_gpio_masks, 0, sizeof(step_gpio_masks));
+	memset(direction_gpio_masks, 0, sizeof(direction_gpio_masks));
+	for (uint8_t axis_mask = 0; axis_mask < GPIO_AXIS_MASKS; axis_mask++) {
+		for (uint8_t idx = 0; idx < N_AXIS; idx++) {
+			if (bit_isfalse(axis_mask, bit(idx))) {
+				continue;
+			}
+			gpio_masks_add(&direction_gpio_masks[axis_mask], direction_gpio[idx]);
+			for (uint8_t mode = 0; mode < GPIO_STEP_MODES; mode++) {
+				// A ganged axis drives only the motor being squared, like the homing cycle expects.
+				if ((step_b_gpio[idx] < 0) || (mode != SQUARING_MODE_B)) {
+					gpio_masks_add(&step_gpio_masks[mode][axis_mask], step_gpio[idx]);
+				}
+				if (mode != SQUARING_MODE_A) {
+					gpio_masks_add(&step_gpio_masks[mode][axis_mask], step_b_gpio[idx]);
+				}
+			}
+		}
 	}
+}
 
-	if ( (ganged_mode == SQUARING_MODE_DUAL) || (ganged_mode == SQUARING_MODE_B) ) {
-		digitalWrite(Y_STEP_B_PIN, (onMask & (1<<Y_AXIS)));
-	}
-#endif
-#endif
+// Drives the pins in on_masks active (high) and the pins in off_masks low.
+static inline void IRAM_ATTR gpio_write_masks(const gpio_masks_t *on_masks, const gpio_masks_t *off_masks)
+{
+	GPIO.out_w1tc = off_masks->bank0;
+	GPIO.out_w1ts = on_masks->bank0;
+	GPIO.out1_w1tc.val = off_masks->bank1;
+	GPIO.out1_w1ts.val = on_masks->bank1;
+}
 
-#ifdef Z_STEP_PIN
-#ifndef Z_STEP_B_PIN // if not a ganged axis
-	digitalWrite(Z_STEP_PIN, (onMask & (1<<Z_AXIS)));
-#else // is a ganged axis
-	if ( (ganged_mode == SQUARING_MODE_DUAL) || (ganged_mode == SQUARING_MODE_A) ) {
-		digitalWrite(Z_STEP_PIN, (onMask & (1<<Z_AXIS)));
-	}
+void IRAM_ATTR set_direction_pins_on(uint8_t onMask)
+{
+	// inverts are applied in step generation
+	onMask &= (GPIO_AXIS_MASKS-1);
+	gpio_write_masks(&direction_gpio_masks[onMask], &direction_gpio_masks[onMask ^ (GPIO_AXIS_MASKS-1)]);
+}
 
-	if ( (ganged_mode == SQUARING_MODE_DUAL) || (ganged_mode == SQUARING_MODE_B) ) {
-		digitalWrite(Z_STEP_B_PIN, (onMask & (1<<Z_AXIS)));
-	}
-#endif
+void IRAM_ATTR set_stepper_pins_on(uint8_t onMask)
+{
+	onMask = (onMask ^ settings.step_invert_mask) & (GPIO_AXIS_MASKS-1); // invert pins as required by invert mask
+#ifdef USE_GANGED_AXES
+	const gpio_masks_t *masks = step_gpio_masks[ganged_mode];
+#else
+	const gpio_masks_t *masks = step_gpio_masks[0];
 #endif
-
-
+	gpio_write_masks(&masks[onMask], &masks[onMask ^ (GPIO_AXIS_MASKS-1)]);
 }
-#endif
 
 #ifdef USE_RMT_STEPS
 // Set stepper pulse output pins
@@ -1055,6 +1271,11 @@ void st_prep_buffer()
 				// segment buffer finishes the prepped block, but the stepper ISR is still executing it.
 				st_prep_block = &st_block_buffer[prep.st_block_index];
 				st_prep_block->direction_bits = pl_block->direction_bits;
+				if (pl_block->condition & PL_COND_FLAG_SYSTEM_MOTION) {
+					st_prep_block->accessory = ST_ACCESSORY_UNCHANGED;
+				} else {
+					st_prep_block->accessory = pl_block->condition & PL_COND_ACCESSORY_MASK;
+				}
 				uint8_t idx;
 #ifndef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
 				for (idx=0; idx<N_AXIS; idx++) {
@@ -1217,6 +1438,24 @@ void st_prep_buffer()
 		  such as from a feed hold.
 		*/
 		float dt_max = DT_SEGMENT; // Maximum segment time
+#ifdef LASER_RASTER
+		uint8_t raster_room = 0; // Pixels the segment may put in the raster pixel ring
+		if (pl_block->raster_count) {
+			raster_room = RASTER_EVENT_BUFFER_SIZE - (uint8_t)(st_raster_head - st_raster_tail);
+			if (raster_room == 0) {
+				return; // Ring full. Wait for the queued segments to run.
+			}
+			if (raster_room > RASTER_SEGMENT_PIXELS) {
+				raster_room = RASTER_SEGMENT_PIXELS;
+			}
+			// No more than raster_room pixels at the fastest speed in the block.
+			float mm_per_pixel = pl_block->step_event_count/(prep.step_per_mm*pl_block->raster_count);
+			float dt_raster = (raster_room*mm_per_pixel)/MAX(prep.current_speed, prep.maximum_speed);
+			if (dt_raster < dt_max) {
+				dt_max = dt_raster;
+			}
+		}
+#endif
 		float dt = 0.0; // Initialize segment time
 		float time_var = dt_max; // Time worker variable
 		float mm_var; // mm-Distance worker variable
@@ -1417,6 +1656,56 @@ void st_prep_buffer()
 		}
 #endif
 
+#ifdef LASER_RASTER
+		/* -----------------------------------------------------------------------------------
+		  Raster pixels. Pixel p of a block with n pixels starts once the steps remaining in the
+		  block are down to (n-p) times the steps per pixel. The segment starts with the pixel
+		  under its first step, and the ISR switches to each pixel starting later in the segment
+		  at the tick of the step where it starts.
+		*/
+		prep_segment->raster_start = st_raster_head;
+		prep_segment->raster_count = 0;
+		if (pl_block->raster_count && (pl_block->condition & (PL_COND_FLAG_SPINDLE_CW | PL_COND_FLAG_SPINDLE_CCW))) {
+			uint8_t n_pixel = pl_block->raster_count;
+			float steps_per_pixel = (float)pl_block->step_event_count/n_pixel;
+			float n_step = last_n_steps_remaining-n_steps_remaining; // Before AMASS
+			#ifdef ADAPTIVE_MULTI_AXIS_STEP_SMOOTHING
+				uint8_t amass_level = prep_segment->amass_level;
+			#else
+				uint8_t amass_level = 0;
+			#endif
+			float rpm = pl_block->spindle_speed/255.0; // Per pixel value
+			if (st_prep_block->is_pwm_rate_adjusted) {
+				rpm *= (prep.current_speed * prep.inv_rate);
+			}
+			int16_t pixel = floor(n_pixel - last_n_steps_remaining/steps_per_pixel);
+			if (pixel < 0) {
+				pixel = 0;
+			}
+			prep_segment->spindle_pwm = spindle_compute_pwm_value(rpm*plan_get_raster_pixel(pl_block, pixel));
+			while (++pixel < n_pixel) {
+				float step = ceil(last_n_steps_remaining - (n_pixel-pixel)*steps_per_pixel); // Steps into the segment
+				if (step >= n_step) {
+					break; // Starts in a later segment
+				}
+				uint16_t pwm = spindle_compute_pwm_value(rpm*plan_get_raster_pixel(pl_block, pixel));
+				uint16_t step_count = (uint16_t)(n_step-step) << amass_level;
+				st_raster_pixel_t *last = &st_raster_buffer[(st_raster_head+prep_segment->raster_count-1) & (RASTER_EVENT_BUFFER_SIZE-1)];
+				if (step <= 0) {
+					prep_segment->spindle_pwm = pwm;
+				} else if (prep_segment->raster_count &&
+				           ((last->step_count == step_count) || (prep_segment->raster_count == raster_room))) {
+					last->pwm = pwm; // Pixels shorter than a step, or no room left
+				} else {
+					st_raster_pixel_t *next = &st_raster_buffer[(st_raster_head+prep_segment->raster_count++) & (RASTER_EVENT_BUFFER_SIZE-1)];
+					next->step_count = step_count;
+					next->pwm = pwm;
+				}
+			}
+		}
+		st_raster_head += prep_segment->raster_count;
+#endif
+
 		// Segment complete! Increment segment buffer indices, so stepper ISR can immediately execute it.
 		segment_buffer_head = segment_next_head;
 		if ( ++segment_next_head == SEGMENT_BUFFER_SIZE ) {
@@ -1473,8 +1762,24 @@ float st_get_realtime_rate()
 void IRAM_ATTR Stepper_Timer_WritePeriod(uint64_t alarm_val)
 {
 	timer_set_alarm_value(STEP_TIMER_GROUP, STEP_TIMER_INDEX, alarm_val);
+#ifdef STEPPER_ISR_PROFILE
+	st_profile_set_period(alarm_val);
+#endif
+}
+
+#ifdef USE_STEP_PULSE_TIMER
+void Step_Pulse_Timer_WritePeriod(uint64_t alarm_val)
+{
+	timer_set_alarm_value(STEP_TIMER_GROUP, STEP_PULSE_TIMER_INDEX, alarm_val);
 }
 
+void IRAM_ATTR Step_Pulse_Timer_Start()
+{
+	timer_set_counter_value(STEP_TIMER_GROUP, STEP_PULSE_TIMER_INDEX, 0x00000000ULL);
+	TIMERG0.hw_timer[STEP_PULSE_TIMER_INDEX].config.alarm_en = TIMER_ALARM_EN;
+}
+#endif
+
 void IRAM_ATTR Stepper_Timer_Start()
 {
 #ifdef ESP_DEBUG
@@ -1495,6 +1800,9 @@ void IRAM_ATTR Stepper_Timer_Stop()
 #endif
 
 	timer_pause(STEP_TIMER_GROUP, STEP_TIMER_INDEX);
+#ifdef STEPPER_ISR_PROFILE
+	st_profile_timer_stopped();
+#endif
 
 }
 
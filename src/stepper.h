@@ -29,6 +29,18 @@
   #define SEGMENT_BUFFER_SIZE 6
 #endif
 
+// Most raster pixels that can start within one step segment. Segments of raster moves are kept
+// short enough for it.
+#ifndef RASTER_SEGMENT_PIXELS
+  #define RASTER_SEGMENT_PIXELS 16
+#endif
+
+// Raster pixels of the queued step segments, held in one ring for the whole segment buffer.
+// Must be a power of 2, no more than 128.
+#ifndef RASTER_EVENT_BUFFER_SIZE
+  #define RASTER_EVENT_BUFFER_SIZE 64
+#endif
+
 
 
 #include "grbl.h"
@@ -71,6 +83,7 @@
 
 #define STEP_TIMER_GROUP TIMER_GROUP_0
 #define STEP_TIMER_INDEX TIMER_0 
+#define STEP_PULSE_TIMER_INDEX TIMER_1 // Ends step pulses with USE_STEP_PULSE_TIMER
 
 // esp32 work around for diable in main loop
 extern uint64_t stepper_idle_counter;
@@ -128,4 +141,13 @@ void Stepper_Timer_WritePeriod(uint64_t alarm_val);
 void Stepper_Timer_Start();
 void Stepper_Timer_Stop();
 
+#ifdef USE_STEP_PULSE_TIMER
+  void Step_Pulse_Timer_WritePeriod(uint64_t alarm_val);
+  void Step_Pulse_Timer_Start();
+#endif
+
+#ifdef STEPPER_ISR_PROFILE
+  #include "stepper_profile.h" // Needs MAX_AMASS_LEVEL
+#endif
+
 #endif
\ No newline at end of file
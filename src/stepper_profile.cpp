@@ -0,0 +1,150 @@
+/*
+  stepper_profile.cpp - cycle counting instrumentation for the stepper driver interrupt
+  Part of Grbl_ESP32
+
+  The stepper ISR reads the CPU cycle counter (CCOUNT) on entry and again on exit. The
+  difference is the time spent in the ISR. The difference between two consecutive entries,
+  compared with the timer period the ISR had programmed, is the step timing jitter. Both are
+  collected into histograms per AMASS level, and every completed step segment leaves a
+  short summary, so the worst case can be tied to a step rate and smoothing level.
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "grbl.h"
+
+#ifdef STEPPER_ISR_PROFILE
+
+static stepper_profile_t profile;
+static portMUX_TYPE profile_mux = portMUX_INITIALIZER_UNLOCKED;
+
+static uint32_t last_entry;       // CCOUNT at the previous ISR entry
+static bool last_entry_valid;     // False until the timer has fired once since it was started
+static uint32_t period_ticks;     // Timer period that was programmed for the current interval
+static uint32_t next_period_ticks;
+static profile_segment_t current; // Segment being executed
+
+static void IRAM_ATTR profile_hist_add(profile_hist_t *hist, uint32_t cycles)
+{
+	uint32_t idx = cycles/PROFILE_BUCKET_CYCLES;
+	if (idx >= PROFILE_BUCKETS) {
+		idx = PROFILE_BUCKETS-1;
+	}
+	hist->bucket[idx]++;
+	hist->count++;
+	if (cycles < hist->min) {
+		hist->min = cycles;
+	}
+	if (cycles > hist->max) {
+		hist->max = cycles;
+	}
+}
+
+void IRAM_ATTR st_profile_isr_exit(uint32_t entry, uint8_t amass_level)
+{
+	uint32_t duration = xthal_get_ccount() - entry;
+
+	portENTER_CRITICAL_ISR(&profile_mux);
+	profile_hist_add(&profile.duration[amass_level], duration);
+	if (duration > current.isr_max) {
+		current.isr_max = duration;
+	}
+	if (last_entry_valid) {
+		int32_t jitter = (int32_t)((entry - last_entry) - period_ticks*PROFILE_CYCLES_PER_TIMER_TICK);
+		if (jitter < 0) {
+			jitter = -jitter;
+		}
+		profile_hist_add(&profile.jitter[amass_level], jitter);
+		if ((uint32_t)jitter > current.jitter_max) {
+			current.jitter_max = jitter;
+		}
+	}
+	portEXIT_CRITICAL_ISR(&profile_mux);
+
+	// The period written during this ISR is the one the next interval runs with.
+	last_entry = entry;
+	last_entry_valid = true;
+	period_ticks = next_period_ticks;
+}
+
+void IRAM_ATTR st_profile_segment_end(uint16_t n_step, uint16_t cycles_per_tick, uint8_t amass_level)
+{
+	current.n_step = n_step;
+	current.cycles_per_tick = cycles_per_tick;
+	current.amass_level = amass_level;
+
+	portENTER_CRITICAL_ISR(&profile_mux);
+	profile.segment[profile.segment_head] = current;
+	if (++profile.segment_head == PROFILE_SEGMENT_LOG) {
+		profile.segment_head = 0;
+	}
+	if (profile.segment_count < PROFILE_SEGMENT_LOG) {
+		profile.segment_count++;
+	}
+	portEXIT_CRITICAL_ISR(&profile_mux);
+
+	memset(&current, 0, sizeof(profile_segment_t));
+}
+
+void IRAM_ATTR st_profile_set_period(uint32_t timer_ticks)
+{
+	next_period_ticks = timer_ticks;
+	if (!last_entry_valid) {
+		period_ticks = timer_ticks;
+	}
+}
+
+void IRAM_ATTR st_profile_timer_stopped()
+{
+	// The next interval after a restart has no programmed start time to compare against.
+	last_entry_valid = false;
+}
+
+void st_profile_reset()
+{
+	portENTER_CRITICAL(&profile_mux);
+	memset(&profile, 0, sizeof(stepper_profile_t));
+	for (uint8_t level = 0; level <= MAX_AMASS_LEVEL; level++) {
+		profile.duration[level].min = 0xffffffff;
+		profile.jitter[level].min = 0xffffffff;
+	}
+	portEXIT_CRITICAL(&profile_mux);
+}
+
+// Copies the profile under the lock, so a report never mixes two ISR updates.
+void st_profile_snapshot(stepper_profile_t *copy)
+{
+	portENTER_CRITICAL(&profile_mux);
+	memcpy(copy, &profile, sizeof(stepper_profile_t));
+	portEXIT_CRITICAL(&profile_mux);
+}
+
+// Returns the upper edge of the bucket holding the given percentile, clamped to the exact max.
+uint32_t st_profile_percentile(profile_hist_t *hist, uint8_t percent)
+{
+	if (hist->count == 0) {
+		return 0;
+	}
+	uint32_t target = ((uint64_t)hist->count*percent + 99)/100;
+	uint32_t seen = 0;
+	for (uint8_t idx = 0; idx < PROFILE_BUCKETS; idx++) {
+		seen += hist->bucket[idx];
+		if (seen >= target) {
+			return MIN((idx+1)*PROFILE_BUCKET_CYCLES, hist->max);
+		}
+	}
+	return hist->max;
+}
+
+#endif
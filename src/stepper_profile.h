@@ -0,0 +1,72 @@
+/*
+  stepper_profile.h - cycle counting instrumentation for the stepper driver interrupt
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef stepper_profile_h
+#define stepper_profile_h
+
+#ifdef STEPPER_ISR_PROFILE
+#include <xtensa/core-macros.h> // xthal_get_ccount()
+
+// Histogram resolution. Each bucket is 0.5usec wide, so 64 buckets cover 0-32usec and the last
+// bucket also collects everything above that. Minimum and maximum are always exact.
+#define PROFILE_BUCKETS 64
+#define PROFILE_BUCKET_CYCLES (F_CPU/2000000)
+#define PROFILE_CYCLES_PER_TIMER_TICK (F_CPU/F_STEPPER_TIMER)
+
+// Number of completed step segments kept for the per-segment part of the report.
+#define PROFILE_SEGMENT_LOG 16
+
+typedef struct {
+	uint32_t count;
+	uint32_t min;   // CPU cycles
+	uint32_t max;   // CPU cycles
+	uint32_t bucket[PROFILE_BUCKETS];
+} profile_hist_t;
+
+// Summary of one executed step segment
+typedef struct {
+	uint16_t n_step;          // Step events executed, including AMASS overdrive ticks
+	uint16_t cycles_per_tick; // Programmed timer period (stepper timer ticks)
+	uint8_t  amass_level;
+	uint32_t isr_max;         // Longest ISR in the segment (CPU cycles)
+	uint32_t jitter_max;      // Largest deviation from the programmed period (CPU cycles)
+} profile_segment_t;
+
+typedef struct {
+	profile_hist_t duration[MAX_AMASS_LEVEL+1]; // ISR entry to exit, per AMASS level
+	profile_hist_t jitter[MAX_AMASS_LEVEL+1];   // |actual - programmed| ISR interval, per AMASS level
+	profile_segment_t segment[PROFILE_SEGMENT_LOG];
+	uint8_t segment_head;     // Next slot to write. Oldest entry when segment_count is full.
+	uint8_t segment_count;
+} stepper_profile_t;
+
+// Called by the stepper ISR. entry is xthal_get_ccount() read first thing in the ISR.
+void st_profile_isr_exit(uint32_t entry, uint8_t amass_level);
+void st_profile_segment_end(uint16_t n_step, uint16_t cycles_per_tick, uint8_t amass_level);
+
+// Called from the stepper timer helpers to track the programmed interrupt period.
+void st_profile_set_period(uint32_t timer_ticks);
+void st_profile_timer_stopped();
+
+// Main program interface
+void st_profile_reset();
+void st_profile_snapshot(stepper_profile_t *copy);
+uint32_t st_profile_percentile(profile_hist_t *hist, uint8_t percent); // CPU cycles
+#endif
+
+#endif
@@ -183,6 +183,20 @@ uint8_t system_execute_line(char *line, uint8_t client)
       if(line[2] != '=') { return(STATUS_INVALID_STATEMENT); }
       return(gc_execute_line(line, client)); // NOTE: $J= is ignored inside g-code parser and used to detect jog motions.
       break;
+#ifdef STEPPER_ISR_PROFILE
+    case 'P' : // Stepper ISR profile. Allowed in any state, it is meant to be read during a job.
+      if ( line[2] == 0 ) { report_stepper_profile(client); }
+      else if ( (line[2] == 'R') && (line[3] == 0) ) { st_profile_reset(); } // $PR clears it
+      else { return(STATUS_INVALID_STATEMENT); }
+      break;
+#endif
+#ifdef SPINDLE_PWM_TRACE
+    case 'W' : // Spindle PWM trace. Allowed in any state, like $P.
+      if ( line[2] == 0 ) { report_spindle_pwm_trace(client); }
+      else if ( (line[2] == 'R') && (line[3] == 0) ) { spindle_pwm_trace_reset(); } // $WR clears it
+      else { return(STATUS_INVALID_STATEMENT); }
+      break;
+#endif
     case '$': case 'G': case 'C': case 'X':
       if ( line[2] != 0 ) { return(STATUS_INVALID_STATEMENT); }
       switch( line[1] ) {
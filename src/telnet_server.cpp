@@ -196,6 +196,7 @@ bool Telnet_Server::push (uint8_t data){
         _RXbuffer[current] = data;
         _RXbufferSize++;
         log_i("[TELNET]buffer size %d",_RXbufferSize);
+        serial_wake();
        return true;
     }
     return false;
@@ -217,6 +218,7 @@ bool Telnet_Server::push (const uint8_t * data, int data_size){
         //vTaskDelay(1 / portTICK_RATE_MS);  // Yield to other tasks
         }
         _RXbufferSize+=data_processed;
+        serial_wake();
         return true;
     }
     return false;
@@ -234,6 +236,22 @@ int Telnet_Server::read(void){
     } else return -1;
 }
 
+size_t Telnet_Server::read(uint8_t *buffer, size_t size){
+    size_t count = 0;
+    while ((count < size) && (_RXbufferSize > 0)) {
+        //copy up to the end of the ring, then wrap
+        size_t chunk = TELNETRXBUFFERSIZE - _RXbufferpos;
+        if (chunk > _RXbufferSize) chunk = _RXbufferSize;
+        if (chunk > (size - count)) chunk = size - count;
+        memcpy(&buffer[count], &_RXbuffer[_RXbufferpos], chunk);
+        _RXbufferpos += chunk;
+        if (_RXbufferpos > (TELNETRXBUFFERSIZE-1))_RXbufferpos = 0;
+        _RXbufferSize -= chunk;
+        count += chunk;
+    }
+    return count;
+}
+
 #endif // Enable TELNET && ENABLE_WIFI
 
 #endif // ARDUINO_ARCH_ESP32
@@ -41,6 +41,7 @@ class Telnet_Server {
     void handle();
     size_t write(const uint8_t *buffer, size_t size);
     int read(void);
+    size_t read(uint8_t *buffer, size_t size);
     int peek(void);
     int available();
     int get_rx_buffer_available();
@@ -0,0 +1,164 @@
+/*
+  upload_pipeline.cpp - writes web uploads to SD and SPIFFS from a background task
+  Part of Grbl_ESP32
+
+  Buffers go around two queues: upload_write() takes an empty one from upload_free, fills it
+  and sends it to upload_full, and uploadTask writes it and gives it back. A block with no data
+  on upload_full marks the end of an upload, and the task answers it on upload_done.
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "upload_pipeline.h"
+#include <freertos/queue.h>
+
+typedef struct {
+  uint8_t *data;
+  size_t size;
+} upload_block_t;
+
+static TaskHandle_t uploadTaskHandle = 0;
+static QueueHandle_t upload_free = NULL; // Empty buffers
+static QueueHandle_t upload_full = NULL; // Buffers to write, in order
+static QueueHandle_t upload_done = NULL; // Result of an upload, once its last buffer is written
+static File *upload_file;
+static volatile bool upload_failed = false; // A write failed or the upload was aborted
+static uint8_t *upload_memory = NULL;
+static upload_block_t upload_block; // Buffer being filled, data is NULL when there is none
+static uint32_t upload_start_time;
+static uint32_t upload_bytes;
+static uint32_t upload_last_rate = 0;
+
+static void uploadTask(void *pvParameters)
+{
+  upload_block_t block;
+  while (true) {
+    xQueueReceive(upload_full, &block, portMAX_DELAY);
+    if (block.data == NULL) {
+      bool ok = !upload_failed;
+      xQueueSend(upload_done, &ok, portMAX_DELAY);
+      continue;
+    }
+    if (!upload_failed && (upload_file->write(block.data, block.size) != block.size)) {
+      upload_failed = true;
+    }
+    xQueueSend(upload_free, &block, portMAX_DELAY);
+  }
+}
+
+bool upload_begin(File &file)
+{
+  if (uploadTaskHandle == 0) {
+    upload_free = xQueueCreate(UPLOAD_BUFFER_COUNT, sizeof(upload_block_t));
+    upload_full = xQueueCreate(UPLOAD_BUFFER_COUNT + 1, sizeof(upload_block_t)); // and the end mark
+    upload_done = xQueueCreate(1, sizeof(bool));
+    xTaskCreatePinnedToCore(uploadTask,    // task
+                            "uploadTask", // name for task
+                            4096,   // size of task stack
+                            NULL,   // parameters
+                            1, // priority
+                            &uploadTaskHandle,
+                            0 // core
+                           );
+  }
+  upload_memory = (uint8_t *)malloc(UPLOAD_BUFFER_COUNT * UPLOAD_BUFFER_SIZE);
+  if (upload_memory == NULL) {
+    return false;
+  }
+  upload_block_t block = {NULL, 0};
+  for (uint8_t i = 0; i < UPLOAD_BUFFER_COUNT; i++) {
+    block.data = upload_memory + i * UPLOAD_BUFFER_SIZE;
+    xQueueSend(upload_free, &block, 0);
+  }
+  upload_file = &file;
+  upload_failed = false;
+  upload_block.data = NULL;
+  upload_bytes = 0;
+  upload_start_time = millis();
+  return true;
+}
+
+bool upload_write(const uint8_t *data, size_t size)
+{
+  if (upload_memory == NULL) {
+    return false;
+  }
+  upload_bytes += size;
+  while (size && !upload_failed) {
+    if (upload_block.data == NULL) {
+      xQueueReceive(upload_free, &upload_block, portMAX_DELAY);
+      upload_block.size = 0;
+    }
+    size_t len = UPLOAD_BUFFER_SIZE - upload_block.size;
+    if (len > size) {
+      len = size;
+    }
+    memcpy(upload_block.data + upload_block.size, data, len);
+    upload_block.size += len;
+    data += len;
+    size -= len;
+    if (upload_block.size == UPLOAD_BUFFER_SIZE) {
+      xQueueSend(upload_full, &upload_block, portMAX_DELAY);
+      upload_block.data = NULL;
+    }
+  }
+  return !upload_failed;
+}
+
+// Sends what is left and the end mark, waits for the task to get to it and frees the buffers.
+static bool upload_finish()
+{
+  if (upload_block.data != NULL) {
+    if (upload_block.size) {
+      xQueueSend(upload_full, &upload_block, portMAX_DELAY);
+    } else {
+      xQueueSend(upload_free, &upload_block, portMAX_DELAY);
+    }
+    upload_block.data = NULL;
+  }
+  upload_block_t end = {NULL, 0};
+  bool ok;
+  xQueueSend(upload_full, &end, portMAX_DELAY);
+  xQueueReceive(upload_done, &ok, portMAX_DELAY);
+  xQueueReset(upload_free); // Every buffer is back in it now
+  free(upload_memory);
+  upload_memory = NULL;
+  return ok;
+}
+
+bool upload_end()
+{
+  if (upload_memory == NULL) {
+    return false;
+  }
+  bool ok = upload_finish();
+  uint32_t elapsed = millis() - upload_start_time;
+  upload_last_rate = ok ? (uint64_t)upload_bytes * 1000 / (elapsed ? elapsed : 1) : 0;
+  return ok;
+}
+
+void upload_abort()
+{
+  if (upload_memory == NULL) {
+    return;
+  }
+  upload_failed = true; // The task skips the buffers still queued
+  upload_finish();
+  upload_last_rate = 0;
+}
+
+uint32_t upload_rate()
+{
+  return upload_last_rate;
+}
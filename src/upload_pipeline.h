@@ -0,0 +1,54 @@
+/*
+  upload_pipeline.h - writes web uploads to SD and SPIFFS from a background task
+  Part of Grbl_ESP32
+
+  Grbl is free software: you can redistribute it and/or modify
+  it under the terms of the GNU General Public License as published by
+  the Free Software Foundation, either version 3 of the License, or
+  (at your option) any later version.
+
+  Grbl is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU General Public License for more details.
+
+  You should have received a copy of the GNU General Public License
+  along with Grbl.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef upload_pipeline_h
+#define upload_pipeline_h
+
+#include "Arduino.h"
+#include "FS.h"
+
+// The web server hands an upload over in chunks of about 1.4KB, one TCP segment each. They are
+// copied into UPLOAD_BUFFER_SIZE buffers, and a task on core 0 writes every full buffer to the
+// file while the next one fills, so the file system sees a few large aligned writes instead of
+// many small ones and the web server does not wait for the card. The buffers are allocated
+// when an upload starts and freed when it ends.
+#ifndef UPLOAD_BUFFER_SIZE
+  #define UPLOAD_BUFFER_SIZE 8192 // A multiple of 4KB, so every write but the last is whole sectors and flash pages.
+#endif
+#ifndef UPLOAD_BUFFER_COUNT
+  #define UPLOAD_BUFFER_COUNT 2 // One written while the other fills
+#endif
+
+// Starts writing an upload to an open file. Returns false if the buffers could not be allocated.
+bool upload_begin(File &file);
+
+// Queues the next chunk. Only waits when every buffer is full and waiting for the card. Returns
+// false once a write has failed, and the rest of the upload is dropped.
+bool upload_write(const uint8_t *data, size_t size);
+
+// Writes what is left and waits for it. Returns false if any write failed. The file is left open.
+bool upload_end();
+
+// Drops what has not been written yet and waits for the write in progress. The file is left open.
+void upload_abort();
+
+// Sustained rate of the last upload that ended, in bytes per second, from upload_begin() to the
+// end of the last write.
+uint32_t upload_rate();
+
+#endif
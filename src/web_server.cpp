@@ -37,6 +37,7 @@
 #include <WiFi.h>
 #include <FS.h>
 #include <SPIFFS.h>
+#include "upload_pipeline.h"
 #ifdef ENABLE_SD_CARD
 #include <SD.h>
 #include "grbl_sd.h"
@@ -796,10 +797,14 @@ void Web_Server::handleFileList ()
     }
     String path ;
     String status = "Ok";
+    String rate;
     if (_upload_status == UPLOAD_STATUS_FAILED) {
         status = "Upload failed";
         _upload_status = UPLOAD_STATUS_NONE;
     }
+    if (_upload_status == UPLOAD_STATUS_SUCCESSFUL) {
+        rate = String (upload_rate() / 1024) + " KB/s";
+    }
     _upload_status = UPLOAD_STATUS_NONE;
     //be sure root is correct according authentication
     if (auth_level == LEVEL_ADMIN) {
@@ -961,6 +966,9 @@ void Web_Server::handleFileList ()
     jsonfile += "],";
     jsonfile += "\"path\":\"" + path + "\",";
     jsonfile += "\"status\":\"" + status + "\",";
+    if (rate.length() > 0) {
+        jsonfile += "\"rate\":\"" + rate + "\",";
+    }
     size_t totalBytes;
     size_t usedBytes;
     totalBytes = SPIFFS.totalBytes();
@@ -1042,6 +1050,8 @@ void Web_Server::SPIFFSFileupload ()
                 if (SPIFFS.exists (filename) ) {
                     SPIFFS.remove (filename);
                 }
+                //an upload that never ended still has the pipeline
+                upload_abort();
                 if (fsUploadFile ) {
                     fsUploadFile.close();
                 }
@@ -1060,7 +1070,7 @@ void Web_Server::SPIFFSFileupload ()
                     //create file
                     fsUploadFile = SPIFFS.open(filename, FILE_WRITE);
                     //check If creation succeed
-                    if (fsUploadFile) {
+                    if (fsUploadFile && upload_begin(fsUploadFile)) {
                         //if yes upload is started
                         _upload_status= UPLOAD_STATUS_ONGOING;
                     } else {
@@ -1073,11 +1083,10 @@ void Web_Server::SPIFFSFileupload ()
                 //Upload write
                 //**************
             } else if(upload.status == UPLOAD_FILE_WRITE) {
-                vTaskDelay(1 / portTICK_RATE_MS);
                 //check if file is available and no error
                 if(fsUploadFile && _upload_status == UPLOAD_STATUS_ONGOING) {
-                    //no error so write post date
-                    if (upload.currentSize != fsUploadFile.write(upload.buf, upload.currentSize)) {
+                    //no error so queue post data, it is written in the background
+                    if (!upload_write(upload.buf, upload.currentSize)) {
                         _upload_status=UPLOAD_STATUS_FAILED;
                         grbl_send(CLIENT_ALL,"[MSG:Upload error]\r\n");
                         pushError(ESP_ERROR_FILE_WRITE, "File write failed");
@@ -1093,7 +1102,10 @@ void Web_Server::SPIFFSFileupload ()
             } else if(upload.status == UPLOAD_FILE_END) {
                 //check if file is still open
                 if(fsUploadFile) {
-                    //close it
+                    //write what is still buffered and close it
+                    if (!upload_end()) {
+                        _upload_status = UPLOAD_STATUS_FAILED;
+                    }
                     fsUploadFile.close();
                     //check size 
                     String  sizeargname  = upload.filename + "S";
@@ -1123,6 +1135,7 @@ void Web_Server::SPIFFSFileupload ()
             } else {
                     _upload_status = UPLOAD_STATUS_FAILED;
                     //pushError(ESP_ERROR_UPLOAD, "File upload failed");
+                    upload_abort();
                     return;
             }
         }
@@ -1130,6 +1143,10 @@ void Web_Server::SPIFFSFileupload ()
     
     if (_upload_status == UPLOAD_STATUS_FAILED) {
         cancelUpload();
+        upload_abort();
+        if (fsUploadFile) {
+            fsUploadFile.close();
+        }
         if (SPIFFS.exists (filename) ) {
             SPIFFS.remove (filename);
             }
@@ -1308,10 +1325,14 @@ void Web_Server::handle_direct_SDFileList()
 
     String path="/";
     String sstatus="Ok";
+    String rate;
     if ((_upload_status == UPLOAD_STATUS_FAILED) || (_upload_status == UPLOAD_STATUS_FAILED)) {
         sstatus = "Upload failed";
         _upload_status = UPLOAD_STATUS_NONE;
     }
+    if (_upload_status == UPLOAD_STATUS_SUCCESSFUL) {
+        rate = String(upload_rate() / 1024) + " KB/s";
+    }
     bool list_files = true;
     uint64_t totalspace = 0;
     uint64_t usedspace = 0;
@@ -1344,6 +1365,7 @@ void Web_Server::handle_direct_SDFileList()
                 sstatus = shortname + " does not exist!";
             } else {
                 if (SD.remove((char *)filename.c_str())) {
+                    sd_remove_index(SD, filename.c_str());
                     sstatus = shortname + " deleted";
                 } else {
                     sstatus = "Cannot deleted " ;
@@ -1481,6 +1503,9 @@ void Web_Server::handle_direct_SDFileList()
         jsonfile+=  "-1";
     }
     jsonfile+= "\",";
+    if (rate.length() > 0) {
+        jsonfile+= "\"rate\":\"" + rate + "\",";
+    }
     jsonfile+= "\"mode\":\"direct\",";
     jsonfile+= "\"status\":\"";
     jsonfile+=sstatus + "\"";
@@ -1522,10 +1547,17 @@ void Web_Server::SDFile_direct_upload()
                     
                 } else {
                     set_sd_state(SDCARD_BUSY_UPLOADING);
+                    //an upload that never ended still has the pipeline
+                    upload_abort();
+                    if (sdUploadFile) {
+                        sdUploadFile.close();
+                    }
                     //delete file on SD Card if already present
                     if(SD.exists((char *)filename.c_str())) {
                         SD.remove((char *)filename.c_str());
                     }
+                    //the index of the old file would not match, the first run builds a new one
+                    sd_remove_index(SD, filename.c_str());
                     String  sizeargname  = upload.filename + "S";
                     if (_webserver->hasArg (sizeargname.c_str()) ) {
                          uint32_t filesize = _webserver->arg (sizeargname.c_str()).toInt();
@@ -1541,7 +1573,7 @@ void Web_Server::SDFile_direct_upload()
                         //Create file for writing
                         sdUploadFile = SD.open((char *)filename.c_str(), FILE_WRITE);
                         //check if creation succeed
-                        if (!sdUploadFile) {
+                        if (!sdUploadFile || !upload_begin(sdUploadFile)) {
                             //if creation failed
                             _upload_status=UPLOAD_STATUS_FAILED;
                             grbl_send(CLIENT_ALL,"[MSG:Upload failed]\r\n");
@@ -1556,10 +1588,9 @@ void Web_Server::SDFile_direct_upload()
                 //Upload write
                 //**************
             } else if(upload.status == UPLOAD_FILE_WRITE) {
-                vTaskDelay(1 / portTICK_RATE_MS);
                 if(sdUploadFile && (_upload_status == UPLOAD_STATUS_ONGOING) && (get_sd_state(false) == SDCARD_BUSY_UPLOADING)) {
-                    //no error write post data
-                    if (upload.currentSize != sdUploadFile.write(upload.buf, upload.currentSize)) {
+                    //no error queue post data, it is written in the background
+                    if (!upload_write(upload.buf, upload.currentSize)) {
                     _upload_status = UPLOAD_STATUS_FAILED;
                     grbl_send(CLIENT_ALL,"[MSG:Upload failed]\r\n");
                     pushError(ESP_ERROR_FILE_WRITE, "File write failed");
@@ -1574,6 +1605,12 @@ void Web_Server::SDFile_direct_upload()
             } else if(upload.status == UPLOAD_FILE_END) {
                 //if file is open close it
                 if(sdUploadFile) {
+                    //write what is still buffered
+                    if (!upload_end()) {
+                        _upload_status = UPLOAD_STATUS_FAILED;
+                        grbl_send(CLIENT_ALL,"[MSG:Upload failed]\r\n");
+                        pushError(ESP_ERROR_FILE_WRITE, "File write failed");
+                    }
                     sdUploadFile.close();
                     //TODO Check size
                     String  sizeargname  = upload.filename + "S";
@@ -1605,6 +1642,7 @@ void Web_Server::SDFile_direct_upload()
                 _upload_status=UPLOAD_STATUS_FAILED;
                 set_sd_state(SDCARD_IDLE);
                 grbl_send(CLIENT_ALL,"[MSG:Upload failed]\r\n");
+                upload_abort();
                 if(sdUploadFile) {
                     sdUploadFile.close();
                 }
@@ -1614,6 +1652,7 @@ void Web_Server::SDFile_direct_upload()
     }
     if (_upload_status == UPLOAD_STATUS_FAILED) {
         cancelUpload();
+        upload_abort();
         if(sdUploadFile) {
             sdUploadFile.close();
             }